@@ -71,10 +71,12 @@ if compile_with_sources:
                  'optimize.cpp',
                  'patterndisp.cpp',
                  'rref.cpp',
+                 'setup_cache.cpp',
                  'symmetry.cpp',
                  'system.cpp',
                  'timer.cpp',
-                 'writer.cpp']
+                 'writer.cpp',
+                 'xml_parser.cpp']
     if os.path.exists('src'):
         source_dir = "src"
     else:
@@ -15,6 +15,7 @@
 #include "optimize.h"
 #include "cluster.h"
 #include "patterndisp.h"
+#include "setup_cache.h"
 #include "symmetry.h"
 #include "system.h"
 #include "timer.h"
@@ -43,6 +44,7 @@ ALM::~ALM()
     delete optimize;
     delete constraint;
     delete displace;
+    delete setup_cache;
     delete timer;
 }
 
@@ -56,6 +58,7 @@ void ALM::init_instances()
     optimize = new Optimize();
     constraint = new Constraint();
     displace = new Displace();
+    setup_cache = new SetupCache();
     timer = new Timer();
 }
 
@@ -79,6 +82,16 @@ void ALM::set_print_hessian(const bool print_hessian) const // HESSIAN
     files->print_hessian = print_hessian;
 }
 
+void ALM::set_setup_cache_file(const std::string cache_file) const // SETUPCACHE
+{
+    setup_cache->set_filename(cache_file);
+}
+
+void ALM::set_symmetry_cache_file(const std::string cache_file) const // SYMMCACHE
+{
+    setup_cache->set_filename_symmetry(cache_file);
+}
+
 void ALM::set_print_symmetry(const int printsymmetry) const // PRINTSYM
 {
     symmetry->set_print_symmetry(printsymmetry);
@@ -195,6 +208,11 @@ void ALM::set_fc_fix(const int order,
     }
 }
 
+void ALM::set_fc_file_binary(const bool use_fc_file_binary) const // FCXML_BIN
+{
+    constraint->set_fc_file_binary(use_fc_file_binary);
+}
+
 void ALM::set_sparse_mode(const int sparse_mode) const // SPARSE
 {
     auto optctrl = optimize->get_optimizer_control();
@@ -279,6 +297,11 @@ double*** ALM::get_x_image() const
     return system->get_x_image();
 }
 
+const std::vector<std::vector<int>>& ALM::get_image_shift() const
+{
+    return system->get_image_shift();
+}
+
 int* ALM::get_periodicity() const
 {
     return system->get_periodicity();
@@ -378,10 +401,11 @@ size_t ALM::get_number_of_irred_fc_elements(const int fc_order) // harmonic=1, .
                           symmetry,
                           get_optimizer_control().linear_model,
                           verbosity,
-                          timer);
+                          timer,
+                          setup_cache);
         ready_to_fit = true;
     }
-    return constraint->get_index_bimap(order).size();
+    return constraint->get_index_map(order).size();
 }
 
 size_t ALM::get_number_of_fc_origin(const int fc_order,
@@ -396,18 +420,12 @@ size_t ALM::get_number_of_fc_origin(const int fc_order,
         std::cout << "fc_order must not be larger than maxorder" << std::endl;
         exit(EXIT_FAILURE);
     }
-    auto nfc_cart = fcs->get_nfc_cart(1);
-
-    if (nfc_cart.size() < fc_order) {
+    if (!fcs->get_fc_cart_table(fc_order - 1)) {
         std::cout << "fc has not yet been computed or set." << std::endl;
         exit(EXIT_FAILURE);
     }
 
-    if (permutation) {
-        return fcs->get_nfc_cart(1)[fc_order - 1];
-    } else {
-        return fcs->get_nfc_cart(0)[fc_order - 1];
-    }
+    return fcs->get_nfc_cart(fc_order - 1, permutation);
 }
 
 void ALM::get_fc_origin(double *fc_values,
@@ -424,31 +442,23 @@ void ALM::get_fc_origin(double *fc_values,
         std::cout << "fc_order must not be larger than maxorder" << std::endl;
         exit(EXIT_FAILURE);
     }
-    if (!fcs->get_fc_cart()) {
+    const auto fc_cart_ptr = fcs->get_fc_cart_table(fc_order - 1);
+    if (!fc_cart_ptr) {
         std::cout << "fc has not yet been computed." << std::endl;
         exit(EXIT_FAILURE);
     }
 
     auto id = 0;
+    const auto &fc_cart = *fc_cart_ptr;
 
-    if (permutation) {
-        for (const auto &it : fcs->get_fc_cart()[fc_order - 1]) {
-            fc_values[id] = it.fc_value;
-            for (auto i = 0; i < fc_order + 1; ++i) {
-                elem_indices[id * (fc_order + 1) + i] = it.flattenarray[i];
-            }
-            ++id;
-        }
-    } else {
-        for (const auto &it : fcs->get_fc_cart()[fc_order - 1]) {
-            if (it.is_ascending_order) {
-                fc_values[id] = it.fc_value;
-                for (auto i = 0; i < fc_order + 1; ++i) {
-                    elem_indices[id * (fc_order + 1) + i] = it.flattenarray[i];
-                }
-                ++id;
-            }
+    for (size_t ifc = 0; ifc < fc_cart.size(); ++ifc) {
+        if (!permutation && !fc_cart.is_ascending_order(ifc)) continue;
+
+        fc_values[id] = fc_cart.get_fc_value(ifc);
+        for (auto i = 0; i < fc_order + 1; ++i) {
+            elem_indices[id * (fc_order + 1) + i] = fc_cart.get_flattenarray(ifc)[i];
         }
+        ++id;
     }
 }
 
@@ -479,7 +489,8 @@ void ALM::get_fc_irreducible(double *fc_values,
                           symmetry,
                           get_optimizer_control().linear_model,
                           verbosity,
-                          timer);
+                          timer,
+                          setup_cache);
         ready_to_fit = true;
     }
 
@@ -488,18 +499,19 @@ void ALM::get_fc_irreducible(double *fc_values,
 
     for (auto order = 0; order < fc_order; ++order) {
 
-        if (constraint->get_index_bimap(order).empty()) { continue; }
+        const auto &index_map = constraint->get_index_map(order);
+
+        if (index_map.empty()) { continue; }
 
         if (order == fc_order - 1) {
-            for (const auto &it : constraint->get_index_bimap(order)) {
-                inew = it.left;
-                iold = it.right + ishift;
+            for (inew = 0; inew < index_map.size(); ++inew) {
+                iold = index_map.get_orig(inew) + ishift;
 
                 fc_elem = optimize->get_params()[iold];
                 fc_values[inew] = fc_elem;
                 for (auto i = 0; i < fc_order + 1; ++i) {
                     elem_indices[inew * (fc_order + 1) + i] =
-                        fcs->get_fc_table()[order][it.right].elems[i];
+                        fcs->get_fc_property_table()[order].get_elems(index_map.get_orig(inew))[i];
                 }
             }
         }
@@ -521,42 +533,28 @@ void ALM::get_fc_all(double *fc_values,
         std::cout << "fc_order must not be larger than maxorder" << std::endl;
         exit(EXIT_FAILURE);
     }
-    if (!fcs->get_fc_cart()) {
+    const auto fc_cart_ptr = fcs->get_fc_cart_table(fc_order - 1);
+    if (!fc_cart_ptr) {
         std::cout << "fc has not yet been computed." << std::endl;
         exit(EXIT_FAILURE);
     }
 
     std::vector<int> pair_tran(fc_order + 1);
     size_t id = 0;
+    const auto &fc_cart = *fc_cart_ptr;
 
-     if (permutation) {
-        for (const auto &it : fcs->get_fc_cart()[fc_order - 1]) {
+    for (size_t ifc = 0; ifc < fc_cart.size(); ++ifc) {
+        if (!permutation && !fc_cart.is_ascending_order(ifc)) continue;
 
-            for (size_t itran = 0; itran < ntran; ++itran) {
-                for (i = 0; i < fc_order + 1; ++i) {
-                    pair_tran[i] = symmetry->get_map_sym()[it.atoms[i]][symmetry->get_symnum_tran()[itran]];
-                }
-                fc_values[id] = it.fc_value;
-                for (i = 0; i < fc_order + 1; ++i) {
-                    elem_indices[id * (fc_order + 1) + i] = 3 * pair_tran[i] + it.coords[i];
-                }
-                ++id;
+        for (size_t itran = 0; itran < ntran; ++itran) {
+            for (i = 0; i < fc_order + 1; ++i) {
+                pair_tran[i] = symmetry->get_map_sym()[fc_cart.get_atom(ifc, i)][symmetry->get_symnum_tran()[itran]];
             }
-        }
-    } else {
-        for (const auto &it : fcs->get_fc_cart()[fc_order - 1]) {
-            if (it.is_ascending_order) {
-                for (size_t itran = 0; itran < ntran; ++itran) {
-                    for (i = 0; i < fc_order + 1; ++i) {
-                        pair_tran[i] = symmetry->get_map_sym()[it.atoms[i]][symmetry->get_symnum_tran()[itran]];
-                    }
-                    fc_values[id] = it.fc_value;
-                    for (i = 0; i < fc_order + 1; ++i) {
-                        elem_indices[id * (fc_order + 1) + i] = 3 * pair_tran[i] + it.coords[i];
-                    }
-                    ++id;
-                }
+            fc_values[id] = fc_cart.get_fc_value(ifc);
+            for (i = 0; i < fc_order + 1; ++i) {
+                elem_indices[id * (fc_order + 1) + i] = 3 * pair_tran[i] + fc_cart.get_coord(ifc, i);
             }
+            ++id;
         }
     }
 }
@@ -616,7 +614,8 @@ int ALM::run_optimize()
                           symmetry,
                           get_optimizer_control().linear_model,
                           verbosity,
-                          timer);
+                          timer,
+                          setup_cache);
         ready_to_fit = true;
     }
     const auto maxorder = cluster->get_maxorder();
@@ -653,9 +652,11 @@ void ALM::init_fc_table()
     // Perform initialization only once.
 
     if (structure_initialized) return;
+    system->set_cutoff_radius_of_images(
+        cluster->get_maximum_cutoff_radius(system->get_supercell().number_of_elems));
     system->init(verbosity, timer);
     files->init();
-    symmetry->init(system, verbosity, timer);
+    symmetry->init(system, verbosity, timer, setup_cache);
     structure_initialized = true;
 
     // Build cluster & force constant table
@@ -663,11 +664,16 @@ void ALM::init_fc_table()
                   symmetry,
                   verbosity,
                   timer);
+    setup_cache->set_key_structure(system,
+                                   symmetry,
+                                   cluster,
+                                   fcs->get_forceconstant_basis());
     fcs->init(cluster,
               symmetry,
               system->get_supercell(),
               verbosity,
-              timer);
+              timer,
+              setup_cache);
 
     // Switch off the ready flag because the force constants are updated
     // but corresponding constranits are not.
@@ -19,6 +19,7 @@
 #include "constraint.h"
 #include "files.h"
 #include "patterndisp.h"
+#include "setup_cache.h"
 #include "timer.h"
 
 namespace ALM_NS
@@ -36,12 +37,15 @@ namespace ALM_NS
         class Constraint *constraint{};
         class Files *files{};
         class Displace *displace{};
+        class SetupCache *setup_cache{};
         class Timer *timer{};
 
         void set_verbosity(int verbosity_in);
         int get_verbosity() const;
         void set_output_filename_prefix(std::string prefix) const;
         void set_print_hessian(bool print_hessian) const;
+        void set_setup_cache_file(std::string cache_file) const;
+        void set_symmetry_cache_file(std::string cache_file) const;
         void set_print_symmetry(int printsymmetry) const;
         void set_datfile_train(const DispForceFile &dat_in) const;
         void set_datfile_validation(const DispForceFile &dat_in) const;
@@ -70,6 +74,7 @@ namespace ALM_NS
         void set_rotation_axis(const std::string rotation_axis) const;
         void set_fc_file(const int order, const std::string fc_file) const;
         void set_fc_fix(const int order, const bool fc_fix) const;
+        void set_fc_file_binary(const bool use_fc_file_binary) const;
         void set_sparse_mode(const int sparse_mode) const;
         void set_forceconstant_basis(const std::string preferred_basis) const;
         std::string get_forceconstant_basis() const;
@@ -93,6 +98,7 @@ namespace ALM_NS
         void set_str_magmom(std::string);
         std::string get_str_magmom() const;
         double*** get_x_image() const;
+        const std::vector<std::vector<int>>& get_image_shift() const;
         int* get_periodicity() const;
 
         const std::vector<std::vector<int>>& get_atom_mapping_by_pure_translations() const;
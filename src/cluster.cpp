@@ -23,6 +23,11 @@ or http://opensource.org/licenses/mit-license.php for information.
 #include <algorithm>
 #include <set>
 #include <cmath>
+#include <limits>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 using namespace ALM_NS;
 
@@ -53,16 +58,6 @@ void Cluster::init(const System *system,
         std::cout << " ===========" << std::endl << std::endl;
     }
 
-    if (distall) {
-        deallocate(distall);
-    }
-    allocate(distall, nat, nat);
-
-    if (mindist_pairs) {
-        deallocate(mindist_pairs);
-    }
-    allocate(mindist_pairs, nat, nat);
-
     if (interaction_pair) {
         deallocate(interaction_pair);
     }
@@ -97,7 +92,11 @@ void Cluster::init(const System *system,
     }
 
     get_pairs_of_minimum_distance(nat,
+                                  nkd,
+                                  symmetry->get_nat_prim(),
+                                  symmetry->get_map_p2s(),
                                   system->get_x_image(),
+                                  system->get_x_image_soa(),
                                   system->get_exist_image());
 
     set_interaction_by_cutoff(system->get_supercell().number_of_atoms,
@@ -169,13 +168,13 @@ void Cluster::init(const System *system,
 
 void Cluster::generate_pairs(const size_t natmin,
                              const std::vector<std::vector<int>> &map_p2s,
-                             std::set<IntList> *pair_out) const
+                             ClusterTable *pair_out) const
 {
     int *pair_tmp;
 
     for (auto order = 0; order < maxorder; ++order) {
 
-        pair_out[order].clear();
+        pair_out[order].init(order + 2);
 
         allocate(pair_tmp, order + 2);
 
@@ -183,19 +182,23 @@ void Cluster::generate_pairs(const size_t natmin,
 
             const auto iat = map_p2s[i][0];
 
-            for (const auto &it : interaction_cluster[order][i]) {
+            const auto &clusters = interaction_cluster[order][i];
+
+            for (size_t icluster = 0; icluster < clusters.size(); ++icluster) {
 
+                const auto atoms = clusters.get_atoms(icluster);
                 pair_tmp[0] = iat;
                 for (auto j = 0; j < order + 1; ++j) {
-                    pair_tmp[j + 1] = it.atom[j];
+                    pair_tmp[j + 1] = atoms[j];
                 }
                 insort(order + 2, pair_tmp);
 
                 // Ignore many-body case
                 // if (!satisfy_nbody_rule(order + 2, pair_tmp, order)) continue;
-                pair_out[order].insert(IntList(order + 2, pair_tmp));
+                pair_out[order].push_back(pair_tmp);
             }
         }
+        pair_out[order].sort_unique();
         deallocate(pair_tmp);
     }
 }
@@ -205,8 +208,6 @@ void Cluster::set_default_variables()
     maxorder = 0;
     nbody_include = nullptr;
     cutoff_radii = nullptr;
-    distall = nullptr;
-    mindist_pairs = nullptr;
     cluster_list = nullptr;
     interaction_pair = nullptr;
     interaction_cluster = nullptr;
@@ -226,10 +227,6 @@ void Cluster::deallocate_variables()
         deallocate(cluster_list);
         cluster_list = nullptr;
     }
-    if (mindist_pairs) {
-        deallocate(mindist_pairs);
-        mindist_pairs = nullptr;
-    }
     if (interaction_pair) {
         deallocate(interaction_pair);
         interaction_pair = nullptr;
@@ -238,10 +235,6 @@ void Cluster::deallocate_variables()
         deallocate(interaction_cluster);
         interaction_cluster = nullptr;
     }
-    if (distall) {
-        deallocate(distall);
-        distall = nullptr;
-    }
 }
 
 double Cluster::distance(const double *x1,
@@ -254,49 +247,378 @@ double Cluster::distance(const double *x1,
 }
 
 void Cluster::get_pairs_of_minimum_distance(const size_t nat,
+                                            const size_t nkd,
+                                            const size_t natmin,
+                                            const std::vector<std::vector<int>> &map_p2s,
                                             const double * const * const *xc_in,
-                                            const int *exist) const
+                                            const ImageCoordinates &x_soa,
+                                            const int *exist)
 {
+    // The distances to all the atoms are stored for the atoms in the
+    // primitive cell, which are the centers of the clusters.
+    // For the other atoms, only the pairs within the largest cutoff radius
+    // are needed (is_incutoff). They are searched with a cell list
+    // of the atoms in all the periodic images, instead of all the N^2 pairs.
+
     size_t i, j;
-    double vec[3];
+    int k;
+    std::vector<size_t> cols;
+    std::vector<std::vector<DistInfo>> dist_row, mindist_row;
+    std::vector<DistInfo> dist_tmp;
+    const auto nimage = x_soa.get_number_of_images();
+    std::vector<double> dist_image(nimage * nat);
+    std::vector<double> dist_pair(nimage);
 
-    for (i = 0; i < nat; ++i) {
-        for (j = 0; j < nat; ++j) {
+    distall.init(nat);
+    mindist_pairs.init(nat);
 
-            distall[i][j].clear();
+    std::vector<char> is_prim(nat, 0);
+    for (i = 0; i < natmin; ++i) is_prim[map_p2s[i][0]] = 1;
 
-            for (auto icell = 0; icell < 27; ++icell) {
+    for (i = 0; i < natmin; ++i) {
+        const auto iat = map_p2s[i][0];
 
-                if (exist[icell]) {
+        // Distances to all the atoms of each image at once
+        for (size_t icell = 0; icell < nimage; ++icell) {
+            if (exist[icell]) x_soa.get_distances(xc_in[0][iat], icell, &dist_image[icell * nat]);
+        }
 
-                    const auto dist_tmp = distance(xc_in[0][i], xc_in[icell][j]);
+        dist_row.resize(nat);
+        mindist_row.resize(nat);
+        for (j = 0; j < nat; ++j) {
+            get_distance_of_images(iat, j, nimage, xc_in, exist, &dist_image[j], nat, dist_row[j]);
+            get_images_of_minimum_distance(dist_row[j], mindist_row[j]);
+        }
+        cols.clear();
+        distall.set_row(iat, cols, dist_row);
+        cols.clear();
+        mindist_pairs.set_row(iat, cols, mindist_row);
+    }
 
-                    for (auto k = 0; k < 3; ++k) vec[k] = xc_in[icell][j][k] - xc_in[0][i][k];
+    const auto rmax = get_maximum_cutoff_radius(nkd);
+    if (rmax < 0.0) return;
 
-                    distall[i][j].emplace_back(DistInfo(icell, dist_tmp, vec));
-                }
+    // Cell list. The bins are not smaller than the search radius,
+    // so that the neighbors are in the adjacent bins.
+
+    const auto rsearch = rmax + eps6;
+    const int max_bins = 64;
+    double xmin[3], xmax[3], binsize[3];
+    int nbins[3];
+
+    for (k = 0; k < 3; ++k) {
+        xmin[k] = xc_in[0][0][k];
+        xmax[k] = xc_in[0][0][k];
+    }
+    for (size_t icell = 0; icell < nimage; ++icell) {
+        if (!exist[icell]) continue;
+        for (j = 0; j < nat; ++j) {
+            for (k = 0; k < 3; ++k) {
+                xmin[k] = std::min(xmin[k], xc_in[icell][j][k]);
+                xmax[k] = std::max(xmax[k], xc_in[icell][j][k]);
             }
-            std::sort(distall[i][j].begin(), distall[i][j].end());
         }
     }
+    for (k = 0; k < 3; ++k) {
+        nbins[k] = static_cast<int>((xmax[k] - xmin[k]) / rsearch);
+        nbins[k] = std::max(1, std::min(nbins[k], max_bins));
+        binsize[k] = (xmax[k] - xmin[k]) / static_cast<double>(nbins[k]);
+        if (binsize[k] < eps12) binsize[k] = 1.0;
+    }
 
-    // Construct pairs of minimum distance.
+    const auto get_bin = [&](const double *x, int *ibin) {
+        for (auto m = 0; m < 3; ++m) {
+            ibin[m] = static_cast<int>((x[m] - xmin[m]) / binsize[m]);
+            ibin[m] = std::max(0, std::min(ibin[m], nbins[m] - 1));
+        }
+    };
 
-    for (i = 0; i < nat; ++i) {
+    const auto nbins_all = static_cast<size_t>(nbins[0]) * nbins[1] * nbins[2];
+    std::vector<size_t> bin_offset(nbins_all + 1, 0);
+    std::vector<size_t> bin_points;
+    std::vector<double> bin_x[3];
+    int ibin[3];
+
+    for (size_t icell = 0; icell < nimage; ++icell) {
+        if (!exist[icell]) continue;
         for (j = 0; j < nat; ++j) {
-            mindist_pairs[i][j].clear();
-
-            const auto dist_min = distall[i][j][0].dist;
-            for (auto it = distall[i][j].cbegin(); it != distall[i][j].cend(); ++it) {
-                // The tolerance below (1.e-3) should be chosen so that
-                // the mirror images with equal distances are found correctly.
-                // If this fails, the phonon dispersion would be incorrect.
-                if (std::abs((*it).dist - dist_min) < 1.0e-3) {
-                    mindist_pairs[i][j].emplace_back(DistInfo(*it));
+            get_bin(xc_in[icell][j], ibin);
+            ++bin_offset[(ibin[0] * nbins[1] + ibin[1]) * nbins[2] + ibin[2] + 1];
+        }
+    }
+    for (size_t ib = 0; ib < nbins_all; ++ib) bin_offset[ib + 1] += bin_offset[ib];
+    bin_points.resize(bin_offset[nbins_all]);
+    for (k = 0; k < 3; ++k) bin_x[k].resize(bin_offset[nbins_all]);
+    std::vector<size_t> bin_fill(bin_offset.begin(), bin_offset.end() - 1);
+
+    for (size_t icell = 0; icell < nimage; ++icell) {
+        if (!exist[icell]) continue;
+        for (j = 0; j < nat; ++j) {
+            get_bin(xc_in[icell][j], ibin);
+            const auto ip = bin_fill[(ibin[0] * nbins[1] + ibin[1]) * nbins[2] + ibin[2]]++;
+            bin_points[ip] = icell * nat + j;
+            for (k = 0; k < 3; ++k) bin_x[k][ip] = xc_in[icell][j][k];
+        }
+    }
+
+    std::vector<char> is_neighbor(nat, 0);
+    std::vector<double> dist_bin;
+
+    for (i = 0; i < nat; ++i) {
+        if (is_prim[i]) continue;
+
+        cols.clear();
+        get_bin(xc_in[0][i], ibin);
+
+        for (auto ix = std::max(0, ibin[0] - 1); ix <= std::min(nbins[0] - 1, ibin[0] + 1); ++ix) {
+            for (auto iy = std::max(0, ibin[1] - 1); iy <= std::min(nbins[1] - 1, ibin[1] + 1); ++iy) {
+                for (auto iz = std::max(0, ibin[2] - 1); iz <= std::min(nbins[2] - 1, ibin[2] + 1); ++iz) {
+                    const auto ib = (static_cast<size_t>(ix) * nbins[1] + iy) * nbins[2] + iz;
+                    const auto ip0 = bin_offset[ib];
+                    const auto npoints = bin_offset[ib + 1] - ip0;
+                    if (npoints == 0) continue;
+
+                    dist_bin.resize(npoints);
+                    ImageCoordinates::get_distances(xc_in[0][i],
+                                                    &bin_x[0][ip0], &bin_x[1][ip0], &bin_x[2][ip0],
+                                                    npoints, &dist_bin[0]);
+
+                    for (size_t ip = 0; ip < npoints; ++ip) {
+                        const auto jat = bin_points[ip0 + ip] % nat;
+                        if (is_neighbor[jat]) continue;
+                        if (dist_bin[ip] <= rsearch) {
+                            is_neighbor[jat] = 1;
+                            cols.push_back(jat);
+                        }
+                    }
                 }
             }
         }
+
+        std::sort(cols.begin(), cols.end());
+        mindist_row.resize(cols.size());
+        for (j = 0; j < cols.size(); ++j) {
+            is_neighbor[cols[j]] = 0;
+            for (size_t icell = 0; icell < nimage; ++icell) {
+                if (exist[icell]) dist_pair[icell] = distance(xc_in[0][i], xc_in[icell][cols[j]]);
+            }
+            get_distance_of_images(i, cols[j], nimage, xc_in, exist, &dist_pair[0], 1, dist_tmp);
+            get_images_of_minimum_distance(dist_tmp, mindist_row[j]);
+        }
+        mindist_pairs.set_row(i, cols, mindist_row);
+    }
+}
+
+void Cluster::get_distance_of_images(const size_t iat,
+                                     const size_t jat,
+                                     const size_t nimage,
+                                     const double * const * const *xc_in,
+                                     const int *exist,
+                                     const double *dist_in,
+                                     const size_t dist_stride,
+                                     std::vector<DistInfo> &dist_out) const
+{
+    // dist_in[icell * dist_stride] is the distance between iat and
+    // the image of jat in icell.
+
+    double vec[3];
+
+    dist_out.clear();
+
+    for (size_t icell = 0; icell < nimage; ++icell) {
+
+        if (exist[icell]) {
+
+            const auto dist_tmp = dist_in[icell * dist_stride];
+
+            for (auto k = 0; k < 3; ++k) vec[k] = xc_in[icell][jat][k] - xc_in[0][iat][k];
+
+            dist_out.emplace_back(DistInfo(icell, dist_tmp, vec));
+        }
+    }
+
+    // The neighboring 27 cells are sorted as before so that the order of
+    // equidistant images is unchanged. The additional images are ordered by
+    // distance and cell index, and follow the neighboring cells at the
+    // same distance (std::inplace_merge is stable).
+    auto it_extra = dist_out.begin();
+    while (it_extra != dist_out.end() && it_extra->cell < 27) ++it_extra;
+
+    std::sort(dist_out.begin(), it_extra);
+    std::sort(it_extra, dist_out.end(),
+              [](const DistInfo &a, const DistInfo &b)
+              {
+                  if (a.dist != b.dist) return a.dist < b.dist;
+                  return a.cell < b.cell;
+              });
+    std::inplace_merge(dist_out.begin(), it_extra, dist_out.end());
+}
+
+void Cluster::get_images_of_minimum_distance(const std::vector<DistInfo> &dist_in,
+                                             std::vector<DistInfo> &dist_out) const
+{
+    dist_out.clear();
+
+    const auto dist_min = dist_in[0].dist;
+    for (auto it = dist_in.cbegin(); it != dist_in.cend(); ++it) {
+        // The tolerance below (1.e-3) should be chosen so that
+        // the mirror images with equal distances are found correctly.
+        // If this fails, the phonon dispersion would be incorrect.
+        if (std::abs((*it).dist - dist_min) < 1.0e-3) {
+            dist_out.emplace_back(DistInfo(*it));
+        }
+    }
+}
+
+double Cluster::get_maximum_cutoff_radius(const size_t nkd) const
+{
+    // Returns a negative value if no cutoff radius is given (all 'None').
+
+    auto rmax = -1.0;
+    if (!cutoff_radii) return rmax;
+    for (auto order = 0; order < maxorder; ++order) {
+        for (size_t i = 0; i < nkd; ++i) {
+            for (size_t j = 0; j < nkd; ++j) {
+                rmax = std::max(rmax, cutoff_radii[order][i][j]);
+            }
+        }
+    }
+    return rmax;
+}
+
+PairDistanceTable::PairDistanceTable()
+{
+    const double zero[3] = {0.0, 0.0, 0.0};
+    nat = 0;
+    far_pair.emplace_back(DistInfo(0, std::numeric_limits<double>::infinity(), zero));
+}
+
+void PairDistanceTable::init(const size_t nat_in)
+{
+    nat = nat_in;
+    cols.clear();
+    lists.clear();
+    cols.resize(nat);
+    lists.resize(nat);
+}
+
+void PairDistanceTable::set_row(const size_t i,
+                                std::vector<size_t> &cols_in,
+                                std::vector<std::vector<DistInfo>> &lists_in)
+{
+    cols[i].swap(cols_in);
+    lists[i].swap(lists_in);
+}
+
+const std::vector<DistInfo>& PairDistanceTable::get(const size_t i,
+                                                    const size_t j) const
+{
+    const auto &cols_now = cols[i];
+
+    if (cols_now.empty()) {
+        if (lists[i].size() == nat) return lists[i][j];
+        return far_pair;
+    }
+    const auto it = std::lower_bound(cols_now.begin(), cols_now.end(), j);
+    if (it == cols_now.end() || *it != j) return far_pair;
+    return lists[i][it - cols_now.begin()];
+}
+
+ClusterTable::ClusterTable()
+{
+    nelems = 0;
+}
+
+void ClusterTable::init(const int nelems_in)
+{
+    nelems = nelems_in;
+    atoms.clear();
+}
+
+void ClusterTable::push_back(const int *arr)
+{
+    atoms.insert(atoms.end(), arr, arr + nelems);
+}
+
+void ClusterTable::sort_unique()
+{
+    const auto n = size();
+    std::vector<size_t> index(n);
+    for (size_t i = 0; i < n; ++i) index[i] = i;
+
+    const auto is_less = [&](const size_t a, const size_t b) {
+        return std::lexicographical_compare(&atoms[a * nelems], &atoms[a * nelems] + nelems,
+                                            &atoms[b * nelems], &atoms[b * nelems] + nelems);
+    };
+    std::sort(index.begin(), index.end(), is_less);
+
+    std::vector<int> atoms_sorted;
+    atoms_sorted.reserve(atoms.size());
+    for (size_t i = 0; i < n; ++i) {
+        if (i > 0 && !is_less(index[i - 1], index[i])) continue;
+        atoms_sorted.insert(atoms_sorted.end(),
+                            &atoms[index[i] * nelems],
+                            &atoms[index[i] * nelems] + nelems);
+    }
+    atoms.swap(atoms_sorted);
+}
+
+const size_t InteractionClusterTable::npos = std::numeric_limits<size_t>::max();
+
+InteractionClusterTable::InteractionClusterTable()
+{
+    nelems = 0;
+    image_offset.push_back(0);
+}
+
+void InteractionClusterTable::clear()
+{
+    atoms.clear();
+    distmax.clear();
+    image_offset.assign(1, 0);
+    cells.clear();
+}
+
+void InteractionClusterTable::build(const int nelems_in,
+                                    std::vector<InteractionCluster> &clusters_in)
+{
+    nelems = nelems_in;
+    clear();
+
+    std::stable_sort(clusters_in.begin(), clusters_in.end());
+
+    for (size_t i = 0; i < clusters_in.size(); ++i) {
+        const auto &it = clusters_in[i];
+        if (i > 0 && !(clusters_in[i - 1] < it)) continue;
+
+        atoms.insert(atoms.end(), it.atom.begin(), it.atom.end());
+        distmax.push_back(it.distmax);
+        for (const auto &cell_now : it.cell) {
+            cells.insert(cells.end(), cell_now.begin(), cell_now.end());
+        }
+        image_offset.push_back(image_offset.back() + it.cell.size());
+    }
+    clusters_in.clear();
+}
+
+size_t InteractionClusterTable::find(const int *atoms_in) const
+{
+    size_t ilow = 0;
+    size_t ihigh = size();
+
+    while (ilow < ihigh) {
+        const auto imid = (ilow + ihigh) / 2;
+        if (std::lexicographical_compare(get_atoms(imid), get_atoms(imid) + nelems,
+                                         atoms_in, atoms_in + nelems)) {
+            ilow = imid + 1;
+        } else {
+            ihigh = imid;
+        }
     }
+    if (ilow < size() && std::equal(atoms_in, atoms_in + nelems, get_atoms(ilow))) {
+        return ilow;
+    }
+    return npos;
 }
 
 void Cluster::print_neighborlist(const size_t nat,
@@ -322,7 +644,7 @@ void Cluster::print_neighborlist(const size_t nat,
         iat = map_p2s[i][0];
 
         for (j = 0; j < nat; ++j) {
-            neighborlist[i].emplace_back(DistList(j, mindist_pairs[iat][j][0].dist));
+            neighborlist[i].emplace_back(DistList(j, mindist_pairs.get(iat, j)[0].dist));
         }
         std::sort(neighborlist[i].begin(), neighborlist[i].end());
     }
@@ -441,7 +763,7 @@ void Cluster::generate_interaction_information_by_cutoff(const size_t nat,
 
             } else {
 
-                if (mindist_pairs[iat][jat][0].dist <= cutoff_tmp) {
+                if (mindist_pairs.get(iat, jat)[0].dist <= cutoff_tmp) {
                     interaction_list[i].push_back(jat);
                 }
             }
@@ -511,6 +833,11 @@ int* Cluster::get_nbody_include() const
     return nbody_include;
 }
 
+double*** Cluster::get_cutoff_radii() const
+{
+    return cutoff_radii;
+}
+
 std::string Cluster::get_ordername(const unsigned int order) const
 {
     if (order == 0) {
@@ -520,7 +847,7 @@ std::string Cluster::get_ordername(const unsigned int order) const
     }
 }
 
-const std::set<IntList>& Cluster::get_cluster_list(const unsigned int order) const
+const ClusterTable& Cluster::get_cluster_list(const unsigned int order) const
 {
     return cluster_list[order];
 }
@@ -531,8 +858,8 @@ const std::vector<int>& Cluster::get_interaction_pair(const unsigned int order,
     return interaction_pair[order][atom_index];
 }
 
-const std::set<InteractionCluster>& Cluster::get_interaction_cluster(const unsigned int order,
-                                                                     const size_t atom_index) const
+const InteractionClusterTable& Cluster::get_interaction_cluster(const unsigned int order,
+                                                               const size_t atom_index) const
 {
     return interaction_cluster[order][atom_index];
 }
@@ -611,7 +938,7 @@ bool Cluster::is_incutoff(const int n,
             const auto cutoff_tmp = cutoff_radii[order][ikd][jkd];
 
             if (cutoff_tmp >= 0.0 &&
-                (mindist_pairs[iat][jat][0].dist > cutoff_tmp)) {
+                (mindist_pairs.get(iat, jat)[0].dist > cutoff_tmp)) {
                 return false;
             }
 
@@ -676,45 +1003,29 @@ void Cluster::set_interaction_cluster(const int order,
                                       const std::vector<int> *interaction_pair_in,
                                       const double * const * const *x_image,
                                       const int *exist,
-                                      std::set<InteractionCluster> *interaction_cluster_out) const
+                                      InteractionClusterTable *interaction_cluster_out) const
 {
     //
     // Calculate a set of clusters for the given order
     //
 
-    size_t j, k;
+    size_t i, j;
     int jat;
-    size_t ii;
-    int jkd;
-    int icount;
-
-    double dist_tmp, rc_tmp;
     double distmax;
 
-    bool isok;
-
     int *list_now;
 
-    std::vector<int> cell_vector;
-    std::vector<double> dist_vector;
-    std::vector<std::vector<int>> pairs_icell, comb_cell, comb_cell_min;
-    std::vector<std::vector<int>> comb_cell_atom_center;
-    std::vector<int> accum_tmp;
+    std::vector<std::vector<int>> comb_cell_min;
     std::vector<int> atom_tmp, cell_tmp;
-    std::vector<int> intpair_uniq, cellpair;
-    std::vector<int> group_atom;
-    std::vector<int> data_now;
-    std::vector<MinDistList> distance_list;
-    std::vector<std::vector<int>> data_vec;
+    std::vector<std::vector<std::vector<int>>> data_vec(natmin);
+    std::vector<std::pair<size_t, size_t>> items;
+    std::vector<std::vector<InteractionCluster>> cluster_tmp(natmin);
 
     allocate(list_now, order + 2);
 
-    for (size_t i = 0; i < natmin; ++i) {
-
-        interaction_cluster_out[i].clear();
+    for (i = 0; i < natmin; ++i) {
 
         const auto iat = map_p2s[i][0];
-        const auto ikd = kd[iat] - 1;
         list_now[0] = iat;
 
         // List of 2-body interaction pairs
@@ -736,189 +1047,373 @@ void Cluster::set_interaction_cluster(const int order,
                 atom_tmp.clear();
                 atom_tmp.push_back(jat);
 
-                for (j = 0; j < mindist_pairs[iat][jat].size(); ++j) {
+                for (j = 0; j < mindist_pairs.get(iat, jat).size(); ++j) {
                     cell_tmp.clear();
-                    cell_tmp.push_back(mindist_pairs[iat][jat][j].cell);
+                    cell_tmp.push_back(mindist_pairs.get(iat, jat)[j].cell);
                     comb_cell_min.push_back(cell_tmp);
                 }
-                distmax = mindist_pairs[iat][jat][0].dist;
-                interaction_cluster_out[i].insert(InteractionCluster(atom_tmp,
-                                                                     comb_cell_min,
-                                                                     distmax));
+                distmax = mindist_pairs.get(iat, jat)[0].dist;
+                cluster_tmp[i].emplace_back(InteractionCluster(atom_tmp,
+                                                               comb_cell_min,
+                                                               distmax));
             }
 
-        } else if (order > 0) {
+        }
+    }
+    deallocate(list_now);
 
-            // Anharmonic terms
+    if (order > 0) {
 
-            data_vec.clear();
+        // Anharmonic terms
 
-            // First, we generate all possible combinations of clusters.
-            CombinationWithRepetition<int> g(intlist.begin(), intlist.end(), order + 1);
-            do {
-                auto data = g.now();
+        // Candidate clusters are grown atom by atom, and a partial cluster is
+        // discarded as soon as it violates the NBODY-rule or the cutoff radii.
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif
+        for (long ii = 0; ii < static_cast<long>(natmin); ++ii) {
+            std::vector<int> intlist(interaction_pair_in[ii]);
+            std::sort(intlist.begin(), intlist.end());
+            intlist.erase(std::unique(intlist.begin(), intlist.end()), intlist.end());
+
+            generate_cluster_candidates(order,
+                                        map_p2s[ii][0],
+                                        intlist,
+                                        kd,
+                                        x_image,
+                                        exist,
+                                        data_vec[ii]);
+        }
 
-                list_now[0] = iat;
-                for (auto m = 0; m < order + 1; ++m) list_now[m + 1] = data[m];
+        for (i = 0; i < natmin; ++i) {
+            for (j = 0; j < data_vec[i].size(); ++j) {
+                items.emplace_back(i, j);
+            }
+        }
+    }
 
-                // Save as a candidate if the cluster satisfies the NBODY-rule.
-                if (satisfy_nbody_rule(order + 2, list_now, order)) {
-                    data_vec.emplace_back(data);
+    // The mirror images of the candidate clusters are examined in parallel.
+    // Each candidate has distinct atoms, so the results of the threads
+    // are merged without conflicts.
+
+#ifdef _OPENMP
+    const auto nthreads = omp_get_max_threads();
+#else
+    const auto nthreads = 1;
+#endif
+    std::vector<std::vector<InteractionCluster>> cluster_thread(nthreads);
+    std::vector<std::vector<size_t>> index_thread(nthreads);
+
+#ifdef _OPENMP
+#pragma omp parallel
+#endif
+    {
+        size_t k, ii;
+        int jat_omp, jkd;
+        int icount;
+        double dist_tmp, rc_tmp;
+        bool isok;
+
+        std::vector<int> cell_vector;
+        std::vector<double> dist_vector;
+        std::vector<std::vector<int>> pairs_icell;
+        std::vector<std::vector<int>> comb_cell_atom_center;
+        std::vector<size_t> digit;
+        std::vector<int> intpair_uniq, cellpair;
+        std::vector<int> group_atom;
+        std::vector<MinDistList> distance_list;
+
+#ifdef _OPENMP
+        const auto ithread = omp_get_thread_num();
+#else
+        const auto ithread = 0;
+#endif
+
+#ifdef _OPENMP
+#pragma omp for schedule(dynamic, 16)
+#endif
+        for (long item = 0; item < static_cast<long>(items.size()); ++item) {
+
+            const auto i_omp = items[item].first;
+            const auto &data_now = data_vec[i_omp][items[item].second];
+            const auto iat = map_p2s[i_omp][0];
+            const auto ikd = kd[iat] - 1;
+
+            // Uniq the list of atoms in data like as follows:
+            // cubic   term : (i, i) --> (i) x 2
+            // quartic term : (i, i, j) --> (i, j) x (2, 1)
+            intpair_uniq.clear();
+            group_atom.clear();
+            icount = 1;
+
+            for (auto m = 0; m < order; ++m) {
+                if (data_now[m] == data_now[m + 1]) {
+                    ++icount;
+                } else {
+                    group_atom.push_back(icount);
+                    intpair_uniq.push_back(data_now[m]);
+                    icount = 1;
                 }
+            }
+            group_atom.push_back(icount);
+            intpair_uniq.push_back(data_now[order]);
+
+            pairs_icell.resize(intpair_uniq.size());
+            for (k = 0; k < intpair_uniq.size(); ++k) {
+                jat_omp = intpair_uniq[k];
+                jkd = kd[jat_omp] - 1;
+
+                rc_tmp = cutoff_radii[order][ikd][jkd];
+                cell_vector.clear();
+
+                // Loop over the cell images of atom 'jat' and add to the list
+                // as a candidate for the cluster.
+                // The mirror images whose distance is larger than the minimum value
+                // of the distance(iat, jat) can be added to the cell_vector list.
+                for (const auto &it : distall.get(iat, jat_omp)) {
+                    if (exist[it.cell]) {
+                        if (rc_tmp < 0.0 || it.dist <= rc_tmp) {
+                            cell_vector.push_back(it.cell);
+                        }
+                    }
+                }
+                pairs_icell[k].swap(cell_vector);
+            }
 
-            } while (g.next());
-
-            intlist.clear();
+            distance_list.clear();
+            auto has_next = first_cell_combination(pairs_icell, digit);
 
-            const auto ndata = data_vec.size();
+            while (has_next) {
 
-            for (size_t idata = 0; idata < ndata; ++idata) {
+                set_cell_combination(pairs_icell, digit, group_atom, cellpair);
 
-                data_now = data_vec[idata];
+                dist_vector.clear();
 
-                // Uniq the list of atoms in data like as follows:
-                // cubic   term : (i, i) --> (i) x 2
-                // quartic term : (i, i, j) --> (i, j) x (2, 1)
-                intpair_uniq.clear();
-                group_atom.clear();
-                icount = 1;
+                for (k = 0; k < cellpair.size(); ++k) {
+                    dist_tmp = distance(x_image[cellpair[k]][data_now[k]], x_image[0][iat]);
+                    dist_vector.push_back(dist_tmp);
+                }
 
-                for (auto m = 0; m < order; ++m) {
-                    if (data_now[m] == data_now[m + 1]) {
-                        ++icount;
-                    } else {
-                        group_atom.push_back(icount);
-                        intpair_uniq.push_back(data_now[m]);
-                        icount = 1;
+                // Flag to check if the distance is smaller than the cutoff radius
+                isok = true;
+
+                for (k = 0; k < cellpair.size(); ++k) {
+                    for (ii = k + 1; ii < cellpair.size(); ++ii) {
+                        dist_tmp = distance(x_image[cellpair[k]][data_now[k]],
+                                            x_image[cellpair[ii]][data_now[ii]]);
+                        rc_tmp = cutoff_radii[order][kd[data_now[k]] - 1][kd[data_now[ii]] - 1];
+                        if (rc_tmp >= 0.0 && dist_tmp > rc_tmp) {
+                            isok = false;
+                            break;
+                        }
+                        dist_vector.push_back(dist_tmp);
                     }
+                    if (!isok) break;
                 }
-                group_atom.push_back(icount);
-                intpair_uniq.push_back(data_now[order]);
-
-                pairs_icell.clear();
-                for (j = 0; j < intpair_uniq.size(); ++j) {
-                    jat = intpair_uniq[j];
-                    jkd = kd[jat] - 1;
-
-                    rc_tmp = cutoff_radii[order][ikd][jkd];
-                    cell_vector.clear();
-
-                    // Loop over the cell images of atom 'jat' and add to the list
-                    // as a candidate for the cluster.
-                    // The mirror images whose distance is larger than the minimum value
-                    // of the distance(iat, jat) can be added to the cell_vector list.
-                    for (const auto &it : distall[iat][jat]) {
-                        if (exist[it.cell]) {
-                            if (rc_tmp < 0.0 || it.dist <= rc_tmp) {
-                                cell_vector.push_back(it.cell);
-                            }
-                        }
+                if (isok) {
+                    // This combination is a candidate of the minimum distance cluster
+                    distance_list.emplace_back(MinDistList(cellpair, dist_vector));
+                }
+
+                has_next = next_cell_combination(pairs_icell, digit);
+            } // close loop over the mirror image combination
+
+            if (!distance_list.empty()) {
+                // If the distance_list is not empty, there is a set of mirror images
+                // that satisfies the condition of the cluster.
+
+                for (k = 0; k < intpair_uniq.size(); ++k) {
+                    jat_omp = intpair_uniq[k];
+                    pairs_icell[k].clear();
+                    for (const auto &it : mindist_pairs.get(iat, jat_omp)) {
+                        pairs_icell[k].push_back(it.cell);
                     }
-                    pairs_icell.push_back(cell_vector);
                 }
 
-                accum_tmp.clear();
-                comb_cell.clear();
-                cell_combination(pairs_icell, 0, accum_tmp, comb_cell);
+                comb_cell_atom_center.clear();
+                has_next = first_cell_combination(pairs_icell, digit);
+                while (has_next) {
+                    set_cell_combination(pairs_icell, digit, group_atom, cellpair);
+                    comb_cell_atom_center.push_back(cellpair);
+                    has_next = next_cell_combination(pairs_icell, digit);
+                }
 
-                distance_list.clear();
-                for (j = 0; j < comb_cell.size(); ++j) {
+                std::sort(distance_list.begin(), distance_list.end(),
+                          MinDistList::compare_max_distance);
+                const auto distmax_omp = *std::max_element(distance_list[0].dist.begin(),
+                                                           distance_list[0].dist.end());
+                cluster_thread[ithread].emplace_back(InteractionCluster(data_now,
+                                                                        comb_cell_atom_center,
+                                                                        distmax_omp));
+                index_thread[ithread].push_back(i_omp);
+            }
+        }
+    }
 
-                    cellpair.clear();
+    for (auto ith = 0; ith < nthreads; ++ith) {
+        for (j = 0; j < cluster_thread[ith].size(); ++j) {
+            cluster_tmp[index_thread[ith][j]].emplace_back(std::move(cluster_thread[ith][j]));
+        }
+    }
 
-                    for (k = 0; k < group_atom.size(); ++k) {
-                        for (auto m = 0; m < group_atom[k]; ++m) {
-                            cellpair.push_back(comb_cell[j][k]);
-                        }
-                    }
+    for (i = 0; i < natmin; ++i) {
+        interaction_cluster_out[i].build(order + 1, cluster_tmp[i]);
+    }
+}
 
-                    dist_vector.clear();
+void Cluster::generate_cluster_candidates(const int order,
+                                          const int iat,
+                                          const std::vector<int> &intlist,
+                                          const std::vector<int> &kd,
+                                          const double * const * const *x_image,
+                                          const int *exist,
+                                          std::vector<std::vector<int>> &data_out) const
+{
+    //
+    // Enumerate the combinations with repetition of (order + 1) atoms in intlist
+    // by a depth-first search, in the same lexicographic order as
+    // CombinationWithRepetition. A partial cluster is rejected when
+    // the number of distinct atoms exceeds NBODY or when a pair of atoms
+    // cannot be within the cutoff radius for any of their allowed images.
+    //
 
-                    for (k = 0; k < cellpair.size(); ++k) {
-                        dist_tmp = distance(x_image[cellpair[k]][data_now[k]], x_image[0][iat]);
-                        dist_vector.push_back(dist_tmp);
-                    }
+    size_t p, q;
+    const auto nsize = order + 1;
+    const auto natoms = intlist.size();
+    const auto ikd = kd[iat] - 1;
+
+    data_out.clear();
+    if (natoms == 0) return;
+
+    // Cells of each atom whose distance from iat is within the cutoff radius.
+    std::vector<std::vector<int>> cells(natoms);
+    for (p = 0; p < natoms; ++p) {
+        const auto jat = intlist[p];
+        const auto rc_tmp = cutoff_radii[order][ikd][kd[jat] - 1];
+        for (const auto &it : distall.get(iat, jat)) {
+            if (exist[it.cell] && (rc_tmp < 0.0 || it.dist <= rc_tmp)) {
+                cells[p].push_back(it.cell);
+            }
+        }
+    }
 
-                    // Flag to check if the distance is smaller than the cutoff radius
-                    isok = true;
-
-                    for (k = 0; k < cellpair.size(); ++k) {
-                        for (ii = k + 1; ii < cellpair.size(); ++ii) {
-                            dist_tmp = distance(x_image[cellpair[k]][data_now[k]],
-                                                x_image[cellpair[ii]][data_now[ii]]);
-                            rc_tmp = cutoff_radii[order][kd[data_now[k]] - 1][kd[data_now[ii]] - 1];
-                            if (rc_tmp >= 0.0 && dist_tmp > rc_tmp) {
-                                isok = false;
-                                break;
-                            }
-                            dist_vector.push_back(dist_tmp);
+    // 1: compatible, 0: incompatible, -1: not yet evaluated
+    std::vector<signed char> compatible(natoms * natoms, -1);
+
+    const auto is_compatible = [&](const size_t p1, const size_t p2) {
+        auto &flag = compatible[p1 * natoms + p2];
+        if (flag < 0) {
+            const auto jat = intlist[p1];
+            const auto kat = intlist[p2];
+            const auto rc_tmp = cutoff_radii[order][kd[jat] - 1][kd[kat] - 1];
+            flag = 0;
+            if (rc_tmp < 0.0) {
+                flag = 1;
+            } else {
+                for (const auto cj : cells[p1]) {
+                    for (const auto ck : cells[p2]) {
+                        if (distance(x_image[cj][jat], x_image[ck][kat]) <= rc_tmp) {
+                            flag = 1;
+                            break;
                         }
-                        if (!isok) break;
-                    }
-                    if (isok) {
-                        // This combination is a candidate of the minimum distance cluster
-                        distance_list.emplace_back(MinDistList(cellpair, dist_vector));
                     }
-                } // close loop over the mirror image combination
+                    if (flag) break;
+                }
+            }
+        }
+        return flag == 1;
+    };
 
-                if (!distance_list.empty()) {
-                    // If the distance_list is not empty, there is a set of mirror images
-                    // that satisfies the condition of the cluster.
+    // index[l] : position in intlist of the l-th atom
+    // ndistinct[l] : number of distinct atoms in (iat, data[0], ..., data[l])
+    std::vector<size_t> index(nsize, 0);
+    std::vector<int> ndistinct(nsize, 0);
+    std::vector<int> data(nsize);
 
-                    pairs_icell.clear();
-                    for (j = 0; j < intpair_uniq.size(); ++j) {
-                        jat = intpair_uniq[j];
-                        cell_vector.clear();
+    auto level = 0;
 
-                        for (ii = 0; ii < mindist_pairs[iat][jat].size(); ++ii) {
-                            cell_vector.push_back(mindist_pairs[iat][jat][ii].cell);
-                        }
-                        pairs_icell.push_back(cell_vector);
-                    }
+    while (level >= 0) {
 
-                    accum_tmp.clear();
-                    comb_cell.clear();
-                    comb_cell_atom_center.clear();
-                    cell_combination(pairs_icell, 0, accum_tmp, comb_cell);
-
-                    for (j = 0; j < comb_cell.size(); ++j) {
-                        cellpair.clear();
-                        for (k = 0; k < group_atom.size(); ++k) {
-                            for (auto m = 0; m < group_atom[k]; ++m) {
-                                cellpair.push_back(comb_cell[j][k]);
-                            }
-                        }
-                        comb_cell_atom_center.push_back(cellpair);
-                    }
+        if (index[level] >= natoms) {
+            // Backtrack
+            --level;
+            if (level >= 0) ++index[level];
+            continue;
+        }
+
+        p = index[level];
+        auto accept = !cells[p].empty();
 
-                    std::sort(distance_list.begin(), distance_list.end(),
-                              MinDistList::compare_max_distance);
-                    distmax = *std::max_element(distance_list[0].dist.begin(),
-                                                distance_list[0].dist.end());
-                    interaction_cluster_out[i].insert(InteractionCluster(data_now,
-                                                                         comb_cell_atom_center,
-                                                                         distmax));
+        if (accept) {
+            if (level == 0) {
+                ndistinct[0] = (intlist[p] == iat) ? 1 : 2;
+            } else {
+                ndistinct[level] = ndistinct[level - 1];
+                if (p != index[level - 1] && intlist[p] != iat) ++ndistinct[level];
+            }
+            accept = ndistinct[level] <= nbody_include[order];
+        }
+
+        if (accept) {
+            for (auto m = 0; m < level; ++m) {
+                q = index[m];
+                if (q != p && !is_compatible(q, p)) {
+                    accept = false;
+                    break;
                 }
             }
         }
+
+        if (!accept) {
+            ++index[level];
+            continue;
+        }
+
+        if (level == nsize - 1) {
+            for (auto m = 0; m < nsize; ++m) data[m] = intlist[index[m]];
+            data_out.push_back(data);
+            ++index[level];
+        } else {
+            index[level + 1] = index[level];
+            ++level;
+        }
     }
-    deallocate(list_now);
 }
 
+bool Cluster::first_cell_combination(const std::vector<std::vector<int>> &array,
+                                     std::vector<size_t> &digit) const
+{
+    // Start the odometer over the combinations of array[0][*] x array[1][*] x ...
+    // Returns false if there is no combination.
+
+    digit.assign(array.size(), 0);
+    for (const auto &it : array) {
+        if (it.empty()) return false;
+    }
+    return true;
+}
+
+bool Cluster::next_cell_combination(const std::vector<std::vector<int>> &array,
+                                    std::vector<size_t> &digit) const
+{
+    // The last digit runs fastest.
+    for (auto k = static_cast<long>(digit.size()) - 1; k >= 0; --k) {
+        if (++digit[k] < array[k].size()) return true;
+        digit[k] = 0;
+    }
+    return false;
+}
 
-void Cluster::cell_combination(const std::vector<std::vector<int>> &array,
-                               const size_t i,
-                               const std::vector<int> &accum,
-                               std::vector<std::vector<int>> &comb) const
+void Cluster::set_cell_combination(const std::vector<std::vector<int>> &array,
+                                   const std::vector<size_t> &digit,
+                                   const std::vector<int> &group_atom,
+                                   std::vector<int> &cellpair) const
 {
-    if (i == array.size()) {
-        comb.push_back(accum);
-    } else {
-        auto row = array[i];
-        for (auto j : row) {
-            auto tmp(accum);
-            tmp.push_back(j);
-            cell_combination(array, i + 1, tmp, comb);
+    // The cell of each unique atom is repeated for the number of its occurrence.
+    cellpair.clear();
+    for (size_t k = 0; k < group_atom.size(); ++k) {
+        for (auto m = 0; m < group_atom[k]; ++m) {
+            cellpair.push_back(array[k][digit[k]]);
         }
     }
 }
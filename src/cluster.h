@@ -85,6 +85,33 @@ namespace ALM_NS
         }
     };
 
+    class PairDistanceTable
+    {
+        // Lists of DistInfo for the atom pairs (i, j). A row i holds either
+        // all the atoms j (dense row) or only the atoms j given to set_row.
+        // For a pair that is not stored, get() returns a single entry
+        // at an infinite distance.
+    public:
+        PairDistanceTable();
+
+        void init(const size_t nat_in);
+
+        // cols must be in ascending order. An empty cols makes a dense row,
+        // where lists_in has nat entries.
+        void set_row(const size_t i,
+                     std::vector<size_t> &cols_in,
+                     std::vector<std::vector<DistInfo>> &lists_in);
+
+        const std::vector<DistInfo>& get(const size_t i,
+                                         const size_t j) const;
+
+    private:
+        size_t nat;
+        std::vector<std::vector<size_t>> cols;
+        std::vector<std::vector<std::vector<DistInfo>>> lists;
+        std::vector<DistInfo> far_pair;
+    };
+
     class DistList
         // This class is used only in print_neighborlist. Can be replaced by a more generalic function.
     {
@@ -173,6 +200,105 @@ namespace ALM_NS
         }
     };
 
+    class ClusterTable
+    {
+        // Sorted list of unique atom clusters of a fixed size.
+        // The atoms of the clusters are packed into a single array.
+    public:
+        ClusterTable();
+
+        void init(const int nelems_in);
+
+        // The clusters may be added in any order and with duplicates.
+        // Call sort_unique after the last push_back.
+        void push_back(const int *arr);
+        void sort_unique();
+
+        size_t size() const
+        {
+            return nelems > 0 ? atoms.size() / nelems : 0;
+        }
+
+        int get_nelems() const
+        {
+            return nelems;
+        }
+
+        const int* operator[](const size_t i) const
+        {
+            return &atoms[i * nelems];
+        }
+
+    private:
+        int nelems;
+        std::vector<int> atoms;
+    };
+
+    class InteractionClusterTable
+    {
+        // Interaction clusters of a primitive atom sorted by their atoms.
+        // The cells of the mirror images are stored in the CSR format:
+        // the images of the i-th cluster are in [image_offset[i], image_offset[i + 1]).
+    public:
+        static const size_t npos;
+
+        InteractionClusterTable();
+
+        // Replaces the content with the given clusters, which are consumed.
+        // Only the first of the clusters having the same atoms is kept.
+        void build(const int nelems_in,
+                   std::vector<InteractionCluster> &clusters_in);
+
+        void clear();
+
+        size_t size() const
+        {
+            return distmax.size();
+        }
+
+        int get_nelems() const
+        {
+            return nelems;
+        }
+
+        const int* get_atoms(const size_t i) const
+        {
+            return &atoms[i * nelems];
+        }
+
+        double get_distmax(const size_t i) const
+        {
+            return distmax[i];
+        }
+
+        size_t get_number_of_images(const size_t i) const
+        {
+            return image_offset[i + 1] - image_offset[i];
+        }
+
+        const int* get_cells(const size_t i,
+                             const size_t image) const
+        {
+            return &cells[(image_offset[i] + image) * nelems];
+        }
+
+        // Returns the index of the cluster with the sorted atoms,
+        // or npos if it does not exist.
+        size_t find(const int *atoms_in) const;
+
+        size_t find(const std::vector<int> &atoms_in) const
+        {
+            return find(&atoms_in[0]);
+        }
+
+    private:
+        int nelems;
+        std::vector<int> atoms;
+        std::vector<double> distmax;
+        std::vector<size_t> image_offset;
+        std::vector<int> cells;
+    };
+
     class Cluster
     {
     public:
@@ -200,34 +326,50 @@ namespace ALM_NS
 
         int get_maxorder() const;
         int* get_nbody_include() const;
+        double*** get_cutoff_radii() const;
+        double get_maximum_cutoff_radius(const size_t nkd) const;
         std::string get_ordername(const unsigned int order) const;
-        const std::set<IntList>& get_cluster_list(const unsigned int order) const;
+        const ClusterTable& get_cluster_list(const unsigned int order) const;
         const std::vector<int>& get_interaction_pair(const unsigned int order,
                                                      const size_t atom_index) const;
-        const std::set<InteractionCluster>& get_interaction_cluster(const unsigned int order,
-                                                                    const size_t atom_index) const;
+        const InteractionClusterTable& get_interaction_cluster(const unsigned int order,
+                                                               const size_t atom_index) const;
 
     private:
 
         int maxorder;
         int *nbody_include;
         double ***cutoff_radii;
-        std::set<IntList> *cluster_list;
+        ClusterTable *cluster_list;
         std::vector<int> **interaction_pair; // List of atoms inside the cutoff radius for each order
-        std::set<InteractionCluster> **interaction_cluster;
+        InteractionClusterTable **interaction_cluster;
 
-        std::vector<DistInfo> **distall;       // Distance of all pairs (i,j) under the PBC
-        std::vector<DistInfo> **mindist_pairs; // All pairs (i,j) with the minimum distance
+        PairDistanceTable distall;       // Distance of pairs (i,j) under the PBC (i in the primitive cell)
+        PairDistanceTable mindist_pairs; // Pairs (i,j) with the minimum distance
         // Interacting many-body clusters with mirrow image information
 
         void set_default_variables();
         void deallocate_variables();
 
-        // can be made const function, but mindist_pairs is modified
-        // in this function.
         void get_pairs_of_minimum_distance(const size_t nat,
+                                           const size_t nkd,
+                                           const size_t natmin,
+                                           const std::vector<std::vector<int>> &map_p2s,
                                            const double * const * const *xc_in,
-                                           const int *exist) const;
+                                           const ImageCoordinates &x_soa,
+                                           const int *exist);
+
+        void get_distance_of_images(const size_t iat,
+                                    const size_t jat,
+                                    const size_t nimage,
+                                    const double * const * const *xc_in,
+                                    const int *exist,
+                                    const double *dist_in,
+                                    const size_t dist_stride,
+                                    std::vector<DistInfo> &dist_out) const;
+
+        void get_images_of_minimum_distance(const std::vector<DistInfo> &dist_in,
+                                            std::vector<DistInfo> &dist_out) const;
 
         void generate_interaction_information_by_cutoff(const size_t nat,
                                                         const size_t natmin,
@@ -271,16 +413,30 @@ namespace ALM_NS
                                      const std::vector<int> *interaction_pair_in,
                                      const double * const * const *x_image,
                                      const int *exist,
-                                     std::set<InteractionCluster> *interaction_cluster_out) const;
+                                     InteractionClusterTable *interaction_cluster_out) const;
+
+        void generate_cluster_candidates(const int order,
+                                         const int iat,
+                                         const std::vector<int> &intlist,
+                                         const std::vector<int> &kd,
+                                         const double * const * const *x_image,
+                                         const int *exist,
+                                         std::vector<std::vector<int>> &data_out) const;
+
+        bool first_cell_combination(const std::vector<std::vector<int>> &array,
+                                    std::vector<size_t> &digit) const;
+
+        bool next_cell_combination(const std::vector<std::vector<int>> &array,
+                                   std::vector<size_t> &digit) const;
 
-        void cell_combination(const std::vector<std::vector<int>> &,
-                              const size_t,
-                              const std::vector<int> &,
-                              std::vector<std::vector<int>> &) const;
+        void set_cell_combination(const std::vector<std::vector<int>> &array,
+                                  const std::vector<size_t> &digit,
+                                  const std::vector<int> &group_atom,
+                                  std::vector<int> &cellpair) const;
 
         void generate_pairs(const size_t natmin,
                             const std::vector<std::vector<int>> &map_p2s,
-                            std::set<IntList> *pair_out) const;
+                            ClusterTable *pair_out) const;
     };
 }
 
@@ -17,6 +17,7 @@
 #include "mathfunctions.h"
 #include "memory.h"
 #include "rref.h"
+#include "setup_cache.h"
 #include "symmetry.h"
 #include "system.h"
 #include "timer.h"
@@ -25,12 +26,11 @@
 #include <iomanip>
 #include <boost/bimap.hpp>
 #include <algorithm>
-#include <unordered_set>
 #include <map>
-#include <boost/property_tree/ptree.hpp>
-#include <boost/property_tree/xml_parser.hpp>
-#include <boost/foreach.hpp>
-#include <boost/lexical_cast.hpp>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 using namespace ALM_NS;
 
@@ -50,6 +50,7 @@ void Constraint::set_default_variables()
     rotation_axis = "";
     fix_harmonic = false;
     fix_cubic = false;
+    use_fc_file_binary = false;
     constraint_algebraic = 1;
     fc2_file = "";
     fc3_file = "";
@@ -61,7 +62,9 @@ void Constraint::set_default_variables()
     const_fix = nullptr;
     const_relate = nullptr;
     const_relate_rotation = nullptr;
+    index_map = nullptr;
     index_bimap = nullptr;
+    index_bimap_once = nullptr;
     number_of_constraints = 0;
     tolerance_constraint = eps8;
 }
@@ -80,9 +83,15 @@ void Constraint::deallocate_variables()
     if (const_relate_rotation) {
         deallocate(const_relate_rotation);
     }
+    if (index_map) {
+        deallocate(index_map);
+    }
     if (index_bimap) {
         deallocate(index_bimap);
     }
+    if (index_bimap_once) {
+        deallocate(index_bimap_once);
+    }
     if (const_mat) {
         deallocate(const_mat);
     }
@@ -97,7 +106,8 @@ void Constraint::setup(const System *system,
                        const Symmetry *symmetry,
                        const int linear_model,
                        const int verbosity,
-                       Timer *timer)
+                       Timer *timer,
+                       const SetupCache *setup_cache)
 {
     timer->start_clock("constraint");
 
@@ -176,14 +186,62 @@ void Constraint::setup(const System *system,
     if (const_relate) {
         deallocate(const_relate);
     }
+    if (index_map) {
+        deallocate(index_map);
+    }
     if (index_bimap) {
         deallocate(index_bimap);
     }
+    if (index_bimap_once) {
+        deallocate(index_bimap_once);
+    }
 
     allocate(const_fix, maxorder);
     allocate(const_relate, maxorder);
+    allocate(index_map, maxorder);
     allocate(index_bimap, maxorder);
+    allocate(index_bimap_once, maxorder);
     allocate(const_symmetry, maxorder);
+
+    fix_cubic = fix_cubic & (cluster->get_maxorder() > 1);
+
+    uint64_t key_cache = 0;
+    if (setup_cache) {
+        auto axis_sorted = rotation_axis;
+        std::sort(axis_sorted.begin(), axis_sorted.end());
+        key_cache = setup_cache->get_key_constraint(constraint_mode,
+                                                    constraint_algebraic,
+                                                    impose_inv_R ? axis_sorted : "",
+                                                    tolerance_constraint,
+                                                    fix_harmonic ? fc2_file : "",
+                                                    fix_cubic ? fc3_file : "");
+
+        if (load_constraint_from_cache(setup_cache, key_cache, maxorder, fcs)) {
+            if (verbosity > 0) {
+                std::cout << "  Constraints are loaded from the setup cache ("
+                    << setup_cache->get_filename() << ")." << std::endl << std::endl;
+
+                if (exist_constraint) {
+                    if (constraint_algebraic) {
+                        for (auto order = 0; order < maxorder; ++order) {
+                            std::cout << "  Number of free" << std::setw(9) << cluster->get_ordername(order)
+                                << " FCs : " << index_map[order].size() << std::endl;
+                        }
+                        std::cout << std::endl;
+                    } else {
+                        std::cout << "  Total number of constraints = " << number_of_constraints
+                            << std::endl << std::endl;
+                    }
+                }
+                timer->print_elapsed();
+                std::cout << " -------------------------------------------------------------------" << std::endl;
+                std::cout << std::endl;
+            }
+            timer->stop_clock("constraint");
+            return;
+        }
+    }
+
     allocate(const_translation, maxorder);
     allocate(const_rotation_self, maxorder);
     allocate(const_rotation_cross, maxorder);
@@ -212,7 +270,6 @@ void Constraint::setup(const System *system,
                                    const_fix[0]);
     }
 
-    fix_cubic = fix_cubic & (cluster->get_maxorder() > 1);
     if (fix_cubic) {
 
         if (verbosity > 0) {
@@ -293,7 +350,7 @@ void Constraint::setup(const System *system,
                            const_self,
                            const_fix,
                            const_relate,
-                           index_bimap);
+                           index_map);
 
     if (!constraint_algebraic) {
 
@@ -395,7 +452,7 @@ void Constraint::setup(const System *system,
 
                 for (order = 0; order < maxorder; ++order) {
                     std::cout << "  Number of free" << std::setw(9) << cluster->get_ordername(order)
-                        << " FCs : " << index_bimap[order].size() << std::endl;
+                        << " FCs : " << index_map[order].size() << std::endl;
                 }
                 std::cout << std::endl;
 
@@ -411,6 +468,23 @@ void Constraint::setup(const System *system,
     }
 
 
+    if (setup_cache) {
+        size_t nparams = 0;
+        for (auto order = 0; order < maxorder; ++order) {
+            nparams += fcs->get_nequiv()[order].size();
+        }
+        setup_cache->save_constraint(key_cache,
+                                     maxorder,
+                                     nparams,
+                                     const_fix,
+                                     const_relate,
+                                     index_map,
+                                     extra_constraint_from_symmetry,
+                                     number_of_constraints,
+                                     constraint_algebraic ? nullptr : const_mat,
+                                     constraint_algebraic ? nullptr : const_rhs);
+    }
+
     deallocate(const_translation);
     const_translation = nullptr;
     deallocate(const_rotation_self);
@@ -423,6 +497,72 @@ void Constraint::setup(const System *system,
     timer->stop_clock("constraint");
 }
 
+bool Constraint::load_constraint_from_cache(const SetupCache *setup_cache,
+                                            const uint64_t key_cache,
+                                            const int maxorder,
+                                            const Fcs *fcs)
+{
+    size_t nparams = 0;
+    size_t nconst;
+    std::vector<double> mat_tmp, rhs_tmp;
+
+    for (auto order = 0; order < maxorder; ++order) {
+        nparams += fcs->get_nequiv()[order].size();
+    }
+
+    if (!setup_cache->load_constraint(key_cache,
+                                      maxorder,
+                                      nparams,
+                                      const_fix,
+                                      const_relate,
+                                      index_map,
+                                      extra_constraint_from_symmetry,
+                                      nconst,
+                                      mat_tmp,
+                                      rhs_tmp)) {
+        return false;
+    }
+
+    if (!constraint_algebraic) {
+        number_of_constraints = nconst;
+
+        if (const_mat) {
+            deallocate(const_mat);
+            const_mat = nullptr;
+        }
+        if (const_rhs) {
+            deallocate(const_rhs);
+            const_rhs = nullptr;
+        }
+        if (number_of_constraints > 0) {
+            allocate(const_mat, number_of_constraints, nparams);
+            allocate(const_rhs, number_of_constraints);
+            for (size_t i = 0; i < number_of_constraints; ++i) {
+                for (size_t j = 0; j < nparams; ++j) {
+                    const_mat[i][j] = mat_tmp[i * nparams + j];
+                }
+                const_rhs[i] = rhs_tmp[i];
+            }
+        }
+    }
+
+    exist_constraint
+        = impose_inv_T
+        || fix_harmonic
+        || fix_cubic
+        || extra_constraint_from_symmetry;
+
+    return true;
+}
+
+void Constraint::make_index_bimap(const int order) const
+{
+    for (size_t i = 0; i < index_map[order].size(); ++i) {
+        index_bimap[order].insert(
+            boost::bimap<size_t, size_t>::value_type(i, index_map[order].get_orig(i)));
+    }
+}
+
 size_t Constraint::calc_constraint_matrix(const int maxorder,
                                           const std::vector<size_t> *nequiv,
                                           const size_t nparams) const
@@ -537,7 +677,7 @@ void Constraint::get_mapping_constraint(const int nmax,
                                         const ConstraintSparseForm *const_in,
                                         std::vector<ConstraintTypeFix> *const_fix_out,
                                         std::vector<ConstraintTypeRelate> *const_relate_out,
-                                        boost::bimap<size_t, size_t> *index_bimap_out) const
+                                        ConstraintIndexMap *index_map_out) const
 {
     // If const_fix_out[order] is not empty as input, it assumes that fix_forceconstant[order] is true.
     // In this case, const_fix_out[order] is not updated.
@@ -619,17 +759,13 @@ void Constraint::get_mapping_constraint(const int nmax,
         }
     }
 
-    size_t icount;
-
     for (order = 0; order < nmax; ++order) {
         nparam = nequiv[order].size();
 
-        icount = 0;
+        index_map_out[order].init(nparam);
         for (i = 0; i < nparam; ++i) {
             if (has_constraint[order][i] == 0) {
-                index_bimap_out[order].insert(
-                    boost::bimap<size_t, size_t>::value_type(icount, i));
-                ++icount;
+                index_map_out[order].push_back(i);
             }
         }
     }
@@ -699,6 +835,16 @@ void Constraint::set_fix_cubic(const bool fix_cubic_in)
     fix_cubic = fix_cubic_in;
 }
 
+bool Constraint::get_fc_file_binary() const
+{
+    return use_fc_file_binary;
+}
+
+void Constraint::set_fc_file_binary(const bool use_fc_file_binary_in)
+{
+    use_fc_file_binary = use_fc_file_binary_in;
+}
+
 int Constraint::get_constraint_algebraic() const
 {
     return constraint_algebraic;
@@ -744,11 +890,6 @@ void Constraint::set_rotation_axis(const std::string rotation_axis_in)
     rotation_axis = rotation_axis_in;
 }
 
-const ConstraintSparseForm& Constraint::get_const_symmetry(const int order) const
-{
-    return const_symmetry[order];
-}
-
 const std::vector<ConstraintTypeFix>& Constraint::get_const_fix(const int order) const
 {
     return const_fix[order];
@@ -766,8 +907,14 @@ const std::vector<ConstraintTypeRelate>& Constraint::get_const_relate(const int
     return const_relate[order];
 }
 
+const ConstraintIndexMap& Constraint::get_index_map(const int order) const
+{
+    return index_map[order];
+}
+
 const boost::bimap<size_t, size_t>& Constraint::get_index_bimap(const int order) const
 {
+    std::call_once(index_bimap_once[order], &Constraint::make_index_bimap, this, order);
     return index_bimap[order];
 }
 
@@ -820,7 +967,8 @@ void Constraint::generate_symmetry_constraint_in_cartesian(const size_t nat,
                                                     symmetry,
                                                     order,
                                                     fcs->get_forceconstant_basis(),
-                                                    fcs->get_fc_table()[order],
+                                                    fcs->get_fc_property_table()[order],
+                                                    fcs->get_cluster_orbit_table(false)[order],
                                                     fcs->get_nequiv()[order].size(),
                                                     tolerance_constraint,
                                                     const_symmetry[order], true);
@@ -829,7 +977,8 @@ void Constraint::generate_symmetry_constraint_in_cartesian(const size_t nat,
                                          symmetry,
                                          order,
                                          fcs->get_forceconstant_basis(),
-                                         fcs->get_fc_table()[order],
+                                         fcs->get_fc_property_table()[order],
+                                         fcs->get_cluster_orbit_table(false)[order],
                                          fcs->get_nequiv()[order].size(),
                                          tolerance_constraint,
                                          const_symmetry[order], true);
@@ -875,7 +1024,7 @@ void Constraint::generate_translational_constraint(const Cell &supercell,
                                    cluster,
                                    fcs,
                                    order,
-                                   fcs->get_fc_table()[order],
+                                   fcs->get_fc_property_table()[order],
                                    fcs->get_nequiv()[order].size(),
                                    const_translation[order], true);
 
@@ -891,7 +1040,7 @@ void Constraint::get_constraint_translation(const Cell &supercell,
                                             const Cluster *cluster,
                                             const Fcs *fcs,
                                             const int order,
-                                            const std::vector<FcProperty> &fc_table,
+                                            const FcPropertyTable &fc_table,
                                             const size_t nparams,
                                             ConstraintSparseForm &const_out,
                                             const bool do_rref) const
@@ -903,7 +1052,6 @@ void Constraint::get_constraint_translation(const Cell &supercell,
     int idata;
     int loc_nonzero;
 
-    int *ind;
     int *intarr, *intarr_copy;
     int **xyzcomponent;
 
@@ -914,10 +1062,8 @@ void Constraint::get_constraint_translation(const Cell &supercell,
     unsigned int isize;
 
     std::vector<int> data;
-    std::unordered_set<FcProperty> list_found;
-    std::unordered_set<FcProperty>::iterator iter_found;
+    size_t iter_found;
     std::vector<std::vector<int>> data_vec;
-    std::vector<FcProperty> list_vec;
     std::vector<int> const_now;
 
     typedef std::vector<ConstraintIntegerElement> ConstEntry;
@@ -929,26 +1075,16 @@ void Constraint::get_constraint_translation(const Cell &supercell,
 
     if (nparams == 0) return;
 
-    allocate(ind, order + 2);
-
     // Create force constant table for search
 
-    list_found.clear();
+    FcPropertyIndex list_found(order + 2);
 
-    for (const auto &p : fc_table) {
-        for (i = 0; i < order + 2; ++i) {
-            ind[i] = p.elems[i];
-        }
-        if (list_found.find(FcProperty(order + 2, p.sign,
-                                       ind, p.mother)) != list_found.end()) {
+    for (size_t ifc = 0; ifc < fc_table.size(); ++ifc) {
+        if (!list_found.insert(fc_table.get_elems(ifc), fc_table.get_sign(ifc), fc_table.get_mother(ifc))) {
             exit("get_constraint_translation", "Duplicate interaction list found");
         }
-        list_found.insert(FcProperty(order + 2, p.sign,
-                                     ind, p.mother));
     }
 
-    deallocate(ind);
-
     // Generate xyz component for each order
 
     const auto nxyz = static_cast<int>(std::pow(static_cast<double>(3), order + 1));
@@ -981,13 +1117,12 @@ void Constraint::get_constraint_translation(const Cell &supercell,
                     for (jat = 0; jat < 3 * nat; jat += 3) {
                         intarr[1] = jat + jcrd;
 
-                        iter_found = list_found.find(FcProperty(order + 2, 1.0,
-                                                                intarr, 1));
+                        iter_found = list_found.find(intarr);
 
                         //  If found an IFC
-                        if (iter_found != list_found.end()) {
+                        if (iter_found != FcPropertyIndex::npos) {
                             // Round the coefficient to integer
-                            const_now[(*iter_found).mother] += nint((*iter_found).sign);
+                            const_now[list_found.get_mother(iter_found)] += nint(list_found.get_sign(iter_found));
                         }
 
                     }
@@ -1088,10 +1223,9 @@ void Constraint::get_constraint_translation(const Cell &supercell,
 
                                     sort_tail(order + 2, intarr_copy_omp);
 
-                                    iter_found = list_found.find(FcProperty(order + 2, 1.0,
-                                                                            intarr_copy_omp, 1));
-                                    if (iter_found != list_found.end()) {
-                                        const_now_omp[(*iter_found).mother] += nint((*iter_found).sign);
+                                    iter_found = list_found.find(intarr_copy_omp);
+                                    if (iter_found != FcPropertyIndex::npos) {
+                                        const_now_omp[list_found.get_mother(iter_found)] += nint(list_found.get_sign(iter_found));
                                     }
 
                                 }
@@ -1194,12 +1328,10 @@ void Constraint::generate_rotational_constraint(const System *system,
     int mu_lambda, lambda;
     int levi_factor;
 
-    int *ind;
     int **xyzcomponent = nullptr;
     int **xyzcomponent2 = nullptr;
     size_t *nparams, nparam_sub;
     int *interaction_index, *interaction_atom;
-    int *interaction_tmp;
     int loc_nonzero;
 
     std::vector<double> arr_constraint;
@@ -1210,28 +1342,29 @@ void Constraint::generate_rotational_constraint(const System *system,
 
     double vec_for_rot[3];
 
-    std::vector<int> interaction_list;
-
-    std::unordered_set<FcProperty> list_found;
-    std::unordered_set<FcProperty> list_found_last;
-    std::unordered_set<FcProperty>::iterator iter_found;
+    FcPropertyIndex list_found, list_found_last;
+    size_t iter_found;
 
-    CombinationWithRepetition<int> g;
+    size_t icluster;
 
     std::vector<int> atom_tmp;
-    std::vector<std::vector<int>> cell_dummy;
-    std::set<InteractionCluster>::iterator iter_cluster;
 
     typedef std::vector<ConstraintDoubleElement> ConstEntry;
     ConstEntry const_tmp;
     std::vector<ConstEntry> *const_self_vec, *const_cross_vec;
+    std::vector<std::vector<int>> data_vec;
+
+#ifdef _OPENMP
+    const auto nthreads = omp_get_max_threads();
+#else
+    const auto nthreads = 1;
+#endif
 
     allocate(const_self_vec, maxorder);
     allocate(const_cross_vec, maxorder);
 
     setup_rotation_axis(valid_rotation_axis);
 
-    allocate(ind, maxorder + 1);
     allocate(nparams, maxorder);
 
     for (order = 0; order < maxorder; ++order) {
@@ -1256,32 +1389,20 @@ void Constraint::generate_rotational_constraint(const System *system,
             nparam_sub = nparams[order] + nparams[order - 1];
         }
         arr_constraint.resize(nparam_sub);
-        arr_constraint_self.resize(nparams[order]);
-
-        if (order > 0) arr_constraint_lower.resize(nparams[order - 1]);
 
         allocate(interaction_atom, order + 2);
         allocate(interaction_index, order + 2);
-        allocate(interaction_tmp, order + 2);
         const_self_vec[order].clear();
         const_cross_vec[order].clear();
 
         if (order > 0) {
-            list_found_last = list_found;
+            list_found_last = std::move(list_found);
             nxyz = static_cast<int>(pow(static_cast<double>(3), order));
             allocate(xyzcomponent, nxyz, order);
             fcs->get_xyzcomponent(order, xyzcomponent);
         }
 
-        list_found.clear();
-
-        for (auto p = fcs->get_fc_table()[order].begin(); p != fcs->get_fc_table()[order].end(); ++p) {
-            for (i = 0; i < order + 2; ++i) {
-                ind[i] = (*p).elems[i];
-            }
-            list_found.insert(FcProperty(order + 2, (*p).sign,
-                                         ind, (*p).mother));
-        }
+        list_found = FcPropertyIndex(order + 2, fcs->get_fc_property_table()[order]);
 
         for (i = 0; i < natmin; ++i) {
 
@@ -1314,27 +1435,23 @@ void Constraint::generate_rotational_constraint(const System *system,
 
                                 jat = iter_list;
                                 interaction_index[1] = 3 * jat + mu;
-                                iter_found = list_found.find(FcProperty(order + 2, 1.0,
-                                                                        interaction_index, 1));
+                                iter_found = list_found.find(interaction_index);
 
-                                atom_tmp.clear();
-                                atom_tmp.push_back(jat);
-                                cell_dummy.clear();
-                                iter_cluster = cluster->get_interaction_cluster(order, i).find(
-                                    InteractionCluster(atom_tmp, cell_dummy));
+                                const auto &clusters_now = cluster->get_interaction_cluster(order, i);
+                                icluster = clusters_now.find(&jat);
 
-                                if (iter_cluster == cluster->get_interaction_cluster(order, i).end()) {
+                                if (icluster == InteractionClusterTable::npos) {
                                     exit("generate_rotational_constraint",
                                          "cluster not found ...");
                                 } else {
                                     for (j = 0; j < 3; ++j) vec_for_rot[j] = 0.0;
 
-                                    const auto nsize_equiv = (*iter_cluster).cell.size();
+                                    const auto nsize_equiv = clusters_now.get_number_of_images(icluster);
 
                                     for (j = 0; j < nsize_equiv; ++j) {
                                         for (auto k = 0; k < 3; ++k) {
                                             vec_for_rot[k]
-                                                += system->get_x_image()[(*iter_cluster).cell[j][0]][jat][k];
+                                                += system->get_x_image()[clusters_now.get_cells(icluster, j)[0]][jat][k];
                                         }
                                     }
 
@@ -1344,19 +1461,18 @@ void Constraint::generate_rotational_constraint(const System *system,
                                 }
 
 
-                                if (iter_found != list_found.end()) {
-                                    arr_constraint[(*iter_found).mother] += (*iter_found).sign * vec_for_rot[nu];
+                                if (iter_found != FcPropertyIndex::npos) {
+                                    arr_constraint[list_found.get_mother(iter_found)] += list_found.get_sign(iter_found) * vec_for_rot[nu];
                                 }
 
                                 // Exchange mu <--> nu and repeat again.
                                 // Note that the sign is inverted (+ --> -) in the summation
 
                                 interaction_index[1] = 3 * jat + nu;
-                                iter_found = list_found.find(FcProperty(order + 2, 1.0,
-                                                                        interaction_index, 1));
-                                if (iter_found != list_found.end()) {
-                                    arr_constraint[(*iter_found).mother]
-                                        -= (*iter_found).sign * vec_for_rot[mu];
+                                iter_found = list_found.find(interaction_index);
+                                if (iter_found != FcPropertyIndex::npos) {
+                                    arr_constraint[list_found.get_mother(iter_found)]
+                                        -= list_found.get_sign(iter_found) * vec_for_rot[mu];
                                 }
                             }
 
@@ -1386,226 +1502,283 @@ void Constraint::generate_rotational_constraint(const System *system,
                 std::sort(interaction_list_now.begin(), interaction_list_now.end());
                 std::sort(interaction_list_old.begin(), interaction_list_old.end());
 
-                for (icrd = 0; icrd < 3; ++icrd) {
+                // m    -th order --> (m-1)-th order
+                // (m-1)-th order -->     m-th order
+                // 2-different directions to find all constraints.
+                // The candidate clusters of both directions are stored in data_vec
+                // so that the (icrd, cluster) pairs can be distributed over threads.
+
+                data_vec.clear();
+                CombinationWithRepetition<int> g_now(interaction_list_now.begin(),
+                                                     interaction_list_now.end(), order);
+                do {
+                    data_vec.push_back(g_now.now());
+                } while (g_now.next());
+                const auto ndata_now = data_vec.size();
+
+                CombinationWithRepetition<int> g_old(interaction_list_old.begin(),
+                                                     interaction_list_old.end(), order);
+                do {
+                    data_vec.push_back(g_old.now());
+                } while (g_old.next());
+                const auto ndata = data_vec.size();
+                const auto nitems = static_cast<int>(3 * ndata);
+
+                // Each thread keeps its own constraint lists, which are merged
+                // in the order of the thread number after the parallel region.
+                // With the static schedule, this reproduces the serial order.
+                std::vector<std::vector<ConstEntry>> const_lower_thread(nthreads);
+                std::vector<std::vector<ConstEntry>> const_self_thread(nthreads);
+                std::vector<std::vector<ConstEntry>> const_cross_thread(nthreads);
+                auto cluster_not_found = false;
 
-                    interaction_index[0] = 3 * iat + icrd;
+#ifdef _OPENMP
+#pragma omp parallel private(j, jat, icrd, mu, nu, ixyz, lambda, jcrd, mu_lambda, levi_factor, loc_nonzero, vec_for_rot, arr_constraint, arr_constraint_self, arr_constraint_lower, atom_tmp, iter_found, icluster, const_tmp), reduction(||:cluster_not_found)
+#endif
+                {
+                    int *interaction_atom_omp, *interaction_index_omp, *interaction_tmp_omp;
+                    std::vector<ConstEntry> const_lower_omp, const_self_omp, const_cross_omp;
 
-                    const CombinationWithRepetition<int> g_now(interaction_list_now.begin(),
-                                                               interaction_list_now.end(), order);
-                    const CombinationWithRepetition<int> g_old(interaction_list_old.begin(),
-                                                               interaction_list_old.end(), order);
+                    arr_constraint.resize(nparam_sub);
+                    arr_constraint_self.resize(nparams[order]);
+                    arr_constraint_lower.resize(nparams[order - 1]);
 
-                    // m    -th order --> (m-1)-th order
-                    // (m-1)-th order -->     m-th order
-                    // 2-different directions to find all constraints
+                    allocate(interaction_atom_omp, order + 2);
+                    allocate(interaction_index_omp, order + 2);
+                    allocate(interaction_tmp_omp, order + 2);
 
-                    for (unsigned int direction = 0; direction < 2; ++direction) {
+                    interaction_atom_omp[0] = iat;
 
-                        if (direction == 0) {
-                            g = g_now;
-                            interaction_list = interaction_list_now;
-                        } else {
-                            g = g_old;
-                            interaction_list = interaction_list_old;
-                        }
+#ifdef _OPENMP
+                    const auto ithread = omp_get_thread_num();
+#else
+                    const auto ithread = 0;
+#endif
 
-                        // Loop for the interacting pairs
+#ifdef _OPENMP
+#pragma omp for schedule(static)
+#endif
+                    for (int item = 0; item < nitems; ++item) {
 
-                        do {
-                            auto data = g.now();
+                        icrd = static_cast<int>(item / ndata);
+                        const auto idata = item % ndata;
+                        const auto &interaction_list = idata < ndata_now ? interaction_list_now : interaction_list_old;
 
-                            for (size_t idata = 0; idata < data.size(); ++idata) {
-                                interaction_atom[idata + 1] = data[idata];
-                            }
+                        interaction_index_omp[0] = 3 * iat + icrd;
 
-                            for (ixyz = 0; ixyz < nxyz; ++ixyz) {
+                        for (j = 0; j < order; ++j) {
+                            interaction_atom_omp[j + 1] = data_vec[idata][j];
+                        }
 
-                                for (j = 0; j < order; ++j)
-                                    interaction_index[j + 1] = 3 * interaction_atom[j + 1] + xyzcomponent[ixyz][j];
+                        for (ixyz = 0; ixyz < nxyz; ++ixyz) {
 
-                                for (mu = 0; mu < 3; ++mu) {
+                            for (j = 0; j < order; ++j)
+                                interaction_index_omp[j + 1]
+                                    = 3 * interaction_atom_omp[j + 1] + xyzcomponent[ixyz][j];
 
-                                    for (nu = 0; nu < 3; ++nu) {
+                            for (mu = 0; mu < 3; ++mu) {
 
-                                        if (!valid_rotation_axis[mu][nu]) continue;
+                                for (nu = 0; nu < 3; ++nu) {
 
-                                        // Search for a new constraint below
+                                    if (!valid_rotation_axis[mu][nu]) continue;
 
-                                        for (j = 0; j < nparam_sub; ++j) arr_constraint[j] = 0.0;
+                                    // Search for a new constraint below
 
-                                        // Loop for m_{N+1}, a_{N+1}
-                                        for (auto &iter_list : interaction_list) {
-                                            jat = iter_list;
+                                    for (j = 0; j < nparam_sub; ++j) arr_constraint[j] = 0.0;
 
-                                            interaction_atom[order + 1] = jat;
-                                            if (!cluster->is_incutoff(order + 2,
-                                                                      interaction_atom,
-                                                                      order,
-                                                                      system->get_supercell().kind))
-                                                continue;
+                                    // Loop for m_{N+1}, a_{N+1}
+                                    for (const auto &iter_list : interaction_list) {
+                                        jat = iter_list;
 
-                                            atom_tmp.clear();
+                                        interaction_atom_omp[order + 1] = jat;
+                                        if (!cluster->is_incutoff(order + 2,
+                                                                  interaction_atom_omp,
+                                                                  order,
+                                                                  system->get_supercell().kind))
+                                            continue;
 
-                                            for (j = 1; j < order + 2; ++j) {
-                                                atom_tmp.push_back(interaction_atom[j]);
-                                            }
-                                            std::sort(atom_tmp.begin(), atom_tmp.end());
+                                        atom_tmp.clear();
+
+                                        for (j = 1; j < order + 2; ++j) {
+                                            atom_tmp.push_back(interaction_atom_omp[j]);
+                                        }
+                                        std::sort(atom_tmp.begin(), atom_tmp.end());
 
-                                            iter_cluster = cluster->get_interaction_cluster(order, i).find(
-                                                InteractionCluster(atom_tmp,
-                                                                   cell_dummy));
-                                            if (iter_cluster != cluster->get_interaction_cluster(order, i).end()) {
+                                        for (j = 0; j < 3; ++j) vec_for_rot[j] = 0.0;
 
-                                                int iloc = -1;
+                                        const auto &clusters_now = cluster->get_interaction_cluster(order, i);
+                                        icluster = clusters_now.find(atom_tmp);
+                                        if (icluster != InteractionClusterTable::npos) {
 
-                                                for (j = 0; j < atom_tmp.size(); ++j) {
-                                                    if (atom_tmp[j] == jat) {
-                                                        iloc = j;
-                                                        break;
-                                                    }
-                                                }
+                                            int iloc = -1;
 
-                                                if (iloc == -1) {
-                                                    exit("generate_rotational_constraint", "This cannot happen.");
+                                            for (j = 0; j < atom_tmp.size(); ++j) {
+                                                if (atom_tmp[j] == jat) {
+                                                    iloc = j;
+                                                    break;
                                                 }
+                                            }
 
-                                                for (j = 0; j < 3; ++j) vec_for_rot[j] = 0.0;
+                                            // exit() must not be called inside the parallel region.
+                                            if (iloc == -1) {
+                                                cluster_not_found = true;
+                                                continue;
+                                            }
 
-                                                const auto nsize_equiv = (*iter_cluster).cell.size();
+                                            const auto nsize_equiv = clusters_now.get_number_of_images(icluster);
 
-                                                for (j = 0; j < nsize_equiv; ++j) {
-                                                    for (auto k = 0; k < 3; ++k) {
-                                                        vec_for_rot[k] += system->get_x_image()[(*iter_cluster).cell[j][
-                                                            iloc]][jat][k];
-                                                    }
+                                            for (j = 0; j < nsize_equiv; ++j) {
+                                                for (auto k = 0; k < 3; ++k) {
+                                                    vec_for_rot[k]
+                                                        += system->get_x_image()[clusters_now.get_cells(icluster,
+                                                                                                        j)[iloc]][jat][k];
                                                 }
+                                            }
 
-                                                for (j = 0; j < 3; ++j) {
-                                                    vec_for_rot[j] /= static_cast<double>(nsize_equiv);
-                                                }
+                                            for (j = 0; j < 3; ++j) {
+                                                vec_for_rot[j] /= static_cast<double>(nsize_equiv);
                                             }
+                                        }
 
 
-                                            // mu, nu
+                                        // mu, nu
 
-                                            interaction_index[order + 1] = 3 * jat + mu;
-                                            for (j = 0; j < order + 2; ++j) interaction_tmp[j] = interaction_index[j];
+                                        interaction_index_omp[order + 1] = 3 * jat + mu;
+                                        for (j = 0; j < order + 2; ++j)
+                                            interaction_tmp_omp[j] = interaction_index_omp[j];
 
-                                            sort_tail(order + 2, interaction_tmp);
+                                        sort_tail(order + 2, interaction_tmp_omp);
 
-                                            iter_found = list_found.
-                                                find(FcProperty(order + 2, 1.0, interaction_tmp, 1));
-                                            if (iter_found != list_found.end()) {
-                                                arr_constraint[nparams[order - 1] + (*iter_found).mother]
-                                                    += (*iter_found).sign * vec_for_rot[nu];
-                                            }
+                                        iter_found = list_found.find(interaction_tmp_omp);
+                                        if (iter_found != FcPropertyIndex::npos) {
+                                            arr_constraint[nparams[order - 1] + list_found.get_mother(iter_found)]
+                                                += list_found.get_sign(iter_found) * vec_for_rot[nu];
+                                        }
 
-                                            // Exchange mu <--> nu and repeat again.
+                                        // Exchange mu <--> nu and repeat again.
 
-                                            interaction_index[order + 1] = 3 * jat + nu;
-                                            for (j = 0; j < order + 2; ++j) interaction_tmp[j] = interaction_index[j];
+                                        interaction_index_omp[order + 1] = 3 * jat + nu;
+                                        for (j = 0; j < order + 2; ++j)
+                                            interaction_tmp_omp[j] = interaction_index_omp[j];
 
-                                            sort_tail(order + 2, interaction_tmp);
+                                        sort_tail(order + 2, interaction_tmp_omp);
 
-                                            iter_found = list_found.
-                                                find(FcProperty(order + 2, 1.0, interaction_tmp, 1));
-                                            if (iter_found != list_found.end()) {
-                                                arr_constraint[nparams[order - 1] + (*iter_found).mother]
-                                                    -= (*iter_found).sign * vec_for_rot[mu];
-                                            }
+                                        iter_found = list_found.find(interaction_tmp_omp);
+                                        if (iter_found != FcPropertyIndex::npos) {
+                                            arr_constraint[nparams[order - 1] + list_found.get_mother(iter_found)]
+                                                -= list_found.get_sign(iter_found) * vec_for_rot[mu];
                                         }
+                                    }
 
-                                        for (lambda = 0; lambda < order + 1; ++lambda) {
+                                    for (lambda = 0; lambda < order + 1; ++lambda) {
 
-                                            mu_lambda = interaction_index[lambda] % 3;
+                                        mu_lambda = interaction_index_omp[lambda] % 3;
 
-                                            for (jcrd = 0; jcrd < 3; ++jcrd) {
+                                        for (jcrd = 0; jcrd < 3; ++jcrd) {
 
-                                                for (j = 0; j < order + 1; ++j)
-                                                    interaction_tmp[j] = interaction_index[j
-                                                    ];
+                                            for (j = 0; j < order + 1; ++j)
+                                                interaction_tmp_omp[j] = interaction_index_omp[j];
 
-                                                interaction_tmp[lambda] = 3 * interaction_atom[lambda] + jcrd;
+                                            interaction_tmp_omp[lambda]
+                                                = 3 * interaction_atom_omp[lambda] + jcrd;
 
-                                                levi_factor = 0;
+                                            levi_factor = 0;
 
-                                                for (j = 0; j < 3; ++j) {
-                                                    levi_factor += levi_civita(j, mu, nu) * levi_civita(
-                                                        j, mu_lambda, jcrd);
-                                                }
+                                            for (j = 0; j < 3; ++j) {
+                                                levi_factor += levi_civita(j, mu, nu)
+                                                    * levi_civita(j, mu_lambda, jcrd);
+                                            }
 
-                                                if (levi_factor == 0) continue;
+                                            if (levi_factor == 0) continue;
 
-                                                sort_tail(order + 1, interaction_tmp);
+                                            sort_tail(order + 1, interaction_tmp_omp);
 
-                                                iter_found = list_found_last.find(FcProperty(order + 1, 1.0,
-                                                                                             interaction_tmp, 1));
-                                                if (iter_found != list_found_last.end()) {
-                                                    arr_constraint[(*iter_found).mother]
-                                                        += (*iter_found).sign * static_cast<double>(levi_factor);
-                                                }
+                                            iter_found = list_found_last.find(interaction_tmp_omp);
+                                            if (iter_found != FcPropertyIndex::npos) {
+                                                arr_constraint[list_found_last.get_mother(iter_found)]
+                                                    += list_found_last.get_sign(iter_found) * static_cast<double>(levi_factor);
                                             }
                                         }
+                                    }
 
-                                        if (!is_allzero(arr_constraint, tolerance, loc_nonzero)) {
+                                    if (!is_allzero(arr_constraint, tolerance, loc_nonzero)) {
 
-                                            // A Candidate for another constraint found !
-                                            // Add to the appropriate set
+                                        // A Candidate for another constraint found !
+                                        // Add to the appropriate set
 
-                                            if (arr_constraint[loc_nonzero] < 0.0) {
-                                                for (j = 0; j < nparam_sub; ++j) arr_constraint[j] *= -1.0;
-                                            }
-                                            for (j = 0; j < nparams[order]; ++j) {
-                                                arr_constraint_self[j] = arr_constraint[j + nparams[order - 1]];
-                                            }
-                                            for (j = 0; j < nparams[order - 1]; ++j) {
-                                                arr_constraint_lower[j] = arr_constraint[j];
-                                            }
+                                        if (arr_constraint[loc_nonzero] < 0.0) {
+                                            for (j = 0; j < nparam_sub; ++j) arr_constraint[j] *= -1.0;
+                                        }
+                                        for (j = 0; j < nparams[order]; ++j) {
+                                            arr_constraint_self[j] = arr_constraint[j + nparams[order - 1]];
+                                        }
+                                        for (j = 0; j < nparams[order - 1]; ++j) {
+                                            arr_constraint_lower[j] = arr_constraint[j];
+                                        }
 
-                                            const_tmp.clear();
+                                        const_tmp.clear();
 
-                                            if (is_allzero(arr_constraint_self, tolerance, loc_nonzero)) {
-                                                // If all elements of the "order"th order is zero,
-                                                // the constraint is intraorder of the "order-1"th order.
-                                                for (j = 0; j < nparams[order - 1]; ++j) {
-                                                    if (std::abs(arr_constraint_lower[j]) >= tolerance) {
-                                                        const_tmp.emplace_back(j, arr_constraint_lower[j]);
-                                                    }
+                                        if (is_allzero(arr_constraint_self, tolerance, loc_nonzero)) {
+                                            // If all elements of the "order"th order is zero,
+                                            // the constraint is intraorder of the "order-1"th order.
+                                            for (j = 0; j < nparams[order - 1]; ++j) {
+                                                if (std::abs(arr_constraint_lower[j]) >= tolerance) {
+                                                    const_tmp.emplace_back(j, arr_constraint_lower[j]);
                                                 }
-                                                const_self_vec[order - 1].emplace_back(const_tmp);
-
-                                            } else if (is_allzero(arr_constraint_lower, tolerance, loc_nonzero)) {
-                                                // If all elements of the "order-1"th order is zero,
-                                                // the constraint is intraorder of the "order"th order.
-                                                for (j = 0; j < nparams[order]; ++j) {
-                                                    if (std::abs(arr_constraint_self[j]) >= tolerance) {
-                                                        const_tmp.emplace_back(j, arr_constraint_self[j]);
-                                                    }
+                                            }
+                                            const_lower_omp.emplace_back(const_tmp);
+
+                                        } else if (is_allzero(arr_constraint_lower, tolerance, loc_nonzero)) {
+                                            // If all elements of the "order-1"th order is zero,
+                                            // the constraint is intraorder of the "order"th order.
+                                            for (j = 0; j < nparams[order]; ++j) {
+                                                if (std::abs(arr_constraint_self[j]) >= tolerance) {
+                                                    const_tmp.emplace_back(j, arr_constraint_self[j]);
                                                 }
-                                                const_self_vec[order].emplace_back(const_tmp);
+                                            }
+                                            const_self_omp.emplace_back(const_tmp);
 
-                                            } else {
-                                                // If nonzero elements exist in both of the "order-1" and "order",
-                                                // the constraint is intrerorder.
+                                        } else {
+                                            // If nonzero elements exist in both of the "order-1" and "order",
+                                            // the constraint is intrerorder.
 
-                                                for (j = 0; j < nparam_sub; ++j) {
-                                                    if (std::abs(arr_constraint[j]) >= tolerance) {
-                                                        const_tmp.emplace_back(j, arr_constraint[j]);
-                                                    }
+                                            for (j = 0; j < nparam_sub; ++j) {
+                                                if (std::abs(arr_constraint[j]) >= tolerance) {
+                                                    const_tmp.emplace_back(j, arr_constraint[j]);
                                                 }
-                                                const_cross_vec[order].emplace_back(const_tmp);
                                             }
+                                            const_cross_omp.emplace_back(const_tmp);
                                         }
+                                    }
 
-                                    } // nu
-                                }     // mu
+                                } // nu
+                            }     // mu
+
+                        } // ixyz
 
-                            } // ixyz
+                    } // close item (openmp main loop)
 
-                        } while (g.next());
+                    deallocate(interaction_tmp_omp);
+                    deallocate(interaction_index_omp);
+                    deallocate(interaction_atom_omp);
+
+                    const_lower_thread[ithread] = std::move(const_lower_omp);
+                    const_self_thread[ithread] = std::move(const_self_omp);
+                    const_cross_thread[ithread] = std::move(const_cross_omp);
+                } // close openmp
+
+                if (cluster_not_found) {
+                    exit("generate_rotational_constraint", "This cannot happen.");
+                }
 
-                    } // direction
-                }     // icrd
+                for (auto ith = 0; ith < nthreads; ++ith) {
+                    std::move(const_lower_thread[ith].begin(), const_lower_thread[ith].end(),
+                              std::back_inserter(const_self_vec[order - 1]));
+                    std::move(const_self_thread[ith].begin(), const_self_thread[ith].end(),
+                              std::back_inserter(const_self_vec[order]));
+                    std::move(const_cross_thread[ith].begin(), const_cross_thread[ith].end(),
+                              std::back_inserter(const_cross_vec[order]));
+                }
             }
 
             // Additional constraint for the last order.
@@ -1620,23 +1793,56 @@ void Constraint::generate_rotational_constraint(const System *system,
                 allocate(xyzcomponent2, nxyz2, order + 1);
                 fcs->get_xyzcomponent(order + 1, xyzcomponent2);
 
-                for (icrd = 0; icrd < 3; ++icrd) {
+                data_vec.clear();
+                CombinationWithRepetition<int> g_now(interaction_list_now.begin(),
+                                                     interaction_list_now.end(), order + 1);
+                do {
+                    data_vec.push_back(g_now.now());
+                } while (g_now.next());
+                const auto ndata = data_vec.size();
+                const auto nitems = static_cast<int>(3 * ndata);
+
+                std::vector<std::vector<ConstEntry>> const_self_thread(nthreads);
+
+#ifdef _OPENMP
+#pragma omp parallel private(j, icrd, mu, nu, ixyz, lambda, jcrd, mu_lambda, levi_factor, loc_nonzero, arr_constraint_self, iter_found, const_tmp)
+#endif
+                {
+                    int *interaction_atom_omp, *interaction_index_omp, *interaction_tmp_omp;
+                    std::vector<ConstEntry> const_self_omp;
 
-                    interaction_index[0] = 3 * interaction_atom[0] + icrd;
+                    arr_constraint_self.resize(nparams[order]);
 
-                    CombinationWithRepetition<int> g_now(interaction_list_now.begin(),
-                                                         interaction_list_now.end(), order + 1);
-                    do {
+                    allocate(interaction_atom_omp, order + 2);
+                    allocate(interaction_index_omp, order + 2);
+                    allocate(interaction_tmp_omp, order + 2);
 
-                        auto data = g_now.now();
+                    interaction_atom_omp[0] = iat;
 
-                        for (auto idata = 0; idata < data.size(); ++idata)
-                            interaction_atom[idata + 1] = data[idata];
+#ifdef _OPENMP
+                    const auto ithread = omp_get_thread_num();
+#else
+                    const auto ithread = 0;
+#endif
+
+#ifdef _OPENMP
+#pragma omp for schedule(static)
+#endif
+                    for (int item = 0; item < nitems; ++item) {
+
+                        icrd = static_cast<int>(item / ndata);
+                        const auto idata = item % ndata;
+
+                        interaction_index_omp[0] = 3 * iat + icrd;
+
+                        for (j = 0; j < order + 1; ++j)
+                            interaction_atom_omp[j + 1] = data_vec[idata][j];
 
                         for (ixyz = 0; ixyz < nxyz2; ++ixyz) {
 
                             for (j = 0; j < order + 1; ++j)
-                                interaction_index[j + 1] = 3 * interaction_atom[j + 1] + xyzcomponent2[ixyz][j];
+                                interaction_index_omp[j + 1]
+                                    = 3 * interaction_atom_omp[j + 1] + xyzcomponent2[ixyz][j];
 
                             for (mu = 0; mu < 3; ++mu) {
 
@@ -1644,40 +1850,43 @@ void Constraint::generate_rotational_constraint(const System *system,
 
                                     if (!valid_rotation_axis[mu][nu]) continue;
 
-                                    for (j = 0; j < nparams[order]; ++j) arr_constraint_self[j] = 0.0;
+                                    for (j = 0; j < nparams[order]; ++j)
+                                        arr_constraint_self[j] = 0.0;
 
                                     for (lambda = 0; lambda < order + 2; ++lambda) {
 
-                                        mu_lambda = interaction_index[lambda] % 3;
+                                        mu_lambda = interaction_index_omp[lambda] % 3;
 
                                         for (jcrd = 0; jcrd < 3; ++jcrd) {
 
                                             for (j = 0; j < order + 2; ++j)
-                                                interaction_tmp[j] = interaction_index[j];
+                                                interaction_tmp_omp[j] = interaction_index_omp[j];
 
-                                            interaction_tmp[lambda] = 3 * interaction_atom[lambda] + jcrd;
+                                            interaction_tmp_omp[lambda]
+                                                = 3 * interaction_atom_omp[lambda] + jcrd;
 
                                             levi_factor = 0;
                                             for (j = 0; j < 3; ++j) {
-                                                levi_factor += levi_civita(j, mu, nu) * levi_civita(j, mu_lambda, jcrd);
+                                                levi_factor += levi_civita(j, mu, nu)
+                                                    * levi_civita(j, mu_lambda, jcrd);
                                             }
 
                                             if (levi_factor == 0) continue;
 
-                                            sort_tail(order + 2, interaction_tmp);
+                                            sort_tail(order + 2, interaction_tmp_omp);
 
-                                            iter_found = list_found.find(FcProperty(order + 2, 1.0,
-                                                                                    interaction_tmp, 1));
-                                            if (iter_found != list_found.end()) {
-                                                arr_constraint_self[(*iter_found).mother]
-                                                    += (*iter_found).sign * static_cast<double>(levi_factor);
+                                            iter_found = list_found.find(interaction_tmp_omp);
+                                            if (iter_found != FcPropertyIndex::npos) {
+                                                arr_constraint_self[list_found.get_mother(iter_found)]
+                                                    += list_found.get_sign(iter_found) * static_cast<double>(levi_factor);
                                             }
                                         } // jcrd
                                     }     // lambda
 
                                     if (!is_allzero(arr_constraint_self, tolerance, loc_nonzero)) {
                                         if (arr_constraint_self[loc_nonzero] < 0.0) {
-                                            for (j = 0; j < nparams[order]; ++j) arr_constraint_self[j] *= -1.0;
+                                            for (j = 0; j < nparams[order]; ++j)
+                                                arr_constraint_self[j] *= -1.0;
                                         }
                                         const_tmp.clear();
                                         for (j = 0; j < nparams[order]; ++j) {
@@ -1685,7 +1894,7 @@ void Constraint::generate_rotational_constraint(const System *system,
                                                 const_tmp.emplace_back(j, arr_constraint_self[j]);
                                             }
                                         }
-                                        const_self_vec[order].emplace_back(const_tmp);
+                                        const_self_omp.emplace_back(const_tmp);
                                     }
 
                                 } // nu
@@ -1693,10 +1902,19 @@ void Constraint::generate_rotational_constraint(const System *system,
 
                         } // ixyz
 
+                    } // close item (openmp main loop)
 
-                    } while (g_now.next());
+                    deallocate(interaction_tmp_omp);
+                    deallocate(interaction_index_omp);
+                    deallocate(interaction_atom_omp);
 
-                } // icrd
+                    const_self_thread[ithread] = std::move(const_self_omp);
+                } // close openmp
+
+                for (auto ith = 0; ith < nthreads; ++ith) {
+                    std::move(const_self_thread[ith].begin(), const_self_thread[ith].end(),
+                              std::back_inserter(const_self_vec[order]));
+                }
 
                 deallocate(xyzcomponent2);
             }
@@ -1707,7 +1925,6 @@ void Constraint::generate_rotational_constraint(const System *system,
         if (order > 0) {
             deallocate(xyzcomponent);
         }
-        deallocate(interaction_tmp);
         deallocate(interaction_index);
         deallocate(interaction_atom);
     } // order
@@ -1771,7 +1988,6 @@ void Constraint::generate_rotational_constraint(const System *system,
 
     if (verbosity > 0) std::cout << "  Finished !" << std::endl << std::endl;
 
-    deallocate(ind);
     deallocate(nparams);
     deallocate(const_self_vec);
     deallocate(const_cross_vec);
@@ -1838,132 +2054,72 @@ void Constraint::fix_forceconstants_to_file(const int order,
                                             const std::string file_to_fix,
                                             std::vector<ConstraintTypeFix> &const_out) const
 {
-    using namespace boost::property_tree;
-    ptree pt;
+    // The XML file is read by a streaming parser, and only the unique
+    // force constants of the given order are kept.
+    // When use_fc_file_binary is true, the binary sidecar (file_to_fix + ".fc2.bin"
+    // or ".fc3.bin") is used instead if it is up to date, and is created otherwise.
 
-    try {
-        read_xml(file_to_fix, pt);
-    }
-    catch (std::exception &e) {
-        if (order == 0) {
-            auto str_error = "Cannot open file FC2XML ( " + file_to_fix + " )";
-        } else if (order == 1) {
-            auto str_error = "Cannot open file FC3XML ( " + file_to_fix + " )";
+    UniqueFcData fc_ref;
+
+    if (!use_fc_file_binary || !read_unique_fcs_binary(file_to_fix, order, fc_ref)) {
+
+        if (!read_unique_fcs_xml(file_to_fix, order, fc_ref)) {
+            exit("fix_forceconstants_to_file", "Failed to open ", file_to_fix.c_str());
         }
-        exit("fix_forceconstants_to_file", "Failed to open ", file_to_fix.c_str());
+        if (!fc_ref.missing_entries.empty()) {
+            exit("fix_forceconstants_to_file",
+                 "The following entry could not be found in the XML file : ",
+                 fc_ref.missing_entries[0].c_str());
+        }
+        if (use_fc_file_binary) write_unique_fcs_binary(file_to_fix, order, fc_ref);
     }
 
-    const auto nat_ref = boost::lexical_cast<size_t>(
-        get_value_from_xml(pt, "Data.Structure.NumberOfAtoms"));
-    const auto ntran_ref = boost::lexical_cast<size_t>(
-        get_value_from_xml(pt, "Data.Symmetry.NumberOfTranslations"));
-    const auto natmin_ref = nat_ref / ntran_ref;
-
-    if (natmin_ref != symmetry->get_nat_prim()) {
+    if (fc_ref.ntran == 0 || fc_ref.nat / fc_ref.ntran != symmetry->get_nat_prim()) {
         exit("fix_forceconstants_to_file",
              "The number of atoms in the primitive cell is not consistent.");
     }
 
     const auto nfcs = fcs->get_nequiv()[order].size();
+    const auto nterms = order + 2;
 
-    if (order == 0) {
-        const auto nfcs_ref = boost::lexical_cast<size_t>(
-            get_value_from_xml(pt, "Data.ForceConstants.HarmonicUnique.NFC2"));
-
-        if (nfcs_ref != nfcs) {
-            exit("fix_forceconstants_to_file",
-                 "The number of harmonic force constants is not consistent.");
-        }
-
-        std::string preferred_basis_ref = boost::lexical_cast<std::string>(
-            get_value_from_xml(pt, "Data.ForceConstants.HarmonicUnique.Basis", 0));
-
-        if (preferred_basis_ref == "") preferred_basis_ref = "Cartesian";
-
-        if (preferred_basis_ref != fcs->get_forceconstant_basis()) {
-            exit("fix_forceconstants_to_file",
-                 "The basis of harmonic force constants is not consistent.");
-        }
-    } else if (order == 1) {
-        const auto nfcs_ref = boost::lexical_cast<size_t>(
-            get_value_from_xml(pt, "Data.ForceConstants.CubicUnique.NFC3"));
-
-        if (nfcs_ref != nfcs) {
-            exit("fix_forceconstants_to_file",
-                 "The number of cubic force constants is not consistent.");
-        }
-
-        std::string preferred_basis_ref = boost::lexical_cast<std::string>(
-            get_value_from_xml(pt, "Data.ForceConstants.CubicUnique.Basis", 0));
-        if (preferred_basis_ref == "") preferred_basis_ref = "Cartesian";
-
-        if (preferred_basis_ref != fcs->get_forceconstant_basis()) {
-            exit("fix_forceconstants_to_file",
-                 "The basis of cubic force constants is not consistent.");
-        }
+    if (fc_ref.nfcs != nfcs
+        || fc_ref.values.size() != nfcs
+        || fc_ref.elems.size() != nfcs * nterms) {
+        exit("fix_forceconstants_to_file",
+             order == 0 ? "The number of harmonic force constants is not consistent."
+                        : "The number of cubic force constants is not consistent.");
     }
 
-    int **intpair_ref;
-    double *fcs_ref;
+    const auto preferred_basis_ref = fc_ref.basis.empty() ? "Cartesian" : fc_ref.basis;
 
-    allocate(fcs_ref, nfcs);
-    allocate(intpair_ref, nfcs, 3);
-
-    int counter = 0;
-
-    if (order == 0) {
-        BOOST_FOREACH(const ptree::value_type & child_, pt.get_child("Data.ForceConstants.HarmonicUnique")) {
-            if (child_.first == "FC2") {
-                const auto &child = child_.second;
-                const auto str_intpair = child.get<std::string>("<xmlattr>.pairs");
-                const auto str_multiplicity = child.get<std::string>("<xmlattr>.multiplicity");
+    if (preferred_basis_ref != fcs->get_forceconstant_basis()) {
+        exit("fix_forceconstants_to_file",
+             order == 0 ? "The basis of harmonic force constants is not consistent."
+                        : "The basis of cubic force constants is not consistent.");
+    }
 
-                std::istringstream is(str_intpair);
-                is >> intpair_ref[counter][0] >> intpair_ref[counter][1];
-                fcs_ref[counter] = boost::lexical_cast<double>(child.data());
-                ++counter;
-            }
-        }
-    } else if (order == 1) {
-        BOOST_FOREACH(const ptree::value_type & child_, pt.get_child("Data.ForceConstants.CubicUnique")) {
-            if (child_.first == "FC3") {
-                const auto &child = child_.second;
-                const auto str_intpair = child.get<std::string>("<xmlattr>.pairs");
-                const auto str_multiplicity = child.get<std::string>("<xmlattr>.multiplicity");
-
-                std::istringstream is(str_intpair);
-                is >> intpair_ref[counter][0] >> intpair_ref[counter][1] >> intpair_ref[counter][2];
-                fcs_ref[counter] = boost::lexical_cast<double>(child.data());
-                ++counter;
-            }
+    // The flattened indices must refer to an atom of the supercell.
+    // Otherwise they could match a wrong force constant after packing.
+    for (const auto &it : fc_ref.elems) {
+        if (it < 0 || static_cast<size_t>(it) >= 3 * fc_ref.nat
+            || !FcPropertyKey::is_packable(it)) {
+            exit("fix_forceconstants_to_file",
+                 "Invalid index of force constant in the XML file: ", it);
         }
     }
 
-    const auto nterms = order + 2;
-
-    std::unordered_set<FcProperty> list_found;
-    std::unordered_set<FcProperty>::iterator iter_found;
-
-    list_found.clear();
+    const FcPropertyIndex list_found(nterms, fcs->get_fc_property_table()[order]);
+    size_t iter_found;
 
-    for (auto &list_tmp : fcs->get_fc_table()[order]) {
-        list_found.insert(FcProperty(list_tmp));
-    }
-
-    for (auto i = 0; i < nfcs; ++i) {
-        iter_found = list_found.find(FcProperty(nterms, 1.0,
-                                                intpair_ref[i], 1));
-        if (iter_found == list_found.end()) {
+    for (size_t i = 0; i < nfcs; ++i) {
+        iter_found = list_found.find(&fc_ref.elems[i * nterms]);
+        if (iter_found == FcPropertyIndex::npos) {
             exit("fix_forceconstants_to_file",
                  "Cannot find equivalent force constant, number: ",
                  i + 1);
         }
-        const_out.emplace_back(ConstraintTypeFix((*iter_found).mother, fcs_ref[i]));
+        const_out.emplace_back(ConstraintTypeFix(list_found.get_mother(iter_found), fc_ref.values[i]));
     }
-    deallocate(intpair_ref);
-    deallocate(fcs_ref);
-
-    list_found.clear();
 }
 
 
@@ -17,6 +17,7 @@
 #include <string>
 #include <iomanip>
 #include <map>
+#include <mutex>
 #include "constants.h"
 #include "fcs.h"
 #include "cluster.h"
@@ -25,6 +26,8 @@
 
 namespace ALM_NS
 {
+    class SetupCache;
+
     class ConstraintClass
     {
     public:
@@ -76,6 +79,60 @@ namespace ALM_NS
             p_index_target(index_in), alpha(std::move(alpha_in)), p_index_orig(std::move(p_index_in)) { }
     };
 
+    class ConstraintIndexMap
+    {
+        // Two-way mapping between the indices of free parameters and
+        // those of the irreducible parameters before applying constraints.
+        // Both sides are dense ranges, so flat arrays are used.
+    public:
+        static const size_t none = static_cast<size_t>(-1);
+
+        ConstraintIndexMap() = default;
+
+        void init(const size_t nparams)
+        {
+            free_to_orig.clear();
+            orig_to_free.assign(nparams, static_cast<size_t>(none));
+        }
+
+        // Register iorig as the next free parameter.
+        void push_back(const size_t iorig)
+        {
+            orig_to_free[iorig] = free_to_orig.size();
+            free_to_orig.push_back(iorig);
+        }
+
+        size_t size() const
+        {
+            return free_to_orig.size();
+        }
+
+        bool empty() const
+        {
+            return free_to_orig.empty();
+        }
+
+        size_t get_nparams() const
+        {
+            return orig_to_free.size();
+        }
+
+        size_t get_orig(const size_t ifree) const
+        {
+            return free_to_orig[ifree];
+        }
+
+        // Returns none if iorig is not a free parameter.
+        size_t get_free(const size_t iorig) const
+        {
+            return orig_to_free[iorig];
+        }
+
+    private:
+        std::vector<size_t> free_to_orig; // [nfree]
+        std::vector<size_t> orig_to_free; // [nparams]
+    };
+
     inline bool equal_within_eps12(const std::vector<double> &a,
                                    const std::vector<double> &b)
     {
@@ -98,6 +155,10 @@ namespace ALM_NS
         ConstraintIntegerElement(const size_t col_in,
                                  const int val_in) :
             col(col_in), val(val_in) {}
+
+        bool operator<(const ConstraintIntegerElement &obj) const {
+            return col < obj.col;
+        }
     };
 
     // Operator for sort
@@ -122,7 +183,7 @@ namespace ALM_NS
                 return false;
             }
         }
-        return false;
+        return len1 < len2;
     }
 
     // Operator for unique
@@ -179,7 +240,7 @@ namespace ALM_NS
                 return false;
             }
         }
-        return false;
+        return len1 < len2;
     }
 
     // Operator for unique
@@ -216,14 +277,15 @@ namespace ALM_NS
                    const Symmetry *symmetry,
                    const int linear_model,
                    const int verbosity,
-                   Timer *timer);
+                   Timer *timer,
+                   const SetupCache *setup_cache = nullptr);
 
         void get_mapping_constraint(const int nmax,
                                     const std::vector<size_t> *nequiv,
                                     const ConstraintSparseForm *const_in,
                                     std::vector<ConstraintTypeFix> *const_fix_out,
                                     std::vector<ConstraintTypeRelate> *const_relate_out,
-                                    boost::bimap<size_t, size_t> *index_bimap_out) const;
+                                    ConstraintIndexMap *index_map_out) const;
 
         int get_constraint_mode() const;
         void set_constraint_mode(const int);
@@ -235,6 +297,8 @@ namespace ALM_NS
         void set_fix_harmonic(const bool);
         bool get_fix_cubic() const;
         void set_fix_cubic(const bool);
+        bool get_fc_file_binary() const;
+        void set_fc_file_binary(const bool);
         int get_constraint_algebraic() const;
 
         double** get_const_mat() const;
@@ -249,12 +313,13 @@ namespace ALM_NS
         std::string get_rotation_axis() const;
         void set_rotation_axis(const std::string);
 
-        const ConstraintSparseForm& get_const_symmetry(const int) const;
         const std::vector<ConstraintTypeFix>& get_const_fix(const int) const;
         void set_const_fix_val_to_fix(const int order,
                                       const size_t idx,
                                       const double val);
         const std::vector<ConstraintTypeRelate>& get_const_relate(const int) const;
+        const ConstraintIndexMap& get_index_map(const int) const;
+        // Same as get_index_map. Kept for compatibility.
         const boost::bimap<size_t, size_t>& get_index_bimap(const int) const;
 
     private:
@@ -263,6 +328,7 @@ namespace ALM_NS
         size_t number_of_constraints;
         std::string fc2_file, fc3_file;
         bool fix_harmonic, fix_cubic;
+        bool use_fc_file_binary; // read/write the binary sidecar of FC2XML/FC3XML
         int constraint_algebraic;
 
         double **const_mat;
@@ -278,7 +344,9 @@ namespace ALM_NS
         std::vector<ConstraintTypeFix> *const_fix;
         std::vector<ConstraintTypeRelate> *const_relate;
         std::vector<ConstraintTypeRelate> *const_relate_rotation;
-        boost::bimap<size_t, size_t> *index_bimap;
+        ConstraintIndexMap *index_map;
+        boost::bimap<size_t, size_t> *index_bimap; // copy of index_map, made on first request
+        std::once_flag *index_bimap_once; // guards the construction of index_bimap of each order
 
         bool impose_inv_T, impose_inv_R, exclude_last_R;
 
@@ -306,6 +374,15 @@ namespace ALM_NS
                                       const std::vector<size_t> *nequiv,
                                       const size_t nparams) const;
 
+        // index_bimap of the given order is made from index_map.
+        void make_index_bimap(const int order) const;
+
+        // const_fix, const_relate, index_map, const_mat, and const_rhs are updated.
+        bool load_constraint_from_cache(const SetupCache *setup_cache,
+                                        const uint64_t key_cache,
+                                        const int maxorder,
+                                        const Fcs *fcs);
+
         void print_constraint(const ConstraintSparseForm &) const;
 
         void setup_rotation_axis(bool [3][3]);
@@ -336,7 +413,7 @@ namespace ALM_NS
                                         const Cluster *cluster,
                                         const Fcs *fcs,
                                         const int order,
-                                        const std::vector<FcProperty> &fc_table,
+                                        const FcPropertyTable &fc_table,
                                         const size_t nparams,
                                         ConstraintSparseForm &const_out,
                                         const bool do_rref = false) const;
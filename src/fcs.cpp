@@ -16,6 +16,7 @@
 #include "mathfunctions.h"
 #include "memory.h"
 #include "rref.h"
+#include "setup_cache.h"
 #include "symmetry.h"
 #include "timer.h"
 #include <iostream>
@@ -24,10 +25,14 @@
 #include <cstddef>
 #include <string>
 #include <cmath>
+#include <atomic>
 #include "../external/combination.hpp"
-#include <unordered_set>
 #include <boost/algorithm/string/case_conv.hpp>
 
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
 #if defined(_WIN32) || defined(_WIN64)
 #undef min
 #undef max
@@ -49,7 +54,8 @@ void Fcs::init(const Cluster *cluster,
                const Symmetry *symmetry,
                const Cell &supercell,
                const int verbosity,
-               Timer *timer)
+               Timer *timer,
+               const SetupCache *setup_cache)
 {
     int i;
     const auto maxorder = cluster->get_maxorder();
@@ -72,6 +78,10 @@ void Fcs::init(const Cluster *cluster,
         deallocate(fc_table);
     }
     allocate(fc_table, maxorder);
+    maxorder_table = maxorder;
+    clear_fc_table_vector();
+
+    clear_forceconstant_cartesian();
 
     if (nequiv) {
         deallocate(nequiv);
@@ -83,17 +93,41 @@ void Fcs::init(const Cluster *cluster,
     }
     allocate(fc_zeros, maxorder);
 
-    // Generate force constants using the information of interacting atom pairs
-    for (i = 0; i < maxorder; ++i) {
-        generate_force_constant_table(i,
-                                      supercell.number_of_atoms,
-                                      cluster->get_cluster_list(i),
-                                      symmetry,
-                                      preferred_basis,
-                                      fc_table[i],
-                                      nequiv[i],
-                                      fc_zeros[i],
-                                      store_zeros);
+    if (cluster_orbit) {
+        deallocate(cluster_orbit);
+    }
+    allocate(cluster_orbit, maxorder);
+
+    if (cluster_orbit_constraint) {
+        deallocate(cluster_orbit_constraint);
+    }
+    allocate(cluster_orbit_constraint, maxorder);
+
+    make_cluster_orbit_table(maxorder, cluster, symmetry, preferred_basis,
+                             cluster_orbit, cluster_orbit_constraint);
+
+    if (setup_cache && setup_cache->load_fcs(maxorder, supercell.number_of_atoms, fc_table, nequiv)) {
+        // fc_zeros is not stored in the cache.
+        if (verbosity > 0) {
+            std::cout << std::endl;
+            std::cout << "  Force constant table is loaded from the setup cache ("
+                << setup_cache->get_filename() << ")." << std::endl;
+        }
+    } else {
+        // Generate force constants using the information of interacting atom pairs
+        for (i = 0; i < maxorder; ++i) {
+            generate_force_constant_table(i,
+                                          supercell.number_of_atoms,
+                                          cluster->get_cluster_list(i),
+                                          cluster_orbit[i],
+                                          symmetry,
+                                          preferred_basis,
+                                          fc_table[i],
+                                          nequiv[i],
+                                          fc_zeros[i],
+                                          store_zeros);
+        }
+        if (setup_cache) setup_cache->save_fcs(maxorder, fc_table, nequiv);
     }
 
     set_basis_conversion_matrix(supercell);
@@ -122,7 +156,16 @@ void Fcs::set_default_variables()
     nequiv = nullptr;
     fc_table = nullptr;
     fc_zeros = nullptr;
+    cluster_orbit = nullptr;
+    cluster_orbit_constraint = nullptr;
+    maxorder_table = 0;
+    fc_table_vec = nullptr;
+    fc_table_vec_once = nullptr;
     fc_cart = nullptr;
+    fc_cart_once = nullptr;
+    fc_cart_vec = nullptr;
+    fc_cart_vec_once = nullptr;
+    maxorder_cart = 0;
     store_zeros = true;
 
     // preferred_basis = "Cartesian";
@@ -140,79 +183,93 @@ void Fcs::deallocate_variables()
     if (fc_zeros) {
         deallocate(fc_zeros);
     }
-    if (fc_cart) {
-        deallocate(fc_cart);
+    if (cluster_orbit) {
+        deallocate(cluster_orbit);
+    }
+    if (cluster_orbit_constraint) {
+        deallocate(cluster_orbit_constraint);
     }
+    maxorder_table = 0;
+    clear_fc_table_vector();
+    clear_forceconstant_cartesian();
 }
 
+void Fcs::make_cluster_orbit_table(const int maxorder,
+                                   const Cluster *cluster,
+                                   const Symmetry *symmetry,
+                                   const std::string basis,
+                                   ClusterOrbitTable *orbit_out,
+                                   ClusterOrbitTable *orbit_constraint_out) const
+{
+    // The operations relevant to each cluster are found only once for all
+    // the seeds of generate_force_constant_table and for all the entries
+    // of the symmetry constraints.
+
+    const auto natmin = symmetry->get_nat_prim();
+    const auto &map_p2s = symmetry->get_map_p2s();
+    const auto &symmop = symmetry->get_symmetry_operations(basis, true);
+    const auto &symmop_constraint = symmetry->get_symmetry_operations(basis, false);
+
+    for (auto order = 0; order < maxorder; ++order) {
+        const auto &clusters = cluster->get_cluster_list(order);
+        orbit_out[order] = ClusterOrbitTable(clusters, order + 2, symmop,
+                                             natmin, map_p2s);
+        orbit_constraint_out[order] = ClusterOrbitTable(clusters, order + 2, symmop_constraint,
+                                                        natmin, map_p2s, false);
+    }
+}
 
 void Fcs::generate_force_constant_table(const int order,
                                         const size_t nat,
-                                        const std::set<IntList> &pairs,
+                                        const ClusterTable &pairs,
+                                        const ClusterOrbitTable &cluster_orbit,
                                         const Symmetry *symm_in,
                                         const std::string basis,
-                                        std::vector<FcProperty> &fc_vec,
+                                        FcPropertyTable &fc_vec,
                                         std::vector<size_t> &ndup,
-                                        std::vector<FcProperty> &fc_zeros_out,
+                                        FcPropertyTable &fc_zeros_out,
                                         const bool store_zeros_in) const
 {
-    size_t i, j;
-    int i1, i2;
+    size_t i;
+    int i1;
     int i_prim;
-    int *atmn, *atmn_mapped;
-    int *ind, *ind_mapped;
-    int *ind_tmp, *ind_mapped_tmp;
+    int *atmn, *ind;
     int nxyz;
-    unsigned int isym;
-
-    double c_tmp;
 
     int **xyzcomponent;
 
-    const auto nsym = symm_in->get_SymmData().size();
-    bool is_zero;
-    bool *is_searched;
-    int **map_sym;
-    double ***rotation;
+    const auto natmin = symm_in->get_nat_prim();
+    const auto &map_p2s = symm_in->get_map_p2s();
     const bool use_compatible = true;
 
     if (order < 0) return;
 
-    allocate(rotation, nsym, 3, 3);
-    allocate(map_sym, nat, nsym);
-    int nsym_in_use = 0;
-
-    get_available_symmop(nat,
-                         symm_in,
-                         basis,
-                         nsym_in_use,
-                         map_sym,
-                         rotation,
-                         use_compatible);
+    const auto &symmop = symm_in->get_symmetry_operations(basis, use_compatible);
 
     allocate(atmn, order + 2);
-    allocate(atmn_mapped, order + 2);
     allocate(ind, order + 2);
-    allocate(ind_mapped, order + 2);
-    allocate(ind_tmp, order);
-    allocate(ind_mapped_tmp, order + 2);
-    allocate(is_searched, 3 * nat);
 
-    fc_vec.clear();
+    fc_vec = FcPropertyTable(order + 2);
     ndup.clear();
-    fc_zeros_out.clear();
-    size_t nmother = 0;
+    fc_zeros_out = FcPropertyTable(order + 2);
 
     nxyz = static_cast<int>(std::pow(3.0, order + 2));
 
     allocate(xyzcomponent, nxyz, order + 2);
     get_xyzcomponent(order + 2, xyzcomponent);
 
-    std::unordered_set<IntList> list_found;
+    // Enumerate the candidate parameter sets (seeds) in the serial order.
+    // Each orbit of symmetrically-dependent parameters is owned by the first
+    // seed it contains, which is where the serial search would create it.
+
+    std::vector<int> seed_atoms, seed_ind, seed_xyz;
+    std::vector<size_t> seed_cluster;
+    FcPropertyIndex seed_index(order + 2);
+    size_t nseeds = 0;
 
-    for (const auto &pair : pairs) {
+    for (size_t icluster = 0; icluster < pairs.size(); ++icluster) {
 
-        for (i = 0; i < order + 2; ++i) atmn[i] = pair.iarray[i];
+        for (i = 0; i < order + 2; ++i) atmn[i] = pairs[icluster][i];
 
         for (i1 = 0; i1 < nxyz; ++i1) {
             for (i = 0; i < order + 2; ++i) ind[i] = 3 * atmn[i] + xyzcomponent[i1][i];
@@ -220,145 +277,257 @@ void Fcs::generate_force_constant_table(const int order,
             if (!is_ascending(order + 2, ind)) continue;
 
             i_prim = get_minimum_index_in_primitive(order + 2, ind, nat,
-                                                    symm_in->get_nat_prim(),
-                                                    symm_in->get_map_p2s());
+                                                    natmin, map_p2s);
             std::swap(ind[0], ind[i_prim]);
             sort_tail(order + 2, ind);
 
-            is_zero = false;
+            // A duplicate keeps the position of its first occurrence.
+            seed_index.insert(ind, 1.0, nseeds);
+
+            for (i = 0; i < order + 2; ++i) {
+                seed_atoms.push_back(atmn[i]);
+                seed_ind.push_back(ind[i]);
+            }
+            seed_xyz.push_back(i1);
+            seed_cluster.push_back(icluster);
+            ++nseeds;
+        }
+    }
+
+    deallocate(atmn);
+    deallocate(ind);
+
+    // Build the orbits in parallel. A seed is skipped once it is known to
+    // belong to the orbit of an earlier seed. An orbit built from a seed
+    // other than its owner is discarded, so that the coefficients and the
+    // order of the elements are the same as those of the serial search.
+
+    const auto none = std::numeric_limits<size_t>::max();
+    std::vector<std::atomic<size_t>> seed_owner(nseeds);
+    for (auto &it : seed_owner) it.store(none, std::memory_order_relaxed);
+
+    // orbit_status: 0 (not owned), 1 (nonzero), or 2 (zero by symmetry)
+    std::vector<FcPropertyTable> orbit(nseeds, FcPropertyTable(order + 2));
+    std::vector<int> orbit_status(nseeds, 0);
+
+    const CoefSymTable coef_table(order + 2, nxyz, xyzcomponent);
 
-            if (list_found.find(IntList(order + 2, ind)) != list_found.end()) continue; // Already exits!
+    // A seed whose cluster is mapped to an earlier cluster, or to an earlier
+    // seed of the same cluster by the stabilizer, cannot own its orbit.
+
+#ifdef _OPENMP
+#pragma omp parallel
+#endif
+    {
+        size_t j_omp;
+        int i_omp, i2_omp, i_prim_omp;
+        size_t iop_omp;
+        double c_tmp_omp;
+        bool is_zero_omp;
+        int *ind_mapped_omp, *ind_mapped_tmp_omp, *atmn_mapped_omp;
+        std::vector<char> is_searched_omp(3 * nat, 0);
+        std::vector<size_t> seeds_in_orbit_omp;
+        FcPropertyTable fc_orbit_omp(order + 2);
+        std::vector<std::pair<int, double>> coef_nonzero_omp;
+        FcPropertyIndex list_found_omp;
+        size_t iter_found_omp;
+
+        allocate(ind_mapped_omp, order + 2);
+        allocate(ind_mapped_tmp_omp, order + 2);
+        allocate(atmn_mapped_omp, order + 2);
+
+#ifdef _OPENMP
+#pragma omp for schedule(dynamic, 1)
+#endif
+        for (int iseed = 0; iseed < static_cast<int>(nseeds); ++iseed) {
+
+            const auto owner = seed_owner[iseed].load(std::memory_order_relaxed);
+            if (owner != none && owner != static_cast<size_t>(iseed)) continue;
+
+            const auto icluster_seed = seed_cluster[iseed];
+            if (cluster_orbit.get_representative(icluster_seed) != icluster_seed) continue;
+
+            const auto ind_seed = &seed_ind[iseed * (order + 2)];
+            const auto xyz_seed = xyzcomponent[seed_xyz[iseed]];
+            const auto atmn_seed = &seed_atoms[iseed * (order + 2)];
+
+            auto is_owner = true;
+            for (const auto iop : cluster_orbit.get_stabilizer(icluster_seed)) {
+                const auto isym = cluster_orbit.get_operation(icluster_seed, iop);
+                const auto map_sym = symmop.get_map_sym(isym);
+                for (i_omp = 0; i_omp < order + 2; ++i_omp) {
+                    atmn_mapped_omp[i_omp] = map_sym[atmn_seed[i_omp]];
+                }
+
+                coef_table.get_nonzero(symmop.get_rotation(isym), xyz_seed, coef_nonzero_omp);
+
+                for (const auto &it : coef_nonzero_omp) {
+                    if (std::abs(it.second) <= eps12) continue;
+                    for (i_omp = 0; i_omp < order + 2; ++i_omp) {
+                        ind_mapped_omp[i_omp] = 3 * atmn_mapped_omp[i_omp] + xyzcomponent[it.first][i_omp];
+                    }
+                    i_prim_omp = get_minimum_index_in_primitive(order + 2, ind_mapped_omp,
+                                                                nat, natmin, map_p2s);
+                    std::swap(ind_mapped_omp[0], ind_mapped_omp[i_prim_omp]);
+                    sort_tail(order + 2, ind_mapped_omp);
+
+                    iter_found_omp = seed_index.find(ind_mapped_omp);
+                    if (iter_found_omp != FcPropertyIndex::npos
+                        && seed_index.get_mother(iter_found_omp) < static_cast<size_t>(iseed)) {
+                        is_owner = false;
+                        break;
+                    }
+                }
+                if (!is_owner) break;
+            }
+            if (!is_owner) continue;
+
+            list_found_omp.init(order + 2, 0);
+            fc_orbit_omp.clear();
+            seeds_in_orbit_omp.clear();
+            is_zero_omp = false;
+            auto owner_min = static_cast<size_t>(iseed);
 
             // Search symmetrically-dependent parameter set
 
-            size_t ndeps = 0;
+            const auto nop = cluster_orbit.get_number_of_operations(icluster_seed);
 
-            for (isym = 0; isym < nsym_in_use; ++isym) {
+            for (iop_omp = 0; iop_omp < nop; ++iop_omp) {
 
-                for (i = 0; i < order + 2; ++i) atmn_mapped[i] = map_sym[atmn[i]][isym];
+                const auto isym_omp = cluster_orbit.get_operation(icluster_seed, iop_omp);
+                const auto map_sym_omp = symmop.get_map_sym(isym_omp);
+                for (i_omp = 0; i_omp < order + 2; ++i_omp) {
+                    atmn_mapped_omp[i_omp] = map_sym_omp[atmn_seed[i_omp]];
+                }
 
-                if (!is_inprim(order + 2,
-                               atmn_mapped,
-                               symm_in->get_nat_prim(),
-                               symm_in->get_map_p2s()))
-                    continue;
+                coef_table.get_nonzero(symmop.get_rotation(isym_omp), xyz_seed, coef_nonzero_omp);
 
-                for (i2 = 0; i2 < nxyz; ++i2) {
+                for (const auto &it : coef_nonzero_omp) {
 
-                    c_tmp = coef_sym(order + 2,
-                                     rotation[isym],
-                                     xyzcomponent[i1],
-                                     xyzcomponent[i2]);
+                    i2_omp = it.first;
+                    c_tmp_omp = it.second;
 
-                    if (std::abs(c_tmp) > eps12) {
-                        for (i = 0; i < order + 2; ++i)
-                            ind_mapped[i] = 3 * atmn_mapped[i] + xyzcomponent[i2][i];
+                    if (std::abs(c_tmp_omp) <= eps12) continue;
 
-                        i_prim = get_minimum_index_in_primitive(order + 2,
-                                                                ind_mapped,
+                    for (i_omp = 0; i_omp < order + 2; ++i_omp) {
+                        ind_mapped_omp[i_omp] = 3 * atmn_mapped_omp[i_omp] + xyzcomponent[i2_omp][i_omp];
+                    }
+
+                    i_prim_omp = get_minimum_index_in_primitive(order + 2,
+                                                                ind_mapped_omp,
                                                                 nat,
-                                                                symm_in->get_nat_prim(),
-                                                                symm_in->get_map_p2s());
-                        std::swap(ind_mapped[0], ind_mapped[i_prim]);
-                        sort_tail(order + 2, ind_mapped);
-
-                        if (!is_zero) {
-                            bool zeroflag = true;
-                            for (i = 0; i < order + 2; ++i) {
-                                zeroflag = zeroflag & (ind[i] == ind_mapped[i]);
-                            }
-                            zeroflag = zeroflag & (std::abs(c_tmp + 1.0) < eps8);
-                            is_zero = zeroflag;
+                                                                natmin,
+                                                                map_p2s);
+                    std::swap(ind_mapped_omp[0], ind_mapped_omp[i_prim_omp]);
+                    sort_tail(order + 2, ind_mapped_omp);
+
+                    if (!is_zero_omp) {
+                        bool zeroflag = true;
+                        for (i_omp = 0; i_omp < order + 2; ++i_omp) {
+                            zeroflag = zeroflag & (ind_seed[i_omp] == ind_mapped_omp[i_omp]);
                         }
+                        zeroflag = zeroflag & (std::abs(c_tmp_omp + 1.0) < eps8);
+                        is_zero_omp = zeroflag;
+                    }
 
-                        // Add to found list (set) and fcset (vector) if the created is new one.
-
-                        if (list_found.find(IntList(order + 2, ind_mapped)) == list_found.end()) {
-                            list_found.insert(IntList(order + 2, ind_mapped));
+                    // Add to found list (set) and fcset (vector) if the created is new one.
 
-                            fc_vec.emplace_back(FcProperty(order + 2,
-                                                           c_tmp,
-                                                           ind_mapped,
-                                                           nmother));
-                            ++ndeps;
+                    if (!list_found_omp.insert(ind_mapped_omp, c_tmp_omp, 0)) continue;
 
-                            // Add equivalent interaction list (permutation) if there are two or more indices
-                            // which belong to the primitive cell.
-                            // This procedure is necessary for constructing a sensing matrix.
+                    iter_found_omp = seed_index.find(ind_mapped_omp);
+                    if (iter_found_omp != FcPropertyIndex::npos) {
+                        const auto iseed_found_omp = seed_index.get_mother(iter_found_omp);
+                        seeds_in_orbit_omp.push_back(iseed_found_omp);
+                        owner_min = std::min(owner_min, iseed_found_omp);
+                    }
 
-                            for (i = 0; i < 3 * nat; ++i) is_searched[i] = false;
-                            is_searched[ind_mapped[0]] = true;
-                            for (i = 1; i < order + 2; ++i) {
-                                if ((!is_searched[ind_mapped[i]]) && is_inprim(ind_mapped[i],
-                                                                               symm_in->get_nat_prim(),
-                                                                               symm_in->get_map_p2s())) {
+                    fc_orbit_omp.push_back(ind_mapped_omp, c_tmp_omp, 0);
 
-                                    for (j = 0; j < order + 2; ++j) ind_mapped_tmp[j] = ind_mapped[j];
-                                    std::swap(ind_mapped_tmp[0], ind_mapped_tmp[i]);
-                                    sort_tail(order + 2, ind_mapped_tmp);
-                                    fc_vec.emplace_back(FcProperty(order + 2,
-                                                                   c_tmp,
-                                                                   ind_mapped_tmp,
-                                                                   nmother));
+                    // Add equivalent interaction list (permutation) if there are two or more indices
+                    // which belong to the primitive cell.
+                    // This procedure is necessary for constructing a sensing matrix.
 
-                                    ++ndeps;
+                    is_searched_omp[ind_mapped_omp[0]] = 1;
+                    for (i_omp = 1; i_omp < order + 2; ++i_omp) {
+                        if ((!is_searched_omp[ind_mapped_omp[i_omp]]) && is_inprim(ind_mapped_omp[i_omp],
+                                                                                   natmin,
+                                                                                   map_p2s)) {
 
-                                    is_searched[ind_mapped[i]] = true;
-                                }
+                            for (j_omp = 0; j_omp < order + 2; ++j_omp) {
+                                ind_mapped_tmp_omp[j_omp] = ind_mapped_omp[j_omp];
                             }
+                            std::swap(ind_mapped_tmp_omp[0], ind_mapped_tmp_omp[i_omp]);
+                            sort_tail(order + 2, ind_mapped_tmp_omp);
+                            fc_orbit_omp.push_back(ind_mapped_tmp_omp, c_tmp_omp, 0);
 
-
+                            is_searched_omp[ind_mapped_omp[i_omp]] = 1;
                         }
                     }
+                    for (i_omp = 0; i_omp < order + 2; ++i_omp) is_searched_omp[ind_mapped_omp[i_omp]] = 0;
                 }
             } // close symmetry loop
 
-            if (is_zero) {
-                if (store_zeros_in) {
-                    for (auto it = fc_vec.rbegin(); it != fc_vec.rbegin() + ndeps; ++it) {
-                        (*it).mother = std::numeric_limits<size_t>::max();
-                        fc_zeros_out.push_back(*it);
-                    }
-                }
-                for (i = 0; i < ndeps; ++i) fc_vec.pop_back();
-            } else {
-                ndup.push_back(ndeps);
-                ++nmother;
+            for (const auto it : seeds_in_orbit_omp) {
+                seed_owner[it].store(owner_min, std::memory_order_relaxed);
             }
 
-        } // close xyz component loop
-    }     // close atom number loop (iterator)
+            if (owner_min == static_cast<size_t>(iseed)) {
+                std::swap(orbit[iseed], fc_orbit_omp);
+                orbit_status[iseed] = is_zero_omp ? 2 : 1;
+            }
+        } // close seed loop
 
-    deallocate(xyzcomponent);
-    list_found.clear();
-    deallocate(atmn);
-    deallocate(atmn_mapped);
-    deallocate(ind);
-    deallocate(ind_mapped);
-    deallocate(ind_tmp);
-    deallocate(ind_mapped_tmp);
-    deallocate(is_searched);
-    deallocate(rotation);
-    deallocate(map_sym);
-
-    // sort fc_vec
-
-    if (!ndup.empty()) {
-        std::sort(fc_vec.begin(), fc_vec.begin() + ndup[0]);
-        auto nbegin = ndup[0];
-        for (size_t mm = 1; mm < ndup.size(); ++mm) {
-            const auto nend = nbegin + ndup[mm];
-            std::sort(fc_vec.begin() + nbegin, fc_vec.begin() + nend);
-            nbegin += ndup[mm];
+        deallocate(ind_mapped_omp);
+        deallocate(ind_mapped_tmp_omp);
+        deallocate(atmn_mapped_omp);
+    }
+
+    // Number the orbits in the order of their owners.
+    // The entries of each orbit are sorted by their indices.
+
+    const auto nelems = order + 2;
+    size_t nmother = 0;
+    std::vector<size_t> index_sorted;
+
+    for (i = 0; i < nseeds; ++i) {
+        if (orbit_status[i] == 0) continue;
+
+        const auto &fc_orbit = orbit[i];
+
+        if (orbit_status[i] == 2) {
+            if (store_zeros_in) {
+                for (auto j = fc_orbit.size(); j-- > 0;) {
+                    fc_zeros_out.push_back(fc_orbit.get_elems(j), fc_orbit.get_sign(j),
+                                           std::numeric_limits<size_t>::max());
+                }
+            }
+        } else {
+            index_sorted.resize(fc_orbit.size());
+            for (size_t j = 0; j < fc_orbit.size(); ++j) index_sorted[j] = j;
+            std::sort(index_sorted.begin(), index_sorted.end(),
+                      [&fc_orbit, nelems](const size_t a, const size_t b) {
+                          const auto pa = fc_orbit.get_elems(a);
+                          const auto pb = fc_orbit.get_elems(b);
+                          return std::lexicographical_compare(pa, pa + nelems, pb, pb + nelems);
+                      });
+            for (const auto j : index_sorted) {
+                fc_vec.push_back(fc_orbit.get_elems(j), fc_orbit.get_sign(j), nmother);
+            }
+            ndup.push_back(fc_orbit.size());
+            ++nmother;
         }
+        orbit[i] = FcPropertyTable();
     }
+
+    deallocate(xyzcomponent);
 }
 
 void Fcs::get_constraint_symmetry(const size_t nat,
                                   const Symmetry *symmetry,
                                   const int order,
                                   const std::string basis,
-                                  const std::vector<FcProperty> &fc_table_in,
+                                  const FcPropertyTable &fc_table_in,
+                                  const ClusterOrbitTable &cluster_orbit,
                                   const size_t nparams,
                                   const double tolerance,
                                   ConstraintSparseForm &const_out,
@@ -369,20 +538,14 @@ void Fcs::get_constraint_symmetry(const size_t nat,
 
     int i;
     // int j;
-    unsigned int isym;
+    size_t isym;
     int ixyz;
-    int *index_tmp;
     int **xyzcomponent;
-    int nsym_in_use;
-    std::unordered_set<FcProperty> list_found;
 
     typedef std::vector<ConstraintDoubleElement> ConstEntry;
     std::vector<ConstEntry> constraint_all;
     ConstEntry const_tmp;
 
-    int **map_sym;
-    double ***rotation;
-    const auto nsym = symmetry->get_SymmData().size();
     const auto natmin = symmetry->get_nat_prim();
     const auto nfcs = fc_table_in.size();
     const auto use_compatible = false;
@@ -391,54 +554,44 @@ void Fcs::get_constraint_symmetry(const size_t nat,
 
     const auto nxyz = static_cast<int>(std::pow(static_cast<double>(3), order + 2));
 
-    allocate(rotation, nsym, 3, 3);
-    allocate(map_sym, nat, nsym);
-
-    get_available_symmop(nat,
-                         symmetry,
-                         basis,
-                         nsym_in_use,
-                         map_sym,
-                         rotation,
-                         use_compatible);
-
-    if (nsym_in_use == 0) {
-        deallocate(rotation);
-        deallocate(map_sym);
-        return;
-    }
+    const auto &symmop = symmetry->get_symmetry_operations(basis, use_compatible);
+    const auto nsym_in_use = symmop.nsym;
+
+    if (nsym_in_use == 0) return;
 
     const_out.clear();
 
-    allocate(index_tmp, order + 2);
     allocate(xyzcomponent, nxyz, order + 2);
     get_xyzcomponent(order + 2, xyzcomponent);
 
     // Generate temporary list of parameters
-    list_found.clear();
-    for (const auto &p : fc_table_in) {
-        for (i = 0; i < order + 2; ++i) index_tmp[i] = p.elems[i];
-        list_found.insert(FcProperty(order + 2, p.sign,
-                                     index_tmp, p.mother));
-    }
+    const FcPropertyIndex list_found(order + 2, fc_table_in);
+    const CoefSymTable coef_table(order + 2, nxyz, xyzcomponent);
+
+#ifdef _OPENMP
+    const auto nthreads = omp_get_max_threads();
+#else
+    const auto nthreads = 1;
+#endif
+    std::vector<std::vector<ConstEntry>> constraint_thread(nthreads);
 
+    // Each row is accumulated in a sparse form (column, value), and
+    // the duplicates are removed in each thread before merging.
 
 #ifdef _OPENMP
 #pragma omp parallel
 #endif
     {
-        int j;
         int i_prim;
         int loc_nonzero;
         int *ind;
-        int *atm_index, *atm_index_symm;
+        int *atm_index, *atm_index_symm, *atm_index_sorted;
         int *xyz_index;
+        size_t icluster, iop, nop;
         double c_tmp;
-        // double maxabs;
 
-        std::unordered_set<FcProperty>::iterator iter_found;
-        std::vector<double> const_now_omp;
-        std::vector<std::vector<double>> const_omp;
+        size_t iter_found;
+        std::vector<std::pair<int, double>> coef_nonzero_omp;
 
         ConstEntry const_tmp_omp;
         std::vector<ConstEntry> constraint_list_omp;
@@ -446,10 +599,14 @@ void Fcs::get_constraint_symmetry(const size_t nat,
         allocate(ind, order + 2);
         allocate(atm_index, order + 2);
         allocate(atm_index_symm, order + 2);
+        allocate(atm_index_sorted, order + 2);
         allocate(xyz_index, order + 2);
 
-        const_omp.clear();
-        const_now_omp.resize(nparams);
+#ifdef _OPENMP
+        const auto ithread = omp_get_thread_num();
+#else
+        const auto ithread = 0;
+#endif
 
 #ifdef _OPENMP
 #pragma omp for private(i, isym, ixyz), schedule(static)
@@ -457,21 +614,34 @@ void Fcs::get_constraint_symmetry(const size_t nat,
         for (long ii = 0; ii < nfcs; ++ii) {
 
             for (i = 0; i < order + 2; ++i) {
-                atm_index[i] = fc_table_in[ii].elems[i] / 3;
-                xyz_index[i] = fc_table_in[ii].elems[i] % 3;
+                atm_index[i] = fc_table_in.get_elems(ii)[i] / 3;
+                xyz_index[i] = fc_table_in.get_elems(ii)[i] % 3;
+                atm_index_sorted[i] = atm_index[i];
             }
 
-            for (isym = 0; isym < nsym_in_use; ++isym) {
+            // Only the operations that map the cluster to a cluster having
+            // an atom in the primitive cell are examined.
+            std::sort(atm_index_sorted, atm_index_sorted + order + 2);
+            icluster = cluster_orbit.find(atm_index_sorted);
+            nop = icluster == FcPropertyIndex::npos ? nsym_in_use
+                                                     : cluster_orbit.get_number_of_operations(icluster);
 
+            for (iop = 0; iop < nop; ++iop) {
+
+                isym = icluster == FcPropertyIndex::npos ? iop
+                                                         : cluster_orbit.get_operation(icluster, iop);
+                const auto map_sym_now = symmop.get_map_sym(isym);
                 for (i = 0; i < order + 2; ++i)
-                    atm_index_symm[i] = map_sym[atm_index[i]][isym];
+                    atm_index_symm[i] = map_sym_now[atm_index[i]];
                 if (!is_inprim(order + 2, atm_index_symm, natmin, symmetry->get_map_p2s())) continue;
 
-                for (i = 0; i < nparams; ++i) const_now_omp[i] = 0.0;
+                const_tmp_omp.clear();
+                const_tmp_omp.emplace_back(fc_table_in.get_mother(ii), -fc_table_in.get_sign(ii));
 
-                const_now_omp[fc_table_in[ii].mother] = -fc_table_in[ii].sign;
+                coef_table.get_nonzero(symmop.get_rotation(isym), xyz_index, coef_nonzero_omp);
 
-                for (ixyz = 0; ixyz < nxyz; ++ixyz) {
+                for (const auto &it : coef_nonzero_omp) {
+                    ixyz = it.first;
                     for (i = 0; i < order + 2; ++i)
                         ind[i] = 3 * atm_index_symm[i] + xyzcomponent[ixyz][i];
 
@@ -479,24 +649,24 @@ void Fcs::get_constraint_symmetry(const size_t nat,
                     std::swap(ind[0], ind[i_prim]);
                     sort_tail(order + 2, ind);
 
-                    iter_found = list_found.find(FcProperty(order + 2, 1.0, ind, 1));
-                    if (iter_found != list_found.end()) {
-                        c_tmp = coef_sym(order + 2, rotation[isym], xyz_index, xyzcomponent[ixyz]);
-                        const_now_omp[(*iter_found).mother] += (*iter_found).sign * c_tmp;
+                    iter_found = list_found.find(ind);
+                    if (iter_found != FcPropertyIndex::npos) {
+                        c_tmp = it.second;
+                        const_tmp_omp.emplace_back(list_found.get_mother(iter_found), list_found.get_sign(iter_found) * c_tmp);
                     }
                 }
 
-                if (!is_allzero(const_now_omp, eps8, loc_nonzero)) {
-                    if (const_now_omp[loc_nonzero] < 0.0) {
-                        for (j = 0; j < nparams; ++j) const_now_omp[j] *= -1.0;
-                    }
+                reduce_sparse_row(const_tmp_omp);
 
-                    const_tmp_omp.clear();
-                    for (j = 0; j < nparams; ++j) {
-                        if (std::abs(const_now_omp[j]) >= eps8) {
-                            const_tmp_omp.emplace_back(j, const_now_omp[j]);
-                        }
+                if (!is_allzero(const_tmp_omp, eps8, loc_nonzero)) {
+                    if (const_tmp_omp[loc_nonzero].val < 0.0) {
+                        for (auto &it : const_tmp_omp) it.val *= -1.0;
                     }
+                    const_tmp_omp.erase(std::remove_if(const_tmp_omp.begin(), const_tmp_omp.end(),
+                                                       [](const ConstraintDoubleElement &elem) {
+                                                           return std::abs(elem.val) < eps8;
+                                                       }),
+                                        const_tmp_omp.end());
                     constraint_list_omp.emplace_back(const_tmp_omp);
                 }
 
@@ -506,21 +676,25 @@ void Fcs::get_constraint_symmetry(const size_t nat,
         deallocate(ind);
         deallocate(atm_index);
         deallocate(atm_index_symm);
+        deallocate(atm_index_sorted);
         deallocate(xyz_index);
 
-#pragma omp critical
-        {
-            for (const auto &it : constraint_list_omp) {
-                constraint_all.emplace_back(it);
-            }
-        }
-        constraint_list_omp.clear();
+        std::sort(constraint_list_omp.begin(), constraint_list_omp.end());
+        constraint_list_omp.erase(std::unique(constraint_list_omp.begin(),
+                                              constraint_list_omp.end()),
+                                  constraint_list_omp.end());
+        constraint_thread[ithread] = std::move(constraint_list_omp);
     } // close openmp region
 
     deallocate(xyzcomponent);
-    deallocate(index_tmp);
-    deallocate(rotation);
-    deallocate(map_sym);
+
+    // Merge in the order of the threads. The result of sort and unique
+    // below does not depend on the number of threads.
+    for (auto ith = 0; ith < nthreads; ++ith) {
+        std::move(constraint_thread[ith].begin(), constraint_thread[ith].end(),
+                  std::back_inserter(constraint_all));
+    }
+    constraint_thread.clear();
 
     std::sort(constraint_all.begin(), constraint_all.end());
     constraint_all.erase(std::unique(constraint_all.begin(),
@@ -553,7 +727,8 @@ void Fcs::get_constraint_symmetry_in_integer(const size_t nat,
                                              const Symmetry *symmetry,
                                              const int order,
                                              const std::string basis,
-                                             const std::vector<FcProperty> &fc_table_in,
+                                             const FcPropertyTable &fc_table_in,
+                                             const ClusterOrbitTable &cluster_orbit,
                                              const size_t nparams,
                                              const double tolerance,
                                              ConstraintSparseForm &const_out,
@@ -566,20 +741,14 @@ void Fcs::get_constraint_symmetry_in_integer(const size_t nat,
     // This version is expected to be more stable (and fast?).
 
     int i;
-    unsigned int isym;
+    size_t isym;
     int ixyz;
-    int *index_tmp;
     int **xyzcomponent;
-    int nsym_in_use;
-    std::unordered_set<FcProperty> list_found;
 
     typedef std::vector<ConstraintIntegerElement> ConstEntry;
     std::vector<ConstEntry> constraint_all;
     ConstEntry const_tmp;
 
-    int **map_sym;
-    double ***rotation;
-    const auto nsym = symmetry->get_SymmData().size();
     const auto natmin = symmetry->get_nat_prim();
     const auto nfcs = fc_table_in.size();
     const auto use_compatible = false;
@@ -588,52 +757,41 @@ void Fcs::get_constraint_symmetry_in_integer(const size_t nat,
 
     const auto nxyz = static_cast<int>(std::pow(static_cast<double>(3), order + 2));
 
-    allocate(rotation, nsym, 3, 3);
-    allocate(map_sym, nat, nsym);
-
-    get_available_symmop(nat,
-                         symmetry,
-                         basis,
-                         nsym_in_use,
-                         map_sym,
-                         rotation,
-                         use_compatible);
-
-    if (nsym_in_use == 0) {
-        deallocate(rotation);
-        deallocate(map_sym);
-        return;
-    }
+    const auto &symmop = symmetry->get_symmetry_operations(basis, use_compatible);
+    const auto nsym_in_use = symmop.nsym;
+
+    if (nsym_in_use == 0) return;
 
     const_out.clear();
 
-    allocate(index_tmp, order + 2);
     allocate(xyzcomponent, nxyz, order + 2);
     get_xyzcomponent(order + 2, xyzcomponent);
 
     // Generate temporary list of parameters
-    list_found.clear();
-    for (const auto &p : fc_table_in) {
-        for (i = 0; i < order + 2; ++i) index_tmp[i] = p.elems[i];
-        list_found.insert(FcProperty(order + 2, p.sign,
-                                     index_tmp, p.mother));
-    }
+    const FcPropertyIndex list_found(order + 2, fc_table_in);
+    const CoefSymTable coef_table(order + 2, nxyz, xyzcomponent);
+
+#ifdef _OPENMP
+    const auto nthreads = omp_get_max_threads();
+#else
+    const auto nthreads = 1;
+#endif
+    std::vector<std::vector<ConstEntry>> constraint_thread(nthreads);
 
 #ifdef _OPENMP
 #pragma omp parallel
 #endif
     {
-        int j;
         int i_prim;
         int loc_nonzero;
         int *ind;
-        int *atm_index, *atm_index_symm;
+        int *atm_index, *atm_index_symm, *atm_index_sorted;
         int *xyz_index;
+        size_t icluster, iop, nop;
         int c_tmp;
 
-        std::unordered_set<FcProperty>::iterator iter_found;
-        std::vector<int> const_now_omp;
-        std::vector<std::vector<int>> const_omp;
+        size_t iter_found;
+        std::vector<std::pair<int, double>> coef_nonzero_omp;
 
         ConstEntry const_tmp_omp;
         std::vector<ConstEntry> constraint_list_omp;
@@ -641,10 +799,14 @@ void Fcs::get_constraint_symmetry_in_integer(const size_t nat,
         allocate(ind, order + 2);
         allocate(atm_index, order + 2);
         allocate(atm_index_symm, order + 2);
+        allocate(atm_index_sorted, order + 2);
         allocate(xyz_index, order + 2);
 
-        const_omp.clear();
-        const_now_omp.resize(nparams);
+#ifdef _OPENMP
+        const auto ithread = omp_get_thread_num();
+#else
+        const auto ithread = 0;
+#endif
 
 #ifdef _OPENMP
 #pragma omp for private(i, isym, ixyz), schedule(static)
@@ -652,21 +814,34 @@ void Fcs::get_constraint_symmetry_in_integer(const size_t nat,
         for (long ii = 0; ii < nfcs; ++ii) {
 
             for (i = 0; i < order + 2; ++i) {
-                atm_index[i] = fc_table_in[ii].elems[i] / 3;
-                xyz_index[i] = fc_table_in[ii].elems[i] % 3;
+                atm_index[i] = fc_table_in.get_elems(ii)[i] / 3;
+                xyz_index[i] = fc_table_in.get_elems(ii)[i] % 3;
+                atm_index_sorted[i] = atm_index[i];
             }
 
-            for (isym = 0; isym < nsym_in_use; ++isym) {
+            // Only the operations that map the cluster to a cluster having
+            // an atom in the primitive cell are examined.
+            std::sort(atm_index_sorted, atm_index_sorted + order + 2);
+            icluster = cluster_orbit.find(atm_index_sorted);
+            nop = icluster == FcPropertyIndex::npos ? nsym_in_use
+                                                     : cluster_orbit.get_number_of_operations(icluster);
 
+            for (iop = 0; iop < nop; ++iop) {
+
+                isym = icluster == FcPropertyIndex::npos ? iop
+                                                         : cluster_orbit.get_operation(icluster, iop);
+                const auto map_sym_now = symmop.get_map_sym(isym);
                 for (i = 0; i < order + 2; ++i)
-                    atm_index_symm[i] = map_sym[atm_index[i]][isym];
+                    atm_index_symm[i] = map_sym_now[atm_index[i]];
                 if (!is_inprim(order + 2, atm_index_symm, natmin, symmetry->get_map_p2s())) continue;
 
-                for (i = 0; i < nparams; ++i) const_now_omp[i] = 0;
+                const_tmp_omp.clear();
+                const_tmp_omp.emplace_back(fc_table_in.get_mother(ii), -nint(fc_table_in.get_sign(ii)));
 
-                const_now_omp[fc_table_in[ii].mother] = -nint(fc_table_in[ii].sign);
+                coef_table.get_nonzero(symmop.get_rotation(isym), xyz_index, coef_nonzero_omp);
 
-                for (ixyz = 0; ixyz < nxyz; ++ixyz) {
+                for (const auto &it : coef_nonzero_omp) {
+                    ixyz = it.first;
                     for (i = 0; i < order + 2; ++i)
                         ind[i] = 3 * atm_index_symm[i] + xyzcomponent[ixyz][i];
 
@@ -674,24 +849,24 @@ void Fcs::get_constraint_symmetry_in_integer(const size_t nat,
                     std::swap(ind[0], ind[i_prim]);
                     sort_tail(order + 2, ind);
 
-                    iter_found = list_found.find(FcProperty(order + 2, 1.0, ind, 1));
-                    if (iter_found != list_found.end()) {
-                        c_tmp = nint(coef_sym(order + 2, rotation[isym], xyz_index, xyzcomponent[ixyz]));
-                        const_now_omp[(*iter_found).mother] += nint((*iter_found).sign) * c_tmp;
+                    iter_found = list_found.find(ind);
+                    if (iter_found != FcPropertyIndex::npos) {
+                        c_tmp = nint(it.second);
+                        const_tmp_omp.emplace_back(list_found.get_mother(iter_found), nint(list_found.get_sign(iter_found)) * c_tmp);
                     }
                 }
 
-                if (!is_allzero(const_now_omp, loc_nonzero)) {
-                    if (const_now_omp[loc_nonzero] < 0) {
-                        for (j = 0; j < nparams; ++j) const_now_omp[j] *= -1;
-                    }
+                reduce_sparse_row(const_tmp_omp);
 
-                    const_tmp_omp.clear();
-                    for (j = 0; j < nparams; ++j) {
-                        if (std::abs(const_now_omp[j]) > 0) {
-                            const_tmp_omp.emplace_back(j, const_now_omp[j]);
-                        }
+                if (!is_allzero(const_tmp_omp, loc_nonzero)) {
+                    if (const_tmp_omp[loc_nonzero].val < 0) {
+                        for (auto &it : const_tmp_omp) it.val *= -1;
                     }
+                    const_tmp_omp.erase(std::remove_if(const_tmp_omp.begin(), const_tmp_omp.end(),
+                                                       [](const ConstraintIntegerElement &elem) {
+                                                           return elem.val == 0;
+                                                       }),
+                                        const_tmp_omp.end());
                     constraint_list_omp.emplace_back(const_tmp_omp);
                 }
 
@@ -701,21 +876,25 @@ void Fcs::get_constraint_symmetry_in_integer(const size_t nat,
         deallocate(ind);
         deallocate(atm_index);
         deallocate(atm_index_symm);
+        deallocate(atm_index_sorted);
         deallocate(xyz_index);
 
-#pragma omp critical
-        {
-            for (const auto &it : constraint_list_omp) {
-                constraint_all.emplace_back(it);
-            }
-        }
-        constraint_list_omp.clear();
+        std::sort(constraint_list_omp.begin(), constraint_list_omp.end());
+        constraint_list_omp.erase(std::unique(constraint_list_omp.begin(),
+                                              constraint_list_omp.end()),
+                                  constraint_list_omp.end());
+        constraint_thread[ithread] = std::move(constraint_list_omp);
     } // close openmp region
 
     deallocate(xyzcomponent);
-    deallocate(index_tmp);
-    deallocate(rotation);
-    deallocate(map_sym);
+
+    // Merge in the order of the threads. The result of sort and unique
+    // below does not depend on the number of threads.
+    for (auto ith = 0; ith < nthreads; ++ith) {
+        std::move(constraint_thread[ith].begin(), constraint_thread[ith].end(),
+                  std::back_inserter(constraint_all));
+    }
+    constraint_thread.clear();
 
     std::sort(constraint_all.begin(), constraint_all.end());
     constraint_all.erase(std::unique(constraint_all.begin(),
@@ -749,14 +928,63 @@ std::vector<size_t>* Fcs::get_nequiv() const
     return nequiv;
 }
 
-std::vector<FcProperty>* Fcs::get_fc_table() const
+const ClusterOrbitTable* Fcs::get_cluster_orbit_table(const bool compatible) const
+{
+    return compatible ? cluster_orbit : cluster_orbit_constraint;
+}
+
+const FcPropertyTable* Fcs::get_fc_property_table() const
 {
     return fc_table;
 }
 
+std::vector<FcProperty>* Fcs::get_fc_table() const
+{
+    if (!fc_table) return nullptr;
+    std::call_once(*fc_table_vec_once, &Fcs::make_fc_table_vector, this);
+    return fc_table_vec;
+}
+
+void Fcs::make_fc_table_vector() const
+{
+    for (auto i = 0; i < maxorder_table; ++i) {
+        fc_table_vec[i] = fc_table[i].to_vector();
+    }
+}
+
+void Fcs::clear_fc_table_vector()
+{
+    if (fc_table_vec) {
+        deallocate(fc_table_vec);
+    }
+    if (fc_table_vec_once) {
+        deallocate(fc_table_vec_once);
+    }
+    if (maxorder_table > 0) {
+        allocate(fc_table_vec, maxorder_table);
+        allocate(fc_table_vec_once, 1);
+    }
+}
+
 std::vector<ForceConstantTable>* Fcs::get_fc_cart() const
 {
-    return fc_cart;
+    if (!fc_cart) return nullptr;
+    std::call_once(*fc_cart_vec_once, &Fcs::make_forceconstant_cartesian_vector, this);
+    return fc_cart_vec;
+}
+
+void Fcs::make_forceconstant_cartesian_vector() const
+{
+    for (auto i = 0; i < maxorder_cart; ++i) {
+        fc_cart_vec[i] = get_fc_cart_table(i)->to_vector();
+    }
+}
+
+const FcCartesianTable* Fcs::get_fc_cart_table(const int order) const
+{
+    if (!fc_cart || order < 0 || order >= maxorder_cart) return nullptr;
+    std::call_once(fc_cart_once[order], &Fcs::make_forceconstant_cartesian, this, order);
+    return &fc_cart[order];
 }
 
 void Fcs::set_forceconstant_basis(const std::string preferred_basis_in)
@@ -772,145 +1000,246 @@ std::string Fcs::get_forceconstant_basis() const
 void Fcs::set_forceconstant_cartesian(const int maxorder,
                                       double *param_in)
 {
-    auto ishift = 0;
-    int j;
+    // The parameters are stored here, and fc_cart of each order is made
+    // when it is requested for the first time (get_fc_cart_table).
 
-    std::vector<int> atoms_old, atoms_now;
-    std::vector<int> coords_now;
-    std::vector<std::vector<int>> coord_list;
-    std::vector<double> fc_list;
-    int **xyzcomponent;
-    double prod_matrix;
+    size_t nparams = 0;
+    for (auto i = 0; i < maxorder; ++i) nparams += nequiv[i].size();
 
+    clear_forceconstant_cartesian();
+
+    fc_cart_params.assign(param_in, param_in + nparams);
+    allocate(fc_cart, maxorder);
+    allocate(fc_cart_once, maxorder);
+    allocate(fc_cart_vec, maxorder);
+    allocate(fc_cart_vec_once, 1);
+    maxorder_cart = maxorder;
+    nfc_cart_permu.assign(maxorder, 0);
+    nfc_cart_nopermu.assign(maxorder, 0);
+}
+
+void Fcs::clear_forceconstant_cartesian()
+{
     if (fc_cart) {
         deallocate(fc_cart);
     }
-    allocate(fc_cart, maxorder);
-
-    std::vector<int> elems_permutation;
-
-    std::vector<FcProperty> fc_table_copy;
+    if (fc_cart_once) {
+        deallocate(fc_cart_once);
+    }
+    if (fc_cart_vec) {
+        deallocate(fc_cart_vec);
+    }
+    if (fc_cart_vec_once) {
+        deallocate(fc_cart_vec_once);
+    }
+    maxorder_cart = 0;
+    nfc_cart_permu.clear();
+    nfc_cart_nopermu.clear();
+    fc_cart_params.clear();
+}
 
-    nfc_cart_permu.resize(maxorder);
-    nfc_cart_nopermu.resize(maxorder);
+void Fcs::make_forceconstant_cartesian(const int i) const
+{
+    // The Cartesian force constants of an atom tuple whose tail is sorted
+    // (canonical tuple) are computed once from the fc_table entries with
+    // those atoms. The tuples with permuted tails are then obtained by
+    // permuting the Cartesian indices, so that fc_table is never expanded
+    // into all the permutations.
+
+    size_t ishift = 0;
+    int j, k;
+    int **xyzcomponent;
+    std::vector<size_t> index_sorted;
 
-    for (int i = 0; i < maxorder; ++i) {
+    for (auto iorder = 0; iorder < i; ++iorder) ishift += nequiv[iorder].size();
+    const auto param_in = fc_cart_params.data();
 
-        auto nelems = i + 2;
+    const auto nelems = i + 2;
 
-        atoms_old.resize(nelems);
-        atoms_now.resize(nelems);
-        coords_now.resize(nelems);
-        coord_list.clear();
-        fc_list.clear();
+    fc_cart[i] = FcCartesianTable(nelems);
 
-        const auto nxyz = static_cast<int>(std::pow(3.0, nelems));
-        allocate(xyzcomponent, nxyz, nelems);
-        get_xyzcomponent(nelems, xyzcomponent);
+    const auto nxyz = static_cast<int>(std::pow(3.0, nelems));
+    allocate(xyzcomponent, nxyz, nelems);
+    get_xyzcomponent(nelems, xyzcomponent);
 
-        for (j = 0; j < nelems; ++j) atoms_old[j] = -1;
-        int icount = 0;
+    std::vector<int> pow3(nelems);
+    std::vector<int> index_of_code(nxyz);
+    pow3[0] = 1;
+    for (k = 1; k < nelems; ++k) pow3[k] = 3 * pow3[k - 1];
+    for (auto ixyz = 0; ixyz < nxyz; ++ixyz) {
+        auto code = 0;
+        for (k = 0; k < nelems; ++k) code += xyzcomponent[ixyz][k] * pow3[k];
+        index_of_code[code] = ixyz;
+    }
 
-        fc_table_copy.clear();
-        for (const auto &it : fc_table[i]) {
-            elems_permutation = it.elems;
-            do {
-                fc_table_copy.emplace_back(nelems,
-                                           it.sign,
-                                           &elems_permutation[0],
-                                           it.mother);
-            } while (std::next_permutation(elems_permutation.begin() + 1,
-                                           elems_permutation.end()));
+    // Group the entries of fc_table by their atoms.
+    // The tail of elems is sorted, so that the atoms form a canonical tuple.
+
+    const auto &fc_table_now = fc_table[i];
+    fc_table_now.sort_index_by_atoms(index_sorted);
+
+    std::vector<size_t> group_begin;
+    for (size_t ifc = 0; ifc < index_sorted.size(); ++ifc) {
+        auto is_new = (ifc == 0);
+        if (!is_new) {
+            const auto elems_prev = fc_table_now.get_elems(index_sorted[ifc - 1]);
+            const auto elems_now = fc_table_now.get_elems(index_sorted[ifc]);
+            for (k = 0; k < nelems; ++k) {
+                if (elems_prev[k] / 3 != elems_now[k] / 3) {
+                    is_new = true;
+                    break;
+                }
+            }
         }
+        if (is_new) group_begin.push_back(ifc);
+    }
+    const auto ngroups = group_begin.size();
+    group_begin.push_back(index_sorted.size());
 
-        // Sort fc_table_copy in ascending order of atomic indices.
-        std::sort(fc_table_copy.begin(),
-                  fc_table_copy.end(),
-                  FcProperty::compare_atom_index);
+    // Cartesian force constants of the canonical tuples [ngroups][nxyz]
+    std::vector<double> fc_group(ngroups * nxyz, 0.0);
 
-        for (const auto &it : fc_table_copy) {
+    // Atom tuples with permuted tails [nkeys][nelems] and the position
+    // in the canonical tuple of each element [nkeys][nelems].
+    std::vector<std::vector<int>> key_atoms(ngroups), key_perm(ngroups);
 
-            for (j = 0; j < nelems; ++j) {
-                atoms_now[j] = it.elems[j] / 3;
-                coords_now[j] = it.elems[j] % 3;
-            }
+#ifdef _OPENMP
+#pragma omp parallel for private(j, k), schedule(dynamic)
+#endif
+    for (long igroup = 0; igroup < static_cast<long>(ngroups); ++igroup) {
 
-            if (atoms_now == atoms_old) {
+        std::vector<int> atoms(nelems), coords(nelems), run_end(nelems);
+        std::vector<int> atoms_perm(nelems), perm(nelems);
+        std::vector<bool> is_used(nelems);
+        const auto fc_out = &fc_group[igroup * nxyz];
 
-                coord_list.push_back(coords_now);
-                fc_list.push_back(param_in[it.mother + ishift] * it.sign);
+        const auto elems_first = fc_table_now.get_elems(index_sorted[group_begin[igroup]]);
+        for (k = 0; k < nelems; ++k) atoms[k] = elems_first[k] / 3;
 
-                ++icount;
+        // Runs of identical atoms in the tail [k, run_end[k])
+        for (k = nelems - 1; k >= 1; --k) {
+            run_end[k] = (k + 1 < nelems && atoms[k + 1] == atoms[k]) ? run_end[k + 1] : k + 1;
+        }
 
-            } else {
+        for (auto ifc = group_begin[igroup]; ifc < group_begin[igroup + 1]; ++ifc) {
 
-                if (icount > 0) {
-                    for (auto ixyz = 0; ixyz < nxyz; ++ixyz) {
+            const auto elems_now = fc_table_now.get_elems(index_sorted[ifc]);
+            const auto fc_now = param_in[fc_table_now.get_mother(index_sorted[ifc]) + ishift]
+                * fc_table_now.get_sign(index_sorted[ifc]);
 
-                        auto fcs_cart = 0.0;
+            for (k = 0; k < nelems; ++k) coords[k] = elems_now[k] % 3;
 
-                        for (j = 0; j < icount; ++j) {
-                            prod_matrix = 1.0;
-                            for (auto k = 0; k < nelems; ++k) {
-                                prod_matrix *= basis_conversion_matrix(coord_list[j][k],
-                                                                       xyzcomponent[ixyz][k]);
-                            }
-                            fcs_cart += prod_matrix * fc_list[j];
-                        }
+            // Loop over the distinct permutations of the coordinates
+            // within each run of identical atoms.
+            while (true) {
+                for (auto ixyz = 0; ixyz < nxyz; ++ixyz) {
+                    auto prod_matrix = 1.0;
+                    for (k = 0; k < nelems; ++k) {
+                        prod_matrix *= basis_conversion_matrix(coords[k],
+                                                               xyzcomponent[ixyz][k]);
+                    }
+                    fc_out[ixyz] += prod_matrix * fc_now;
+                }
 
-                        if (std::abs(fcs_cart) > eps12) {
-                            fc_cart[i].emplace_back(nelems,
-                                                    fcs_cart,
-                                                    &atoms_old[0],
-                                                    xyzcomponent[ixyz]);
-                        }
+                auto advanced = false;
+                for (k = nelems - 1; k >= 1;) {
+                    auto kbegin = k;
+                    while (kbegin > 1 && atoms[kbegin - 1] == atoms[k]) --kbegin;
+                    if (std::next_permutation(coords.begin() + kbegin,
+                                              coords.begin() + run_end[kbegin])) {
+                        advanced = true;
+                        break;
                     }
+                    k = kbegin - 1;
                 }
-                atoms_old = atoms_now;
-                coord_list.clear();
-                fc_list.clear();
-                coord_list.push_back(coords_now);
-                fc_list.push_back(param_in[it.mother + ishift] * it.sign);
-                icount = 1;
+                if (!advanced) break;
             }
         }
 
-        if (icount > 0) {
-            for (auto ixyz = 0; ixyz < nxyz; ++ixyz) {
-
-                auto fcs_cart = 0.0;
-
-                for (j = 0; j < icount; ++j) {
-                    prod_matrix = 1.0;
-                    for (auto k = 0; k < nelems; ++k) {
-                        prod_matrix *= basis_conversion_matrix(coord_list[j][k],
-                                                               xyzcomponent[ixyz][k]);
+        // Distinct permutations of the atoms in the tail.
+        // perm[k] is the position in the canonical tuple of atoms_perm[k].
+        atoms_perm = atoms;
+        do {
+            for (k = 0; k < nelems; ++k) is_used[k] = false;
+            for (k = 0; k < nelems; ++k) {
+                for (j = 0; j < nelems; ++j) {
+                    if (!is_used[j] && atoms[j] == atoms_perm[k]) {
+                        perm[k] = j;
+                        is_used[j] = true;
+                        break;
                     }
-                    fcs_cart += prod_matrix * fc_list[j];
-                }
-
-                if (std::abs(fcs_cart) > eps12) {
-                    fc_cart[i].emplace_back(nelems,
-                                            fcs_cart,
-                                            &atoms_old[0],
-                                            xyzcomponent[ixyz]);
                 }
             }
+            key_atoms[igroup].insert(key_atoms[igroup].end(), atoms_perm.begin(), atoms_perm.end());
+            key_perm[igroup].insert(key_perm[igroup].end(), perm.begin(), perm.end());
+        } while (std::next_permutation(atoms_perm.begin() + 1, atoms_perm.end()));
+    }
+
+    // Sort the atom tuples. The groups are already sorted, so that the
+    // tuples sharing the first atom are contiguous and sorted separately.
+
+    std::vector<std::pair<size_t, size_t>> keys; // (group, index in the group)
+    std::vector<size_t> first_atom_begin;
+    for (size_t igroup = 0; igroup < ngroups; ++igroup) {
+        const auto atom_first = key_atoms[igroup][0];
+        if (igroup == 0 || atom_first != key_atoms[igroup - 1][0]) {
+            first_atom_begin.push_back(keys.size());
         }
+        const auto nkeys_group = key_atoms[igroup].size() / nelems;
+        for (size_t ikey = 0; ikey < nkeys_group; ++ikey) keys.emplace_back(igroup, ikey);
+    }
+    first_atom_begin.push_back(keys.size());
 
-        ishift += nequiv[i].size();
+    const auto compare_keys = [&key_atoms, nelems](const std::pair<size_t, size_t> &a,
+                                                   const std::pair<size_t, size_t> &b)
+    {
+        const auto arr_a = &key_atoms[a.first][a.second * nelems];
+        const auto arr_b = &key_atoms[b.first][b.second * nelems];
+        return std::lexicographical_compare(arr_a, arr_a + nelems, arr_b, arr_b + nelems);
+    };
 
-        deallocate(xyzcomponent);
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif
+    for (long ib = 0; ib < static_cast<long>(first_atom_begin.size()) - 1; ++ib) {
+        std::sort(keys.begin() + first_atom_begin[ib],
+                  keys.begin() + first_atom_begin[ib + 1],
+                  compare_keys);
+    }
+
+    for (const auto &key : keys) {
+        const auto atoms_now = &key_atoms[key.first][key.second * nelems];
+        const auto perm_now = &key_perm[key.first][key.second * nelems];
+        const auto fc_in = &fc_group[key.first * nxyz];
+
+        for (auto ixyz = 0; ixyz < nxyz; ++ixyz) {
+            auto code = 0;
+            for (k = 0; k < nelems; ++k) code += xyzcomponent[ixyz][k] * pow3[perm_now[k]];
+            const auto fcs_cart = fc_in[index_of_code[code]];
+
+            if (std::abs(fcs_cart) > eps12) {
+                fc_cart[i].push_back(fcs_cart,
+                                     atoms_now,
+                                     xyzcomponent[ixyz]);
+            }
+        }
+    }
+
+    deallocate(xyzcomponent);
 
-        nfc_cart_permu[i] = fc_cart[i].size();
-        nfc_cart_nopermu[i] = std::count_if(fc_cart[i].begin(),
-                                            fc_cart[i].end(),
-                                            [](const ForceConstantTable &obj){return obj.is_ascending_order;});
+    nfc_cart_permu[i] = fc_cart[i].size();
+    nfc_cart_nopermu[i] = 0;
+    for (size_t ifc = 0; ifc < fc_cart[i].size(); ++ifc) {
+        if (fc_cart[i].is_ascending_order(ifc)) ++nfc_cart_nopermu[i];
     }
+
 }
 
 std::vector<size_t> Fcs::get_nfc_cart(const int permutation) const
 {
+    // All orders of fc_cart are made here.
+    for (auto i = 0; i < maxorder_cart; ++i) get_fc_cart_table(i);
+
     if (permutation) {
         return nfc_cart_permu;
     } else {
@@ -918,67 +1247,16 @@ std::vector<size_t> Fcs::get_nfc_cart(const int permutation) const
     }
 }
 
-void Fcs::get_available_symmop(const size_t nat,
-                               const Symmetry *symmetry,
-                               const std::string basis,
-                               int &nsym_avail,
-                               int **mapping_symm,
-                               double ***rotation,
-                               const bool use_compatible) const
+size_t Fcs::get_nfc_cart(const int order,
+                         const int permutation) const
 {
-    // Return mapping information of atoms and the rotation matrices of symmetry operations
-    // that are (compatible, incompatible) with the given lattice basis (Cartesian or Lattice).
-
-    // use_compatible == true returns the compatible space group (for creating fc_table)
-    // use_compatible == false returnes the incompatible supace group (for creating constraint)
-
-    int i, j;
-    int counter = 0;
-
-    nsym_avail = 0;
-
-    if (basis == "Cartesian") {
-
-        for (auto it = symmetry->get_SymmData().begin(); it != symmetry->get_SymmData().end(); ++it) {
-
-            if ((*it).compatible_with_cartesian == use_compatible) {
-
-                for (i = 0; i < 3; ++i) {
-                    for (j = 0; j < 3; ++j) {
-                        rotation[nsym_avail][i][j] = (*it).rotation_cart[i][j];
-                    }
-                }
-                for (i = 0; i < nat; ++i) {
-                    mapping_symm[i][nsym_avail] = symmetry->get_map_sym()[i][counter];
-                }
-                ++nsym_avail;
-            }
-            ++counter;
-        }
-
-    } else if (basis == "Lattice") {
-
-        for (auto it = symmetry->get_SymmData().begin(); it != symmetry->get_SymmData().end(); ++it) {
-            if ((*it).compatible_with_lattice == use_compatible) {
-                for (i = 0; i < 3; ++i) {
-                    for (j = 0; j < 3; ++j) {
-                        rotation[nsym_avail][i][j]
-                            = static_cast<double>((*it).rotation[i][j]);
-                    }
-                }
-                for (i = 0; i < nat; ++i) {
-                    mapping_symm[i][nsym_avail] = symmetry->get_map_sym()[i][counter];
-                }
-                ++nsym_avail;
-            }
-            ++counter;
-        }
-
+    // Only fc_cart of the given order is made here.
+    if (!get_fc_cart_table(order)) return 0;
 
+    if (permutation) {
+        return nfc_cart_permu[order];
     } else {
-        deallocate(rotation);
-        deallocate(mapping_symm);
-        exit("get_available_symmop", "Invalid basis input");
+        return nfc_cart_nopermu[order];
     }
 }
 
@@ -1086,14 +1364,14 @@ void Fcs::get_xyzcomponent(const int n,
     } while (boost::next_partial_permutation(v.begin(), v.begin() + n, v.end()));
 }
 
-bool Fcs::is_allzero(const std::vector<double> &vec,
+bool Fcs::is_allzero(const std::vector<ConstraintDoubleElement> &vec,
                      const double tol,
                      int &loc) const
 {
     loc = -1;
     const auto n = vec.size();
     for (auto i = 0; i < n; ++i) {
-        if (std::abs(vec[i]) > tol) {
+        if (std::abs(vec[i].val) > tol) {
             loc = i;
             return false;
         }
@@ -1101,12 +1379,12 @@ bool Fcs::is_allzero(const std::vector<double> &vec,
     return true;
 }
 
-bool Fcs::is_allzero(const std::vector<int> &vec,
+bool Fcs::is_allzero(const std::vector<ConstraintIntegerElement> &vec,
                      int &loc) const
 {
     loc = -1;
     for (auto i = 0; i < vec.size(); ++i) {
-        if (std::abs(vec[i]) > 0) {
+        if (std::abs(vec[i].val) > 0) {
             loc = i;
             return false;
         }
@@ -1114,6 +1392,24 @@ bool Fcs::is_allzero(const std::vector<int> &vec,
     return true;
 }
 
+template <typename T>
+void Fcs::reduce_sparse_row(std::vector<T> &vec) const
+{
+    // Sort the elements by column and sum up those of the same column.
+    // The stable sort keeps the order of the summation unchanged.
+    std::stable_sort(vec.begin(), vec.end());
+
+    size_t n = 0;
+    for (size_t i = 0; i < vec.size(); ++i) {
+        if (n > 0 && vec[n - 1].col == vec[i].col) {
+            vec[n - 1].val += vec[i].val;
+        } else {
+            vec[n++] = vec[i];
+        }
+    }
+    vec.erase(vec.begin() + n, vec.end());
+}
+
 Eigen::Matrix3d Fcs::get_basis_conversion_matrix() const
 {
     return basis_conversion_matrix;
@@ -1144,3 +1440,292 @@ void Fcs::set_basis_conversion_matrix(const Cell &supercell)
         }
     }
 }
+
+void FcPropertyIndex::init(const int nelems_in,
+                           const size_t nreserve)
+{
+    nelems = nelems_in;
+    nwords = FcPropertyKey::get_nwords(nelems);
+    if (nwords > FcPropertyKey::max_words) {
+        exit("FcPropertyIndex::init", "Too many indices for the packed key");
+    }
+    nentries = 0;
+    entries.clear();
+    entries.reserve(nreserve);
+    keys.clear();
+    slots.clear();
+    size_t capacity = 16;
+    while (capacity < 2 * nreserve) capacity <<= 1;
+    rehash(capacity);
+}
+
+bool FcPropertyIndex::insert(const int *arr,
+                             const double sign,
+                             const size_t mother)
+{
+    // Returns false if the key already exists.
+    uint64_t key[FcPropertyKey::max_words];
+    check_range(arr);
+    FcPropertyKey::pack(nelems, arr, key);
+
+    if (2 * (nentries + 1) > slots.size()) rehash(2 * slots.size());
+
+    auto pos = probe(key);
+    if (slots[pos] != empty) return false;
+    for (auto i = 0; i < nwords; ++i) keys[pos * nwords + i] = key[i];
+    slots[pos] = entries.size();
+    Entry e;
+    e.sign = sign;
+    e.mother = mother;
+    entries.push_back(e);
+    ++nentries;
+    return true;
+}
+
+void FcPropertyIndex::check_range(const int *arr) const
+{
+    for (auto i = 0; i < nelems; ++i) {
+        if (!FcPropertyKey::is_packable(arr[i])) {
+            exit("FcPropertyIndex::insert", "Index out of range for the packed key: ", arr[i]);
+        }
+    }
+}
+
+void FcPropertyIndex::rehash(const size_t capacity)
+{
+    std::vector<uint64_t> keys_old(std::move(keys));
+    std::vector<size_t> slots_old(std::move(slots));
+
+    keys.assign(capacity * nwords, 0);
+    slots.assign(capacity, static_cast<size_t>(empty));
+    mask = capacity - 1;
+
+    for (size_t j = 0; j < slots_old.size(); ++j) {
+        if (slots_old[j] == empty) continue;
+        const auto pos = probe(keys_old.data() + j * nwords);
+        for (auto i = 0; i < nwords; ++i) keys[pos * nwords + i] = keys_old[j * nwords + i];
+        slots[pos] = slots_old[j];
+    }
+}
+
+CoefSymTable::CoefSymTable(const int nelems_in,
+                           const int nxyz_in,
+                           int **xyzcomponent_in)
+{
+    if (nelems_in > max_nelems) {
+        exit("CoefSymTable", "Too many indices for the tensor product: ", nelems_in);
+    }
+    nelems = nelems_in;
+    nxyz = nxyz_in;
+    index_of_code.resize(nxyz);
+
+    for (auto ixyz = 0; ixyz < nxyz; ++ixyz) {
+        auto code = 0;
+        for (auto i = nelems - 1; i >= 0; --i) code = 3 * code + xyzcomponent_in[ixyz][i];
+        index_of_code[code] = ixyz;
+    }
+}
+
+void CoefSymTable::get_nonzero(const double *rot,
+                               const int *xyz1,
+                               std::vector<std::pair<int, double>> &coef_out) const
+{
+    // Mode-by-mode expansion of the Kronecker product of the columns
+    // rot[.][xyz1[i]]. rot is a 3x3 matrix in row-major order.
+    // The partial products are accumulated in the same order as in
+    // Fcs::coef_sym.
+
+    int i;
+    int nnz[max_nelems];
+    int row[max_nelems][3];
+    int pos[max_nelems];
+    double prod[max_nelems + 1];
+
+    coef_out.clear();
+
+    for (i = 0; i < nelems; ++i) {
+        nnz[i] = 0;
+        for (auto j = 0; j < 3; ++j) {
+            if (rot[3 * j + xyz1[i]] != 0.0) row[i][nnz[i]++] = j;
+        }
+        if (nnz[i] == 0) return;
+        pos[i] = 0;
+    }
+
+    prod[0] = 1.0;
+    for (i = 0; i < nelems; ++i) prod[i + 1] = prod[i] * rot[3 * row[i][0] + xyz1[i]];
+
+    auto is_sorted = true;
+
+    while (true) {
+        auto code = 0;
+        for (i = nelems - 1; i >= 0; --i) code = 3 * code + row[i][pos[i]];
+        const auto ixyz = index_of_code[code];
+        if (!coef_out.empty() && ixyz < coef_out.back().first) is_sorted = false;
+        coef_out.emplace_back(ixyz, prod[nelems]);
+
+        // Advance the odometer from the last mode.
+        for (i = nelems - 1; i >= 0; --i) {
+            if (++pos[i] < nnz[i]) break;
+            pos[i] = 0;
+        }
+        if (i < 0) break;
+        for (auto k = i; k < nelems; ++k) prod[k + 1] = prod[k] * rot[3 * row[k][pos[k]] + xyz1[k]];
+    }
+
+    if (!is_sorted) std::sort(coef_out.begin(), coef_out.end());
+}
+
+ClusterOrbitTable::ClusterOrbitTable()
+{
+    nelems = 0;
+    op_offset.resize(1, 0);
+}
+
+ClusterOrbitTable::ClusterOrbitTable(const ClusterTable &clusters,
+                                     const int nelems_in,
+                                     const SymmetryOperationSubset &symmop,
+                                     const size_t natmin,
+                                     const std::vector<std::vector<int>> &map_p2s,
+                                     const bool representative_only)
+{
+    nelems = nelems_in;
+
+    const auto ncluster = clusters.size();
+    std::vector<char> is_atom_inprim(symmop.nat, 0);
+    for (size_t i = 0; i < natmin; ++i) is_atom_inprim[map_p2s[i][0]] = 1;
+
+    // The clusters are sorted lists of atoms.
+    cluster_index.init(nelems, ncluster);
+    for (size_t icluster = 0; icluster < ncluster; ++icluster) {
+        cluster_index.insert(clusters[icluster], 1.0, icluster);
+    }
+
+    representative.resize(ncluster);
+    stabilizer.resize(ncluster);
+    op_offset.resize(ncluster + 1);
+    op_offset[0] = 0;
+
+    std::vector<int> atoms_sorted(nelems);
+    std::vector<size_t> op_now, stabilizer_now;
+
+    for (size_t icluster = 0; icluster < ncluster; ++icluster) {
+        const auto atoms_now = clusters[icluster];
+        representative[icluster] = icluster;
+        op_now.clear();
+        stabilizer_now.clear();
+
+        for (size_t isym = 0; isym < symmop.nsym; ++isym) {
+            const auto map_sym = symmop.get_map_sym(isym);
+            auto inprim = false;
+            for (auto i = 0; i < nelems; ++i) {
+                atoms_sorted[i] = map_sym[atoms_now[i]];
+                inprim = inprim || is_atom_inprim[atoms_sorted[i]];
+            }
+            if (!inprim) continue;
+
+            op_now.push_back(isym);
+
+            std::sort(atoms_sorted.begin(), atoms_sorted.end());
+            const auto iter_found = cluster_index.find(&atoms_sorted[0]);
+            if (iter_found == FcPropertyIndex::npos) continue;
+
+            const auto icluster_found = cluster_index.get_mother(iter_found);
+            if (icluster_found == icluster) {
+                stabilizer_now.push_back(op_now.size() - 1);
+            } else if (icluster_found < representative[icluster]) {
+                representative[icluster] = icluster_found;
+            }
+        }
+
+        if (!representative_only || representative[icluster] == icluster) {
+            op_index.insert(op_index.end(), op_now.begin(), op_now.end());
+            stabilizer[icluster] = stabilizer_now;
+        }
+        op_offset[icluster + 1] = op_index.size();
+    }
+}
+
+std::vector<FcProperty> FcPropertyTable::to_vector() const
+{
+    std::vector<FcProperty> fc_out;
+    fc_out.reserve(size());
+    for (size_t i = 0; i < size(); ++i) fc_out.emplace_back(get(i));
+    return fc_out;
+}
+
+void FcPropertyTable::sort_index_by_atoms(std::vector<size_t> &index_out) const
+{
+    // The entries are first distributed by the first atom (counting sort),
+    // and each bucket is sorted in parallel. Ties are kept in the original
+    // order, so that the result does not depend on the number of threads.
+
+    const auto n = nelems;
+    const auto arr = elems.data();
+    const auto nentries = size();
+
+    index_out.resize(nentries);
+    if (nentries == 0) return;
+
+    auto max_atom = 0;
+    for (size_t i = 0; i < nentries; ++i) max_atom = std::max(max_atom, arr[i * n] / 3);
+
+    std::vector<size_t> bucket_begin(max_atom + 2, 0);
+    for (size_t i = 0; i < nentries; ++i) ++bucket_begin[arr[i * n] / 3 + 1];
+    for (auto ib = 0; ib <= max_atom; ++ib) bucket_begin[ib + 1] += bucket_begin[ib];
+
+    std::vector<size_t> pos(bucket_begin.begin(), bucket_begin.end() - 1);
+    for (size_t i = 0; i < nentries; ++i) index_out[pos[arr[i * n] / 3]++] = i;
+
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif
+    for (int ib = 0; ib <= max_atom; ++ib) {
+        std::sort(index_out.begin() + bucket_begin[ib],
+                  index_out.begin() + bucket_begin[ib + 1],
+                  [n, arr](const size_t a, const size_t b)
+                  {
+                      const auto arr_a = arr + a * n;
+                      const auto arr_b = arr + b * n;
+                      for (auto k = 1; k < n; ++k) {
+                          if (arr_a[k] / 3 < arr_b[k] / 3) return true;
+                          if (arr_b[k] / 3 < arr_a[k] / 3) return false;
+                      }
+                      return a < b;
+                  });
+    }
+}
+
+ForceConstantTable FcCartesianTable::get(const size_t i) const
+{
+    std::vector<int> atoms(nelems), coords(nelems);
+    for (auto k = 0; k < nelems; ++k) {
+        atoms[k] = get_atom(i, k);
+        coords[k] = get_coord(i, k);
+    }
+    return ForceConstantTable(nelems, fc_value[i], &atoms[0], &coords[0]);
+}
+
+std::vector<ForceConstantTable> FcCartesianTable::to_vector() const
+{
+    std::vector<ForceConstantTable> fc_out;
+    fc_out.reserve(size());
+    for (size_t i = 0; i < size(); ++i) fc_out.emplace_back(get(i));
+    return fc_out;
+}
+
+void FcCartesianTable::sort_index(std::vector<size_t> &index_out) const
+{
+    index_out.resize(size());
+    for (size_t i = 0; i < size(); ++i) index_out[i] = i;
+
+    const auto n = nelems;
+    const auto arr = flattenarray.data();
+
+    std::sort(index_out.begin(), index_out.end(),
+              [n, arr](const size_t a, const size_t b)
+              {
+                  return std::lexicographical_compare(arr + a * n, arr + (a + 1) * n,
+                                                      arr + b * n, arr + (b + 1) * n);
+              });
+}
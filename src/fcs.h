@@ -16,6 +16,8 @@
 #include <map>
 #include <unordered_map>
 #include <algorithm>
+#include <cstdint>
+#include <mutex>
 #include "cluster.h"
 #include "symmetry.h"
 #include "timer.h"
@@ -31,6 +33,10 @@ using ConstraintSparseForm = std::vector<MapConstraintElement>;
 
 namespace ALM_NS
 {
+    class SetupCache;
+    class ConstraintDoubleElement;
+    class ConstraintIntegerElement;
+
     class FcProperty
     {
     public:
@@ -90,6 +96,331 @@ namespace ALM_NS
         }
     };
 
+    class FcPropertyKey
+    {
+        // Fixed-width key made by packing (order + 2) flattened indices.
+        // Three 21-bit indices are packed into each 64-bit word, so that
+        // up to 6 indices (quartic IFCs) fit in 128 bits.
+    public:
+        static const int bits_per_index = 21;
+        static const int index_per_word = 3;
+        static const int max_words = 8;
+
+        static int get_nwords(const int nelems)
+        {
+            return (nelems + index_per_word - 1) / index_per_word;
+        }
+
+        // Indices outside [0, 2^21) would overlap the neighboring fields.
+        static bool is_packable(const int index)
+        {
+            return index >= 0 && index < (1 << bits_per_index);
+        }
+
+        static void pack(const int nelems,
+                         const int *arr,
+                         uint64_t *key)
+        {
+            const auto nwords = get_nwords(nelems);
+            for (auto i = 0; i < nwords; ++i) key[i] = 0;
+            for (auto i = 0; i < nelems; ++i) {
+                key[i / index_per_word] |= static_cast<uint64_t>(arr[i])
+                    << (bits_per_index * (i % index_per_word));
+            }
+        }
+
+        static uint64_t hash(const int nwords,
+                             const uint64_t *key)
+        {
+            uint64_t seed = 0;
+            for (auto i = 0; i < nwords; ++i) {
+                auto x = key[i] + 0x9e3779b97f4a7c15ULL + (seed << 6) + (seed >> 2);
+                x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+                x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+                seed ^= x ^ (x >> 31);
+            }
+            return seed;
+        }
+    };
+
+    class FcPropertyTable
+    {
+        // Structure-of-arrays form of std::vector<FcProperty> for one order.
+        // The (order + 2) indices of each entry are stored contiguously.
+    public:
+        FcPropertyTable()
+        {
+            nelems = 0;
+        }
+
+        explicit FcPropertyTable(const int nelems_in)
+        {
+            nelems = nelems_in;
+        }
+
+        int get_nelems() const
+        {
+            return nelems;
+        }
+
+        size_t size() const
+        {
+            return mother.size();
+        }
+
+        void clear()
+        {
+            elems.clear();
+            sign.clear();
+            mother.clear();
+        }
+
+        void reserve(const size_t n)
+        {
+            elems.reserve(n * nelems);
+            sign.reserve(n);
+            mother.reserve(n);
+        }
+
+        void push_back(const int *arr,
+                       const double c,
+                       const size_t m)
+        {
+            elems.insert(elems.end(), arr, arr + nelems);
+            sign.push_back(c);
+            mother.push_back(m);
+        }
+
+        const int* get_elems(const size_t i) const
+        {
+            return &elems[i * nelems];
+        }
+
+        double get_sign(const size_t i) const
+        {
+            return sign[i];
+        }
+
+        size_t get_mother(const size_t i) const
+        {
+            return mother[i];
+        }
+
+        FcProperty get(const size_t i) const
+        {
+            return FcProperty(nelems, sign[i], get_elems(i), mother[i]);
+        }
+
+        std::vector<FcProperty> to_vector() const;
+
+        // Indices of the entries sorted as FcProperty::compare_atom_index.
+        // Entries with the same atoms keep their original order.
+        void sort_index_by_atoms(std::vector<size_t> &index_out) const;
+
+    private:
+        int nelems;
+        std::vector<int> elems;     // [size][nelems]
+        std::vector<double> sign;   // [size]
+        std::vector<size_t> mother; // [size]
+    };
+
+    class FcPropertyIndex
+    {
+        // Open-addressing hash table (linear probing) from the packed
+        // FcPropertyKey to (sign, mother). Lookups do not allocate.
+        // find() returns the index of the entry, which stays valid
+        // when other entries are inserted.
+    public:
+        FcPropertyIndex()
+        {
+            init(0, 0);
+        }
+
+        explicit FcPropertyIndex(const int nelems_in)
+        {
+            init(nelems_in, 0);
+        }
+
+        FcPropertyIndex(const int nelems_in,
+                        const FcPropertyTable &fc_table_in)
+        {
+            init(nelems_in, fc_table_in.size());
+            for (size_t i = 0; i < fc_table_in.size(); ++i) {
+                insert(fc_table_in.get_elems(i), fc_table_in.get_sign(i), fc_table_in.get_mother(i));
+            }
+        }
+
+        void init(const int nelems_in,
+                  const size_t nreserve);
+
+        size_t size() const
+        {
+            return nentries;
+        }
+
+        // Returns false if the key already exists.
+        bool insert(const int *arr,
+                    const double sign,
+                    const size_t mother);
+
+        // Returns npos if the key is not found.
+        size_t find(const int *arr) const
+        {
+            uint64_t key[FcPropertyKey::max_words];
+            for (auto i = 0; i < nelems; ++i) {
+                if (!FcPropertyKey::is_packable(arr[i])) return npos;
+            }
+            FcPropertyKey::pack(nelems, arr, key);
+            const auto pos = probe(key);
+            return slots[pos];
+        }
+
+        double get_sign(const size_t ientry) const
+        {
+            return entries[ientry].sign;
+        }
+
+        size_t get_mother(const size_t ientry) const
+        {
+            return entries[ientry].mother;
+        }
+
+        static const size_t npos = static_cast<size_t>(-1);
+
+    private:
+        class Entry
+        {
+        public:
+            double sign;
+            size_t mother;
+        };
+
+        static const size_t empty = npos;
+
+        int nelems, nwords;
+        size_t nentries, mask;
+        std::vector<uint64_t> keys;  // [capacity * nwords]
+        std::vector<size_t> slots;   // [capacity], index of entries or empty
+        std::vector<Entry> entries;
+
+        void check_range(const int *arr) const;
+
+        size_t probe(const uint64_t *key) const
+        {
+            auto pos = static_cast<size_t>(FcPropertyKey::hash(nwords, key)) & mask;
+            while (slots[pos] != empty) {
+                auto match = true;
+                for (auto i = 0; i < nwords; ++i) {
+                    if (keys[pos * nwords + i] != key[i]) {
+                        match = false;
+                        break;
+                    }
+                }
+                if (match) break;
+                pos = (pos + 1) & mask;
+            }
+            return pos;
+        }
+
+        void rehash(const size_t capacity);
+    };
+
+    class CoefSymTable
+    {
+        // Nonzero elements of a rotation acting on a rank-n Cartesian tensor,
+        // coef_sym = prod_i rot[xyz2[i]][xyz1[i]]. They are enumerated as the
+        // tensor product of the nonzero entries in the columns xyz1[i] of rot,
+        // so that zero entries are never visited. For a signed permutation
+        // matrix, there is only one nonzero element.
+    public:
+        CoefSymTable(const int nelems_in,
+                     const int nxyz_in,
+                     int **xyzcomponent_in);
+
+        // Returns the pairs (index of xyzcomponent, coefficient) in ascending
+        // order of the index. The coefficients are bitwise identical to
+        // those of Fcs::coef_sym.
+        void get_nonzero(const double *rot,
+                         const int *xyz1,
+                         std::vector<std::pair<int, double>> &coef_out) const;
+
+    private:
+        static const int max_nelems = 16;
+        int nelems, nxyz;
+        std::vector<int> index_of_code; // base-3 code of xyz2 -> index of xyzcomponent
+    };
+
+    class ClusterOrbitTable
+    {
+        // Action of the symmetry operations on the atom clusters of one order.
+        // The representative of a cluster is the first cluster (in the order
+        // of the table) among its images. For the representatives only, the
+        // operations that map the cluster to a cluster having an atom in the
+        // primitive cell are stored, and the stabilizer is the subset of them
+        // that map the cluster onto itself. The mapped atoms are obtained
+        // from Symmetry::map_sym when needed.
+        // The table is built once for each order in Fcs::init, because the
+        // clusters of different orders are different. The table of the
+        // compatible operations is used in Fcs::generate_force_constant_table.
+        // The table of the incompatible operations, with the operations of
+        // all the clusters stored, is used for the symmetry constraints.
+    public:
+        ClusterOrbitTable();
+        ClusterOrbitTable(const ClusterTable &clusters,
+                          const int nelems_in,
+                          const SymmetryOperationSubset &symmop,
+                          const size_t natmin,
+                          const std::vector<std::vector<int>> &map_p2s,
+                          const bool representative_only = true);
+
+        size_t size() const
+        {
+            return representative.size();
+        }
+
+        size_t get_representative(const size_t icluster) const
+        {
+            return representative[icluster];
+        }
+
+        // Returns the index of the cluster of the sorted atoms,
+        // or FcPropertyIndex::npos if it is not in the table.
+        size_t find(const int *atoms_sorted) const
+        {
+            const auto iter_found = cluster_index.find(atoms_sorted);
+            if (iter_found == FcPropertyIndex::npos) return iter_found;
+            return cluster_index.get_mother(iter_found);
+        }
+
+        // The operations are in ascending order of the symmetry index.
+        // There are no operations for a cluster that is not a representative
+        // unless the table is made with representative_only = false.
+        size_t get_number_of_operations(const size_t icluster) const
+        {
+            return op_offset[icluster + 1] - op_offset[icluster];
+        }
+
+        size_t get_operation(const size_t icluster,
+                             const size_t iop) const
+        {
+            return op_index[op_offset[icluster] + iop];
+        }
+
+        // Indices iop of get_operation that belong to the stabilizer.
+        const std::vector<size_t>& get_stabilizer(const size_t icluster) const
+        {
+            return stabilizer[icluster];
+        }
+
+    private:
+        int nelems;
+        FcPropertyIndex cluster_index; // sorted atoms -> index of cluster
+        std::vector<size_t> representative;
+        std::vector<size_t> op_offset; // [ncluster + 1]
+        std::vector<size_t> op_index;
+        std::vector<std::vector<size_t>> stabilizer;
+    };
+
     class ForceConstantTable
     {
     public:
@@ -131,6 +462,92 @@ namespace ALM_NS
         }
     };
 
+    class FcCartesianTable
+    {
+        // Structure-of-arrays form of std::vector<ForceConstantTable> for one order.
+        // Only the flattened indices are stored; atoms and coords are derived from them.
+    public:
+        FcCartesianTable()
+        {
+            nelems = 0;
+        }
+
+        explicit FcCartesianTable(const int nelems_in)
+        {
+            nelems = nelems_in;
+        }
+
+        int get_nelems() const
+        {
+            return nelems;
+        }
+
+        size_t size() const
+        {
+            return fc_value.size();
+        }
+
+        void clear()
+        {
+            flattenarray.clear();
+            fc_value.clear();
+        }
+
+        void push_back(const double fc_in,
+                       const int *atoms_in,
+                       const int *coords_in)
+        {
+            for (auto i = 0; i < nelems; ++i) {
+                flattenarray.push_back(3 * atoms_in[i] + coords_in[i]);
+            }
+            fc_value.push_back(fc_in);
+        }
+
+        double get_fc_value(const size_t i) const
+        {
+            return fc_value[i];
+        }
+
+        const int* get_flattenarray(const size_t i) const
+        {
+            return &flattenarray[i * nelems];
+        }
+
+        int get_atom(const size_t i,
+                     const int k) const
+        {
+            return flattenarray[i * nelems + k] / 3;
+        }
+
+        int get_coord(const size_t i,
+                      const int k) const
+        {
+            return flattenarray[i * nelems + k] % 3;
+        }
+
+        // true if the elements except the first element is sorted in ascending order.
+        bool is_ascending_order(const size_t i) const
+        {
+            const auto arr = get_flattenarray(i);
+            for (auto k = 1; k < nelems - 1; ++k) {
+                if (arr[k] > arr[k + 1]) return false;
+            }
+            return true;
+        }
+
+        ForceConstantTable get(const size_t i) const;
+
+        std::vector<ForceConstantTable> to_vector() const;
+
+        // Indices of the entries sorted as ForceConstantTable::operator<.
+        void sort_index(std::vector<size_t> &index_out) const;
+
+    private:
+        int nelems;
+        std::vector<int> flattenarray; // [size][nelems]
+        std::vector<double> fc_value;  // [size]
+    };
+
     class Fcs
     {
     public:
@@ -141,25 +558,38 @@ namespace ALM_NS
                   const Symmetry *symmetry,
                   const Cell &supercell,
                   const int verbosity,
-                  Timer *timer);
+                  Timer *timer,
+                  const SetupCache *setup_cache = nullptr);
 
         void get_xyzcomponent(int,
                               int **) const;
+        // Tables of the cluster orbits of each order for the operations
+        // compatible (orbit_out) and incompatible (orbit_constraint_out)
+        // with the basis.
+        void make_cluster_orbit_table(const int maxorder,
+                                      const Cluster *cluster,
+                                      const Symmetry *symmetry,
+                                      const std::string basis,
+                                      ClusterOrbitTable *orbit_out,
+                                      ClusterOrbitTable *orbit_constraint_out) const;
+
         void generate_force_constant_table(const int,
                                            const size_t nat,
-                                           const std::set<IntList> &,
+                                           const ClusterTable &,
+                                           const ClusterOrbitTable &,
                                            const Symmetry *,
                                            const std::string,
-                                           std::vector<FcProperty> &,
+                                           FcPropertyTable &,
                                            std::vector<size_t> &,
-                                           std::vector<FcProperty> &,
+                                           FcPropertyTable &,
                                            const bool) const;
 
         void get_constraint_symmetry(const size_t nat,
                                      const Symmetry *symmetry,
                                      const int order,
                                      const std::string basis,
-                                     const std::vector<FcProperty> &fc_table_in,
+                                     const FcPropertyTable &fc_table_in,
+                                     const ClusterOrbitTable &cluster_orbit,
                                      const size_t nparams,
                                      const double tolerance,
                                      ConstraintSparseForm &const_out,
@@ -169,16 +599,33 @@ namespace ALM_NS
                                                 const Symmetry *symmetry,
                                                 const int order,
                                                 const std::string basis,
-                                                const std::vector<FcProperty> &fc_table_in,
+                                                const FcPropertyTable &fc_table_in,
+                                                const ClusterOrbitTable &cluster_orbit,
                                                 const size_t nparams,
                                                 const double tolerance,
                                                 ConstraintSparseForm &const_out,
                                                 const bool do_rref = false) const;
 
         std::vector<size_t>* get_nequiv() const;
+        // Cluster orbits of each order for the operations compatible
+        // (or incompatible) with the preferred basis.
+        const ClusterOrbitTable* get_cluster_orbit_table(const bool compatible) const;
+        // All force constants in the preferred basis, one table per order.
+        const FcPropertyTable* get_fc_property_table() const;
+        // Same as get_fc_property_table in the form of FcProperty.
+        // Kept for compatibility; the copy is made on the first call.
         std::vector<FcProperty>* get_fc_table() const;
+        // All orders of the Cartesian force constants in the form of ForceConstantTable.
+        // Kept for compatibility; every order is made on the first call.
         std::vector<ForceConstantTable>* get_fc_cart() const;
+        // Cartesian force constants of the given order (0 for harmonic).
+        // They are made on the first request after set_forceconstant_cartesian.
+        // Concurrent requests are safe; each order is made only once.
+        // Returns nullptr if the force constants are not set.
+        const FcCartesianTable* get_fc_cart_table(const int order) const;
         std::vector<size_t> get_nfc_cart(const int permutation) const;
+        size_t get_nfc_cart(const int order,
+                            const int permutation) const;
 
         void set_forceconstant_basis(const std::string preferred_basis_in);
         std::string get_forceconstant_basis() const;
@@ -189,12 +636,22 @@ namespace ALM_NS
 
     private:
         std::vector<size_t> *nequiv;       // stores duplicate number of irreducible force constants
-        std::vector<FcProperty> *fc_table; // all force constants in preferred_basis
-        std::vector<FcProperty> *fc_zeros; // zero force constants (due to space group symm.)
-
-        std::vector<ForceConstantTable> *fc_cart; // all force constants in Cartesian coordinate
-        std::vector<size_t> nfc_cart_permu; // Number of nonzero elements with permutation
-        std::vector<size_t> nfc_cart_nopermu; // Number of nonzero elements without permutation
+        FcPropertyTable *fc_table; // all force constants in preferred_basis
+        FcPropertyTable *fc_zeros; // zero force constants (due to space group symm.)
+        ClusterOrbitTable *cluster_orbit; // cluster orbits for the compatible operations
+        ClusterOrbitTable *cluster_orbit_constraint; // cluster orbits for the incompatible operations
+        int maxorder_table; // number of orders of fc_table
+        std::vector<FcProperty> *fc_table_vec; // copy of fc_table made by get_fc_table()
+        std::once_flag *fc_table_vec_once; // guards the construction of fc_table_vec
+
+        FcCartesianTable *fc_cart; // all force constants in Cartesian coordinate
+        std::once_flag *fc_cart_once; // guards the construction of fc_cart of each order
+        std::vector<ForceConstantTable> *fc_cart_vec; // copy of fc_cart made by get_fc_cart()
+        std::once_flag *fc_cart_vec_once; // guards the construction of fc_cart_vec
+        int maxorder_cart; // number of orders of fc_cart
+        mutable std::vector<size_t> nfc_cart_permu; // Number of nonzero elements with permutation
+        mutable std::vector<size_t> nfc_cart_nopermu; // Number of nonzero elements without permutation
+        std::vector<double> fc_cart_params; // parameters given to set_forceconstant_cartesian
 
         std::string preferred_basis; // "Cartesian" or "Lattice"
         Eigen::Matrix3d basis_conversion_matrix;
@@ -211,18 +668,13 @@ namespace ALM_NS
         bool is_inprim(const int n,
                        const size_t natmin,
                        const std::vector<std::vector<int>> &map_p2s) const;
-        bool is_allzero(const std::vector<double> &,
+        bool is_allzero(const std::vector<ConstraintDoubleElement> &,
                         double,
                         int &) const;
-        bool is_allzero(const std::vector<int> &,
+        bool is_allzero(const std::vector<ConstraintIntegerElement> &,
                         int &) const;
-        void get_available_symmop(const size_t nat,
-                                  const Symmetry *symmetry,
-                                  const std::string basis,
-                                  int &nsym_avail,
-                                  int **mapping_symm,
-                                  double ***rotation,
-                                  const bool use_compatible) const;
+        template <typename T>
+        void reduce_sparse_row(std::vector<T> &) const;
         int get_minimum_index_in_primitive(const int n,
                                            const int *arr,
                                            const size_t nat,
@@ -234,6 +686,11 @@ namespace ALM_NS
                         const int *) const;
 
         void set_basis_conversion_matrix(const Cell &supercell);
+        void clear_forceconstant_cartesian();
+        void make_forceconstant_cartesian(const int order) const;
+        void make_forceconstant_cartesian_vector() const;
+        void make_fc_table_vector() const;
+        void clear_fc_table_vector();
     };
 }
 
@@ -235,7 +235,8 @@ void InputParser::parse_general_vars(ALM *alm)
     const std::vector<std::string> input_list{
         "PREFIX", "MODE", "NAT", "NKD", "KD", "PERIODIC", "PRINTSYM", "TOLERANCE",
         "DBASIS", "TRIMEVEN", "VERBOSITY",
-        "MAGMOM", "NONCOLLINEAR", "TREVSYM", "HESSIAN", "TOL_CONST", "FC_BASIS"
+        "MAGMOM", "NONCOLLINEAR", "TREVSYM", "HESSIAN", "TOL_CONST", "FC_BASIS",
+        "SETUPCACHE", "SYMMCACHE"
     };
     std::vector<std::string> no_defaults{"PREFIX", "MODE", "NAT", "NKD", "KD"};
     std::map<std::string, std::string> general_var_dict;
@@ -482,7 +483,9 @@ void InputParser::parse_general_vars(ALM *alm)
                                    magmom,
                                    tolerance,
                                    tolerance_constraint,
-                                   basis_force_constant);
+                                   basis_force_constant,
+                                   general_var_dict["SETUPCACHE"],
+                                   general_var_dict["SYMMCACHE"]);
 
     allocate(magmom, nat, 3);
 
@@ -666,7 +669,7 @@ void InputParser::parse_optimize_vars(ALM *alm)
 
     const std::vector<std::string> input_list{
         "LMODEL", "SPARSE", "SPARSESOLVER",
-        "ICONST", "ROTAXIS", "FC2XML", "FC3XML",
+        "ICONST", "ROTAXIS", "FC2XML", "FC3XML", "FCXML_BIN",
         "NDATA", "NSTART", "NEND", "SKIP", "DFILE", "FFILE", "DFSET",
         "NDATA_CV", "NSTART_CV", "NEND_CV", "DFSET_CV",
         "L1_RATIO", "STANDARDIZE", "ENET_DNORM",
@@ -876,6 +879,10 @@ void InputParser::parse_optimize_vars(ALM *alm)
     auto fc3_file = optimize_var_dict["FC3XML"];
     const auto fix_harmonic = !fc2_file.empty();
     const auto fix_cubic = !fc3_file.empty();
+    auto use_fc_file_binary = false;
+    if (!optimize_var_dict["FCXML_BIN"].empty()) {
+        assign_val(use_fc_file_binary, "FCXML_BIN", optimize_var_dict);
+    }
 
     if (constraint_flag % 10 >= 2) {
         rotation_axis = optimize_var_dict["ROTAXIS"];
@@ -891,7 +898,8 @@ void InputParser::parse_optimize_vars(ALM *alm)
                                       fc2_file,
                                       fc3_file,
                                       fix_harmonic,
-                                      fix_cubic);
+                                      fix_cubic,
+                                      use_fc_file_binary);
 
     optimize_var_dict.clear();
 }
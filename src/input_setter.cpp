@@ -136,7 +136,9 @@ void InputSetter::set_general_vars(ALM *alm,
                                    const double * const *magmom_in,
                                    const double tolerance,
                                    const double tolerance_constraint,
-                                   const std::string basis_force_constant)
+                                   const std::string basis_force_constant,
+                                   const std::string setup_cache_file,
+                                   const std::string symmetry_cache_file)
 {
     size_t i;
 
@@ -176,6 +178,8 @@ void InputSetter::set_general_vars(ALM *alm,
     alm->set_print_hessian(print_hessian);
     alm->set_tolerance_constraint(tolerance_constraint);
     alm->set_forceconstant_basis(basis_force_constant);
+    alm->set_setup_cache_file(setup_cache_file);
+    alm->set_symmetry_cache_file(symmetry_cache_file);
 
     if (mode == "suggest") {
         alm->set_displacement_basis(str_disp_basis);
@@ -219,7 +223,8 @@ void InputSetter::set_constraint_vars(ALM *alm,
                                       const std::string fc2_file,
                                       const std::string fc3_file,
                                       const bool fix_harmonic,
-                                      const bool fix_cubic) const
+                                      const bool fix_cubic,
+                                      const bool use_fc_file_binary) const
 {
     alm->set_constraint_mode(constraint_flag);
     alm->set_rotation_axis(rotation_axis);
@@ -227,6 +232,7 @@ void InputSetter::set_constraint_vars(ALM *alm,
     alm->set_fc_fix(2, fix_harmonic);
     alm->set_fc_file(3, fc3_file);
     alm->set_fc_fix(3, fix_cubic);
+    alm->set_fc_file_binary(use_fc_file_binary);
 }
 
 
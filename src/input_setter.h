@@ -54,7 +54,9 @@ namespace ALM_NS
                               const double * const *magmom_in,
                               double tolerance,
                               double tolerance_constraint,
-                              const std::string basis_force_constant);
+                              const std::string basis_force_constant,
+                              const std::string setup_cache_file,
+                              const std::string symmetry_cache_file);
 
         void set_optimize_vars(ALM *alm,
                                const std::vector<std::vector<double>> &u_train_in,
@@ -73,7 +75,8 @@ namespace ALM_NS
                                  std::string fc2_file,
                                  std::string fc3_file,
                                  bool fix_harmonic,
-                                 bool fix_cubic) const;
+                                 bool fix_cubic,
+                                 bool use_fc_file_binary) const;
 
         void set_geometric_structure(ALM *alm) const;
 
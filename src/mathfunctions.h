@@ -192,21 +192,6 @@ void insort(int n, T *arr)
 
 inline void sort_tail(const int n, int *arr)
 {
-    int i, m;
-
-    m = n - 1;
-    int *ind_tmp;
-
-    ind_tmp = new int[m];
-
-    for (i = 0; i < m; ++i) {
-        ind_tmp[i] = arr[i + 1];
-    }
-
-    insort(m, ind_tmp);
-
-    for (i = 0; i < m; ++i) {
-        arr[i + 1] = ind_tmp[i];
-    }
-    delete [] ind_tmp;
+    // Sort arr[1], ..., arr[n-1] in place
+    insort(n - 1, arr + 1);
 }
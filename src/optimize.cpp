@@ -89,7 +89,7 @@ int Optimize::optimize_main(const Symmetry *symmetry,
 
     if (constraint->get_constraint_algebraic()) {
         for (auto i = 0; i < maxorder; ++i) {
-            N_new += constraint->get_index_bimap(i).size();
+            N_new += constraint->get_index_map(i).size();
         }
     }
 
@@ -374,16 +374,16 @@ int Optimize::elastic_net(const std::string job_prefix,
 
             for (auto i = 0; i < maxorder; ++i) {
                 nzero_lasso[i] = 0;
-                for (const auto &it : constraint->get_index_bimap(i)) {
-                    const auto inew = it.left + iparam;
+                for (size_t j = 0; j < constraint->get_index_map(i).size(); ++j) {
+                    const auto inew = j + iparam;
                     if (std::abs(param_tmp[inew]) < eps) ++nzero_lasso[i];
                 }
-                iparam += constraint->get_index_bimap(i).size();
+                iparam += constraint->get_index_map(i).size();
             }
 
             for (auto order = 0; order < maxorder; ++order) {
                 std::cout << "  Number of non-zero " << std::setw(9) << str_order[order] << " FCs : "
-                          << constraint->get_index_bimap(order).size() - nzero_lasso[order] << std::endl;
+                          << constraint->get_index_map(order).size() - nzero_lasso[order] << std::endl;
             }
             std::cout << std::endl;
         }
@@ -520,7 +520,7 @@ double Optimize::run_enetcv_manual(const std::string job_prefix,
     size_t N_new = 0;
     if (constraint->get_constraint_algebraic()) {
         for (auto i = 0; i < maxorder; ++i) {
-            N_new += constraint->get_index_bimap(i).size();
+            N_new += constraint->get_index_map(i).size();
         }
     }
 
@@ -603,7 +603,7 @@ double Optimize::run_enetcv_auto(const std::string job_prefix,
     size_t N_new = 0;
     if (constraint->get_constraint_algebraic()) {
         for (auto i = 0; i < maxorder; ++i) {
-            N_new += constraint->get_index_bimap(i).size();
+            N_new += constraint->get_index_map(i).size();
         }
     }
 
@@ -1277,12 +1277,11 @@ void Optimize::get_number_of_zero_coefs(const int maxorder,
     nzeros.resize(maxorder);
     for (auto i = 0; i < maxorder; ++i) {
         nzeros[i] = 0;
-        for (const auto &it : constraint->get_index_bimap(i)) {
-            const auto inew = it.left + iparam;
+        for (size_t j = 0; j < constraint->get_index_map(i).size(); ++j) {
+            const auto inew = j + iparam;
             if (std::abs(x[inew]) < eps) ++nzeros[i];
-
         }
-        iparam += constraint->get_index_bimap(i).size();
+        iparam += constraint->get_index_map(i).size();
     }
 }
 
@@ -1431,7 +1430,7 @@ void Optimize::apply_scaler_force_constants(const int maxorder,
     for (auto i = 0; i < maxorder; ++i) {
         const auto scale_factor = 1.0 / std::pow(normalization_factor, i + 1);
 
-        for (auto j = 0; j < constraint->get_index_bimap(i).size(); ++j) {
+        for (auto j = 0; j < constraint->get_index_map(i).size(); ++j) {
             param_inout[k] *= scale_factor;
             ++k;
         }
@@ -1571,7 +1570,7 @@ void Optimize::set_fcs_values(const int maxorder,
     size_t Nirred = 0;
     for (i = 0; i < maxorder; ++i) {
         N += nequiv[i].size();
-        Nirred += constraint->get_index_bimap(i).size();
+        Nirred += constraint->get_index_map(i).size();
     }
 
     std::vector<double> param_in(Nirred, 0.0);
@@ -1923,19 +1922,19 @@ void Optimize::get_matrix_elements(const int maxorder,
                               fcs->get_basis_conversion_matrix());
     }
 
+    std::vector<SensingMatrixTerms> terms;
+    set_sensing_matrix_terms(maxorder, symmetry, fcs, terms);
+
 
 #ifdef _OPENMP
 #pragma omp parallel private(irow, i, j)
 #endif
     {
-        int *ind;
-        int mm, order, iat, k;
-        size_t im, iparam;
+        int order, iat;
+        size_t im;
         size_t idata;
-        double amat_tmp;
         double **amat_orig_tmp;
 
-        allocate(ind, maxorder + 1);
         allocate(amat_orig_tmp, natmin3, ncols);
 
 #ifdef _OPENMP
@@ -1961,28 +1960,10 @@ void Optimize::get_matrix_elements(const int maxorder,
             // generate l.h.s. matrix A
 
             idata = natmin3 * irow;
-            iparam = 0;
 
             for (order = 0; order < maxorder; ++order) {
-
-                mm = 0;
-
-                for (const auto &iter : fcs->get_nequiv()[order]) {
-                    for (i = 0; i < iter; ++i) {
-                        ind[0] = fcs->get_fc_table()[order][mm].elems[0];
-                        k = inprim_index(ind[0], symmetry);
-                        amat_tmp = 1.0;
-                        for (j = 1; j < order + 2; ++j) {
-                            ind[j] = fcs->get_fc_table()[order][mm].elems[j];
-                            amat_tmp *= u_multi[irow][fcs->get_fc_table()[order][mm].elems[j]];
-                        }
-                        amat_orig_tmp[k][iparam] -= gamma(order + 2, ind) * fcs->get_fc_table()[order][mm].sign *
-                            amat_tmp;
-                        ++mm;
-                    }
-                    ++iparam;
-                }
-                }
+                terms[order].subtract_from(&u_multi[irow][0], amat_orig_tmp);
+            }
 
             // When the force constants are defined in the fractional coordinate,
             // we need to multiply the basis_conversion_matrix to obtain atomic forces
@@ -2002,7 +1983,6 @@ void Optimize::get_matrix_elements(const int maxorder,
             }
         }
 
-        deallocate(ind);
         deallocate(amat_orig_tmp);
     }
 
@@ -2038,7 +2018,7 @@ void Optimize::get_matrix_elements_algebraic_constraint(const int maxorder,
 
     for (i = 0; i < maxorder; ++i) {
         ncols += fcs->get_nequiv()[i].size();
-        ncols_new += constraint->get_index_bimap(i).size();
+        ncols_new += constraint->get_index_map(i).size();
     }
 
     const auto ncycle = ndata_fit * symmetry->get_ntran();
@@ -2061,21 +2041,21 @@ void Optimize::get_matrix_elements_algebraic_constraint(const int maxorder,
                               fcs->get_basis_conversion_matrix());
     }
 
+    std::vector<SensingMatrixTerms> terms;
+    set_sensing_matrix_terms(maxorder, symmetry, fcs, terms);
+
 #ifdef _OPENMP
 #pragma omp parallel private(irow, i, j)
 #endif
     {
-        int *ind;
-        int mm, order, iat, k;
+        int order, iat, k;
         size_t im;
         size_t idata;
         size_t ishift, iparam;
         size_t iold, inew;
-        double amat_tmp;
         double **amat_orig_tmp;
         double **amat_mod_tmp;
 
-        allocate(ind, maxorder + 1);
         allocate(amat_orig_tmp, natmin3, ncols);
         allocate(amat_mod_tmp, natmin3, ncols_new);
 
@@ -2106,28 +2086,9 @@ void Optimize::get_matrix_elements_algebraic_constraint(const int maxorder,
             // generate l.h.s. matrix A
 
             idata = natmin3 * irow;
-            iparam = 0;
 
             for (order = 0; order < maxorder; ++order) {
-
-                mm = 0;
-
-                for (const auto &iter : fcs->get_nequiv()[order]) {
-                    for (i = 0; i < iter; ++i) {
-                        ind[0] = fcs->get_fc_table()[order][mm].elems[0];
-                        k = inprim_index(ind[0], symmetry);
-
-                        amat_tmp = 1.0;
-                        for (j = 1; j < order + 2; ++j) {
-                            ind[j] = fcs->get_fc_table()[order][mm].elems[j];
-                            amat_tmp *= u_multi[irow][fcs->get_fc_table()[order][mm].elems[j]];
-                        }
-                        amat_orig_tmp[k][iparam] -= gamma(order + 2, ind)
-                            * fcs->get_fc_table()[order][mm].sign * amat_tmp;
-                        ++mm;
-                    }
-                    ++iparam;
-                }
+                terms[order].subtract_from(&u_multi[irow][0], amat_orig_tmp);
             }
 
             // When the force constants are defined in the fractional coordinate,
@@ -2156,9 +2117,11 @@ void Optimize::get_matrix_elements_algebraic_constraint(const int maxorder,
                     }
                 }
 
-                for (const auto &it : constraint->get_index_bimap(order)) {
-                    inew = it.left + iparam;
-                    iold = it.right + ishift;
+                const auto &index_map = constraint->get_index_map(order);
+
+                for (size_t ifree = 0; ifree < index_map.size(); ++ifree) {
+                    inew = ifree + iparam;
+                    iold = index_map.get_orig(ifree) + ishift;
 
                     for (j = 0; j < natmin3; ++j) {
                         amat_mod_tmp[j][inew] = amat_orig_tmp[j][iold];
@@ -2171,9 +2134,12 @@ void Optimize::get_matrix_elements_algebraic_constraint(const int maxorder,
 
                     for (j = 0; j < constraint->get_const_relate(order)[i].alpha.size(); ++j) {
 
-                        inew = constraint->get_index_bimap(order).right.at(
-                                constraint->get_const_relate(order)[i].p_index_orig[j]) +
-                            iparam;
+                        const auto ifree = index_map.get_free(constraint->get_const_relate(order)[i].p_index_orig[j]);
+                        if (ifree == ConstraintIndexMap::none) {
+                            exit("get_matrix_elements_algebraic_constraint",
+                                 "The related parameter is not a free parameter.");
+                        }
+                        inew = ifree + iparam;
 
                         for (k = 0; k < natmin3; ++k) {
                             amat_mod_tmp[k][inew] -= amat_orig_tmp[k][iold]
@@ -2183,7 +2149,7 @@ void Optimize::get_matrix_elements_algebraic_constraint(const int maxorder,
                 }
 
                 ishift += fcs->get_nequiv()[order].size();
-                iparam += constraint->get_index_bimap(order).size();
+                iparam += constraint->get_index_map(order).size();
             }
 
             for (i = 0; i < natmin3; ++i) {
@@ -2194,7 +2160,6 @@ void Optimize::get_matrix_elements_algebraic_constraint(const int maxorder,
             }
         }
 
-        deallocate(ind);
         deallocate(amat_orig_tmp);
         deallocate(amat_mod_tmp);
     }
@@ -2239,7 +2204,7 @@ void Optimize::get_matrix_elements_in_sparse_form(const int maxorder,
 
     for (i = 0; i < maxorder; ++i) {
         ncols += fcs->get_nequiv()[i].size();
-        ncols_new += constraint->get_index_bimap(i).size();
+        ncols_new += constraint->get_index_map(i).size();
     }
 
     const auto ncycle = ndata_fit * symmetry->get_ntran();
@@ -2255,23 +2220,23 @@ void Optimize::get_matrix_elements_in_sparse_form(const int maxorder,
                               fcs->get_basis_conversion_matrix());
     }
 
+    std::vector<SensingMatrixTerms> terms;
+    set_sensing_matrix_terms(maxorder, symmetry, fcs, terms);
+
 #ifdef _OPENMP
 #pragma omp parallel private(irow, i, j)
 #endif
     {
-        int *ind;
-        int mm, order, iat, k;
+        int order, iat, k;
         size_t im, iparam;
         size_t idata;
         size_t ishift;
         size_t iold, inew;
-        double amat_tmp;
         double **amat_orig_tmp;
         double **amat_mod_tmp;
 
         std::vector<T> nonzero_omp;
 
-        allocate(ind, maxorder + 1);
         allocate(amat_orig_tmp, natmin3, ncols);
         allocate(amat_mod_tmp, natmin3, ncols_new);
 
@@ -2302,28 +2267,9 @@ void Optimize::get_matrix_elements_in_sparse_form(const int maxorder,
             // generate l.h.s. matrix A
 
             idata = natmin3 * irow;
-            iparam = 0;
 
             for (order = 0; order < maxorder; ++order) {
-
-                mm = 0;
-
-                for (const auto &iter : fcs->get_nequiv()[order]) {
-                    for (i = 0; i < iter; ++i) {
-                        ind[0] = fcs->get_fc_table()[order][mm].elems[0];
-                        k = inprim_index(ind[0], symmetry);
-
-                        amat_tmp = 1.0;
-                        for (j = 1; j < order + 2; ++j) {
-                            ind[j] = fcs->get_fc_table()[order][mm].elems[j];
-                            amat_tmp *= u_multi[irow][fcs->get_fc_table()[order][mm].elems[j]];
-                        }
-                        amat_orig_tmp[k][iparam] -= gamma(order + 2, ind)
-                            * fcs->get_fc_table()[order][mm].sign * amat_tmp;
-                        ++mm;
-                    }
-                    ++iparam;
-                }
+                terms[order].subtract_from(&u_multi[irow][0], amat_orig_tmp);
             }
 
             // When the force constants are defined in the fractional coordinate,
@@ -2352,9 +2298,11 @@ void Optimize::get_matrix_elements_in_sparse_form(const int maxorder,
                     }
                 }
 
-                for (const auto &it : constraint->get_index_bimap(order)) {
-                    inew = it.left + iparam;
-                    iold = it.right + ishift;
+                const auto &index_map = constraint->get_index_map(order);
+
+                for (size_t ifree = 0; ifree < index_map.size(); ++ifree) {
+                    inew = ifree + iparam;
+                    iold = index_map.get_orig(ifree) + ishift;
 
                     for (j = 0; j < natmin3; ++j) {
                         amat_mod_tmp[j][inew] = amat_orig_tmp[j][iold];
@@ -2367,9 +2315,12 @@ void Optimize::get_matrix_elements_in_sparse_form(const int maxorder,
 
                     for (j = 0; j < constraint->get_const_relate(order)[i].alpha.size(); ++j) {
 
-                        inew = constraint->get_index_bimap(order).right.at(
-                                constraint->get_const_relate(order)[i].p_index_orig[j]) +
-                            iparam;
+                        const auto ifree = index_map.get_free(constraint->get_const_relate(order)[i].p_index_orig[j]);
+                        if (ifree == ConstraintIndexMap::none) {
+                            exit("get_matrix_elements_in_sparse_form",
+                                 "The related parameter is not a free parameter.");
+                        }
+                        inew = ifree + iparam;
 
                         for (k = 0; k < natmin3; ++k) {
                             amat_mod_tmp[k][inew] -= amat_orig_tmp[k][iold]
@@ -2379,7 +2330,7 @@ void Optimize::get_matrix_elements_in_sparse_form(const int maxorder,
                 }
 
                 ishift += fcs->get_nequiv()[order].size();
-                iparam += constraint->get_index_bimap(order).size();
+                iparam += constraint->get_index_map(order).size();
             }
 
             for (i = 0; i < natmin3; ++i) {
@@ -2391,7 +2342,6 @@ void Optimize::get_matrix_elements_in_sparse_form(const int maxorder,
             }
         }
 
-        deallocate(ind);
         deallocate(amat_orig_tmp);
         deallocate(amat_mod_tmp);
 
@@ -2440,9 +2390,11 @@ void Optimize::recover_original_forceconstants(const int maxorder,
                 = constraint->get_const_fix(i)[j].val_to_fix;
         }
 
-        for (const auto &it : constraint->get_index_bimap(i)) {
-            inew = it.left + iparam;
-            iold = it.right + ishift;
+        const auto &index_map = constraint->get_index_map(i);
+
+        for (size_t ifree = 0; ifree < index_map.size(); ++ifree) {
+            inew = ifree + iparam;
+            iold = index_map.get_orig(ifree) + ishift;
 
             param_out[iold] = param_in[inew];
         }
@@ -2458,7 +2410,7 @@ void Optimize::recover_original_forceconstants(const int maxorder,
         }
 
         ishift += nequiv[i].size();
-        iparam += constraint->get_index_bimap(i).size();
+        iparam += constraint->get_index_map(i).size();
     }
 }
 
@@ -2504,6 +2456,96 @@ int Optimize::inprim_index(const int n,
     return in;
 }
 
+void Optimize::set_sensing_matrix_terms(const int maxorder,
+                                        const Symmetry *symmetry,
+                                        const Fcs *fcs,
+                                        std::vector<SensingMatrixTerms> &terms) const
+{
+    // The coefficients gamma * sign and the rows are computed here once,
+    // so that only the products of displacements are left for each data.
+
+    int *ind;
+    size_t iparam = 0;
+
+    terms.clear();
+    terms.resize(maxorder);
+
+    allocate(ind, maxorder + 1);
+
+    for (auto order = 0; order < maxorder; ++order) {
+        const auto nelems = order + 2;
+        const auto &fc_table = fcs->get_fc_property_table()[order];
+        auto &terms_now = terms[order];
+
+        terms_now.nelems = nelems;
+        terms_now.row.reserve(fc_table.size());
+        terms_now.col.reserve(fc_table.size());
+        terms_now.coef.reserve(fc_table.size());
+        terms_now.u_index.reserve(fc_table.size() * (nelems - 1));
+
+        size_t mm = 0;
+        for (const auto &iter : fcs->get_nequiv()[order]) {
+            for (size_t i = 0; i < iter; ++i) {
+                for (auto j = 0; j < nelems; ++j) ind[j] = fc_table.get_elems(mm)[j];
+                terms_now.row.push_back(inprim_index(ind[0], symmetry));
+                terms_now.col.push_back(iparam);
+                terms_now.coef.push_back(gamma(nelems, ind) * fc_table.get_sign(mm));
+                for (auto j = 1; j < nelems; ++j) terms_now.u_index.push_back(ind[j]);
+                ++mm;
+            }
+            ++iparam;
+        }
+    }
+
+    deallocate(ind);
+}
+
+void SensingMatrixTerms::subtract_from(const double *u,
+                                       double **amat) const
+{
+    switch (nelems) {
+    case 2:
+        subtract_from_fixed<2>(u, amat);
+        break;
+    case 3:
+        subtract_from_fixed<3>(u, amat);
+        break;
+    case 4:
+        subtract_from_fixed<4>(u, amat);
+        break;
+    default:
+        subtract_from_generic(u, amat);
+        break;
+    }
+}
+
+template <int N>
+void SensingMatrixTerms::subtract_from_fixed(const double *u,
+                                             double **amat) const
+{
+    const auto nterms = row.size();
+    const auto *idx = u_index.data();
+
+    for (size_t i = 0; i < nterms; ++i, idx += N - 1) {
+        auto prod = u[idx[0]];
+        for (auto j = 1; j < N - 1; ++j) prod *= u[idx[j]];
+        amat[row[i]][col[i]] -= coef[i] * prod;
+    }
+}
+
+void SensingMatrixTerms::subtract_from_generic(const double *u,
+                                               double **amat) const
+{
+    const auto nterms = row.size();
+    const auto *idx = u_index.data();
+
+    for (size_t i = 0; i < nterms; ++i, idx += nelems - 1) {
+        auto prod = u[idx[0]];
+        for (auto j = 1; j < nelems - 1; ++j) prod *= u[idx[j]];
+        amat[row[i]][col[i]] -= coef[i] * prod;
+    }
+}
+
 double Optimize::gamma(const int n,
                        const int *arr) const
 {
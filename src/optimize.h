@@ -73,6 +73,38 @@ namespace ALM_NS
         OptimizerControl& operator=(const OptimizerControl &obj) = default;
     };
 
+    class SensingMatrixTerms
+    {
+        // Terms of the sensing matrix of one order that do not depend on
+        // the displacement data. For each entry of fc_table, the row
+        // (3 * atom in the primitive cell + xyz), the column (parameter),
+        // the coefficient gamma * sign, and the indices of the
+        // displacements to be multiplied are stored.
+    public:
+        int nelems;
+        std::vector<int> row;
+        std::vector<size_t> col;
+        std::vector<double> coef;
+        std::vector<int> u_index; // [size() * (nelems - 1)]
+
+        SensingMatrixTerms() : nelems(0) {}
+
+        size_t size() const { return row.size(); }
+
+        // amat[row][col] -= coef * u[u_index[0]] * ... * u[u_index[nelems - 2]]
+        void subtract_from(const double *u,
+                           double **amat) const;
+
+    private:
+        // The loop over the displacement indices is unrolled
+        // for the harmonic, cubic and quartic terms.
+        template <int N>
+        void subtract_from_fixed(const double *u,
+                                 double **amat) const;
+        void subtract_from_generic(const double *u,
+                                   double **amat) const;
+    };
+
     class Optimize
     {
     public:
@@ -145,6 +177,11 @@ namespace ALM_NS
         int inprim_index(const int,
                          const Symmetry *) const;
 
+        void set_sensing_matrix_terms(const int maxorder,
+                                      const Symmetry *symmetry,
+                                      const Fcs *fcs,
+                                      std::vector<SensingMatrixTerms> &terms) const;
+
         int least_squares(const int maxorder,
                           const size_t N,
                           const size_t N_new,
@@ -21,7 +21,6 @@ or http://opensource.org/licenses/mit-license.php for information.
 #include "mathfunctions.h"
 #include "constraint.h"
 #include <map>
-#include <boost/bimap.hpp>
 
 using namespace ALM_NS;
 
@@ -53,12 +52,16 @@ void Displace::gen_displacement_pattern(const Cluster *cluster,
     std::set<int> *include_set;
     std::set<DispAtomSet> *dispset;
 
-    std::vector<size_t> *nequiv;
-    std::vector<FcProperty> *fc_table, *fc_zeros;
+    const std::vector<size_t> *nequiv;
+    const FcPropertyTable *fc_table;
+    std::vector<size_t> *nequiv_gen = nullptr;
+    FcPropertyTable *fc_table_gen = nullptr, *fc_zeros = nullptr;
+    const ClusterOrbitTable *cluster_orbit_constraint;
+    ClusterOrbitTable *cluster_orbit_gen = nullptr, *cluster_orbit_constraint_gen = nullptr;
 
     std::vector<ConstraintTypeFix> *const_fix_tmp;
     std::vector<ConstraintTypeRelate> *const_relate_tmp;
-    boost::bimap<size_t, size_t> *index_bimap_tmp;
+    ConstraintIndexMap *index_map_tmp;
     const auto do_rref = true;
 
     if (verbosity > 0) {
@@ -82,28 +85,52 @@ void Displace::gen_displacement_pattern(const Cluster *cluster,
     // std::cout << "Preferred_basis = " << preferred_basis << std::endl;
     // std::cout << ncompat_cart << " " << ncompat_latt << std::endl;
 
-    allocate(fc_table, maxorder);
-    allocate(fc_zeros, maxorder);
+    // The force constant table made in Fcs::init is reused
+    // when it is in the same basis. Otherwise, it is made here.
+    if (fcs->get_fc_property_table() && preferred_basis == fcs->get_forceconstant_basis()) {
+        fc_table = fcs->get_fc_property_table();
+        nequiv = fcs->get_nequiv();
+        cluster_orbit_constraint = fcs->get_cluster_orbit_table(false);
+    } else {
+        allocate(fc_table_gen, maxorder);
+        allocate(fc_zeros, maxorder);
+        allocate(nequiv_gen, maxorder);
+        allocate(cluster_orbit_gen, maxorder);
+        allocate(cluster_orbit_constraint_gen, maxorder);
+
+        fcs->make_cluster_orbit_table(maxorder, cluster, symmetry, preferred_basis,
+                                      cluster_orbit_gen, cluster_orbit_constraint_gen);
+
+        for (order = 0; order < maxorder; ++order) {
+            fcs->generate_force_constant_table(order,
+                                               system->get_supercell().number_of_atoms,
+                                               cluster->get_cluster_list(order),
+                                               cluster_orbit_gen[order],
+                                               symmetry, preferred_basis,
+                                               fc_table_gen[order], nequiv_gen[order],
+                                               fc_zeros[order], false);
+        }
+        deallocate(fc_zeros);
+        deallocate(cluster_orbit_gen);
+
+        fc_table = fc_table_gen;
+        nequiv = nequiv_gen;
+        cluster_orbit_constraint = cluster_orbit_constraint_gen;
+    }
+
     allocate(constsym, maxorder);
-    allocate(nequiv, maxorder);
     allocate(const_fix_tmp, maxorder);
     allocate(const_relate_tmp, maxorder);
-    allocate(index_bimap_tmp, maxorder);
+    allocate(index_map_tmp, maxorder);
 
     for (order = 0; order < maxorder; ++order) {
 
-        fcs->generate_force_constant_table(order,
-                                           system->get_supercell().number_of_atoms,
-                                           cluster->get_cluster_list(order),
-                                           symmetry, preferred_basis,
-                                           fc_table[order], nequiv[order],
-                                           fc_zeros[order], false);
-
         fcs->get_constraint_symmetry(system->get_supercell().number_of_atoms,
                                      symmetry,
                                      order,
                                      preferred_basis,
                                      fc_table[order],
+                                     cluster_orbit_constraint[order],
                                      nequiv[order].size(),
                                      constraint->get_tolerance_constraint(),
                                      constsym[order], do_rref);
@@ -119,34 +146,34 @@ void Displace::gen_displacement_pattern(const Cluster *cluster,
                                        constsym,
                                        const_fix_tmp,
                                        const_relate_tmp,
-                                       index_bimap_tmp);
+                                       index_map_tmp);
 
     if (verbosity > 0) {
         for (order = 0; order < maxorder; ++order) {
             std::cout << "  Number of free" << std::setw(9)
                 << cluster->get_ordername(order) << " FCs : "
-                << index_bimap_tmp[order].size() << std::endl;
+                << index_map_tmp[order].size() << std::endl;
         }
         std::cout << std::endl;
     }
 
 
     deallocate(constsym);
+    if (cluster_orbit_constraint_gen) deallocate(cluster_orbit_constraint_gen);
     deallocate(const_fix_tmp);
     deallocate(const_relate_tmp);
-    deallocate(fc_zeros);
 
     allocate(include_set, maxorder);
 
     for (order = 0; order < maxorder; ++order) {
         include_set[order].clear();
 
-        for (const auto &it : index_bimap_tmp[order]) {
-            include_set[order].insert(it.right);
+        for (size_t i = 0; i < index_map_tmp[order].size(); ++i) {
+            include_set[order].insert(index_map_tmp[order].get_orig(i));
         }
     }
 
-    deallocate(index_bimap_tmp);
+    deallocate(index_map_tmp);
 
     if (verbosity > 0) {
         std::cout << "  Generating displacement patterns in ";
@@ -169,7 +196,7 @@ void Displace::gen_displacement_pattern(const Cluster *cluster,
                 // Here, duplicate entries will be removed.
                 // For example, (iij) will be reduced to (ij).
                 for (auto j = 0; j < order + 1; ++j) {
-                    group_tmp.push_back(fc_table[order][m].elems[j]);
+                    group_tmp.push_back(fc_table[order].get_elems(m)[j]);
                 }
                 group_tmp.erase(std::unique(group_tmp.begin(), group_tmp.end()),
                                 group_tmp.end());
@@ -183,8 +210,8 @@ void Displace::gen_displacement_pattern(const Cluster *cluster,
         }
     }
     deallocate(include_set);
-    deallocate(nequiv);
-    deallocate(fc_table);
+    if (nequiv_gen) deallocate(nequiv_gen);
+    if (fc_table_gen) deallocate(fc_table_gen);
 
     allocate(pattern_all, maxorder);
     // pattern_all is updated.
@@ -0,0 +1,776 @@
+/*
+ setup_cache.cpp
+
+ Copyright (c) 2014--2017 Terumasa Tadano
+
+ This file is distributed under the terms of the MIT license.
+ Please see the file 'LICENCE.txt' in the root directory
+ or http://opensource.org/licenses/mit-license.php for information.
+*/
+
+#include "setup_cache.h"
+#include "cluster.h"
+#include "constraint.h"
+#include "error.h"
+#include "fcs.h"
+#include "symmetry.h"
+#include "system.h"
+#include <cstdio>
+#include <iostream>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+using namespace ALM_NS;
+
+SetupCache::SetupCache()
+{
+    filename = "";
+    filename_symmetry = "";
+    key_structure = 0;
+}
+
+SetupCache::~SetupCache() = default;
+
+void SetupCache::set_filename(const std::string filename_in)
+{
+    filename = filename_in;
+}
+
+std::string SetupCache::get_filename() const
+{
+    return filename;
+}
+
+bool SetupCache::is_enabled() const
+{
+    return !filename.empty();
+}
+
+void SetupCache::set_filename_symmetry(const std::string filename_in)
+{
+    filename_symmetry = filename_in;
+}
+
+std::string SetupCache::get_filename_symmetry() const
+{
+    return filename_symmetry;
+}
+
+bool SetupCache::is_enabled_symmetry() const
+{
+    return !filename_symmetry.empty();
+}
+
+void SetupCache::hash_bytes(uint64_t &key,
+                            const void *data,
+                            const size_t nbytes)
+{
+    // FNV-1a
+    const auto ptr = static_cast<const unsigned char *>(data);
+    for (size_t i = 0; i < nbytes; ++i) {
+        key ^= static_cast<uint64_t>(ptr[i]);
+        key *= 0x100000001b3ULL;
+    }
+}
+
+void SetupCache::hash_file(uint64_t &key,
+                           const std::string &file_in)
+{
+    // The file is identified by its name, size and modification time
+    // rather than its contents, which may be several GB.
+    hash_bytes(key, file_in.c_str(), file_in.size());
+
+    uint64_t stamp[3];
+    if (!get_file_stamp(file_in, stamp)) return;
+    hash_bytes(key, stamp, sizeof(stamp));
+}
+
+void SetupCache::set_key_structure(const System *system,
+                                   const Symmetry *symmetry,
+                                   const Cluster *cluster,
+                                   const std::string &basis)
+{
+    size_t i, j, k;
+    uint64_t key = 0xcbf29ce484222325ULL;
+
+    const auto &cell = system->get_supercell();
+    const auto &spin = system->get_spin();
+    const auto maxorder = cluster->get_maxorder();
+    const auto nkd = cell.number_of_elems;
+
+    hash_value(key, cell.number_of_atoms);
+    hash_value(key, nkd);
+    for (i = 0; i < 3; ++i) {
+        for (j = 0; j < 3; ++j) {
+            hash_value(key, cell.lattice_vector[i][j]);
+        }
+    }
+    for (i = 0; i < cell.number_of_atoms; ++i) {
+        hash_value(key, cell.kind[i]);
+        for (j = 0; j < 3; ++j) {
+            hash_value(key, cell.x_fractional[i][j]);
+        }
+    }
+    for (i = 0; i < 3; ++i) {
+        hash_value(key, system->get_periodicity()[i]);
+    }
+
+    hash_value(key, spin.lspin);
+    if (spin.lspin) {
+        hash_value(key, spin.noncollinear);
+        hash_value(key, spin.time_reversal_symm);
+        for (i = 0; i < cell.number_of_atoms; ++i) {
+            for (j = 0; j < 3; ++j) {
+                hash_value(key, spin.magmom[i][j]);
+            }
+        }
+    }
+
+    hash_value(key, symmetry->get_tolerance());
+    hash_value(key, symmetry->get_use_internal_symm_finder());
+
+    hash_value(key, maxorder);
+    for (auto order = 0; order < maxorder; ++order) {
+        hash_value(key, cluster->get_nbody_include()[order]);
+        for (j = 0; j < nkd; ++j) {
+            for (k = 0; k < nkd; ++k) {
+                hash_value(key, cluster->get_cutoff_radii()[order][j][k]);
+            }
+        }
+    }
+
+    hash_bytes(key, basis.c_str(), basis.size());
+
+    key_structure = key;
+}
+
+uint64_t SetupCache::get_key_constraint(const int constraint_mode,
+                                        const int constraint_algebraic,
+                                        const std::string &rotation_axis,
+                                        const double tolerance_constraint,
+                                        const std::string &fc2_file,
+                                        const std::string &fc3_file) const
+{
+    auto key = key_structure;
+
+    hash_value(key, constraint_mode);
+    hash_value(key, constraint_algebraic);
+    hash_value(key, tolerance_constraint);
+    hash_bytes(key, rotation_axis.c_str(), rotation_axis.size());
+
+    // FC2XML and FC3XML are also identified in the key
+    // because the fixed values are stored in const_fix.
+    if (!fc2_file.empty()) hash_file(key, fc2_file);
+    hash_value(key, '\0');
+    if (!fc3_file.empty()) hash_file(key, fc3_file);
+
+    return key;
+}
+
+uint64_t SetupCache::get_key_symmetry(const System *system,
+                                      const double tolerance,
+                                      const bool use_internal_symm_finder) const
+{
+    size_t i, j;
+    uint64_t key = 0xcbf29ce484222325ULL;
+
+    const auto &cell = system->get_supercell();
+    const auto &spin = system->get_spin();
+
+    hash_value(key, cell.number_of_atoms);
+    hash_value(key, cell.number_of_elems);
+    for (i = 0; i < 3; ++i) {
+        for (j = 0; j < 3; ++j) {
+            hash_value(key, cell.lattice_vector[i][j]);
+        }
+    }
+    for (i = 0; i < cell.number_of_atoms; ++i) {
+        hash_value(key, cell.kind[i]);
+        for (j = 0; j < 3; ++j) {
+            hash_value(key, cell.x_fractional[i][j]);
+        }
+    }
+    for (i = 0; i < 3; ++i) {
+        hash_value(key, system->get_periodicity()[i]);
+    }
+
+    hash_value(key, spin.lspin);
+    if (spin.lspin) {
+        hash_value(key, spin.noncollinear);
+        hash_value(key, spin.time_reversal_symm);
+        for (i = 0; i < cell.number_of_atoms; ++i) {
+            for (j = 0; j < 3; ++j) {
+                hash_value(key, spin.magmom[i][j]);
+            }
+        }
+    }
+
+    hash_value(key, tolerance);
+    hash_value(key, use_internal_symm_finder);
+
+    return key;
+}
+
+bool SetupCache::read_header(std::ifstream &ifs,
+                             const int maxorder) const
+{
+    uint64_t magic_in, key_in;
+    int version_in, maxorder_in;
+
+    if (!read_value(ifs, magic_in) || magic_in != magic_number) return false;
+    if (!read_value(ifs, version_in) || version_in != version) return false;
+    if (!read_value(ifs, key_in) || key_in != key_structure) return false;
+    if (!read_value(ifs, maxorder_in) || maxorder_in != maxorder) return false;
+
+    return true;
+}
+
+void SetupCache::write_header(std::ofstream &ofs,
+                              const int maxorder) const
+{
+    const uint64_t magic_out = magic_number;
+    const int version_out = version;
+
+    write_value(ofs, magic_out);
+    write_value(ofs, version_out);
+    write_value(ofs, key_structure);
+    write_value(ofs, maxorder);
+}
+
+bool SetupCache::fits_in_file(std::ifstream &ifs,
+                              const uint64_t nitems,
+                              const size_t nbytes_per_item)
+{
+    // Check that nitems records of nbytes_per_item bytes can still be read,
+    // so that a corrupted count does not trigger a huge allocation.
+    const auto pos = ifs.tellg();
+    ifs.seekg(0, std::ios::end);
+    const auto end = ifs.tellg();
+    ifs.seekg(pos);
+    if (!ifs || pos < 0 || end < pos) return false;
+
+    return nitems <= static_cast<uint64_t>(end - pos) / nbytes_per_item;
+}
+
+bool SetupCache::get_file_stamp(const std::string &file_in,
+                                uint64_t stamp[3])
+{
+    // Size and modification time of the file. The sub-second part of
+    // the time is used where stat provides it.
+    struct stat st;
+    if (stat(file_in.c_str(), &st) != 0) return false;
+    stamp[0] = static_cast<uint64_t>(st.st_size);
+    stamp[1] = static_cast<uint64_t>(st.st_mtime);
+#if defined(__APPLE__)
+    stamp[2] = static_cast<uint64_t>(st.st_mtimespec.tv_nsec);
+#elif defined(_WIN32)
+    stamp[2] = 0;
+#else
+    stamp[2] = static_cast<uint64_t>(st.st_mtim.tv_nsec);
+#endif
+    return true;
+}
+
+bool SetupCache::replace_file(const std::string &file_tmp,
+                              const std::string &file_out)
+{
+    // std::rename does not overwrite an existing file on Windows.
+    if (std::rename(file_tmp.c_str(), file_out.c_str()) == 0) return true;
+    std::remove(file_out.c_str());
+    if (std::rename(file_tmp.c_str(), file_out.c_str()) == 0) return true;
+    std::remove(file_tmp.c_str());
+    return false;
+}
+
+bool SetupCache::read_fcs_section(std::ifstream &ifs,
+                                  const int maxorder,
+                                  const size_t nat,
+                                  FcPropertyTable *fc_table,
+                                  std::vector<size_t> *nequiv,
+                                  std::vector<size_t> &nuniq_out) const
+{
+    // Read the FC table section. When fc_table and nequiv are nullptr,
+    // the section is just skipped. The counts and indices are validated;
+    // the atom indices are checked only when nat > 0.
+
+    uint64_t nfcs, nuniq, ival;
+    int elems[FcPropertyKey::max_words * FcPropertyKey::index_per_word];
+    double sign;
+    const auto nelems_max = static_cast<int64_t>(3 * nat);
+    std::vector<uint64_t> nequiv_now;
+
+    nuniq_out.assign(maxorder, 0);
+
+    for (auto order = 0; order < maxorder; ++order) {
+        const auto nelems = order + 2;
+
+        if (!read_value(ifs, nuniq)) return false;
+        if (!fits_in_file(ifs, nuniq, sizeof(uint64_t))) return false;
+        nequiv_now.resize(nuniq);
+        uint64_t nsum = 0;
+        for (uint64_t i = 0; i < nuniq; ++i) {
+            if (!read_value(ifs, ival) || ival == 0) return false;
+            nequiv_now[i] = ival;
+            nsum += ival;
+        }
+        if (nequiv) nequiv[order].assign(nequiv_now.begin(), nequiv_now.end());
+
+        const auto nbytes_fc = sizeof(int) * nelems + sizeof(double) + sizeof(uint64_t);
+        if (!read_value(ifs, nfcs) || nfcs != nsum) return false;
+        if (!fits_in_file(ifs, nfcs, nbytes_fc)) return false;
+        if (fc_table) {
+            fc_table[order] = FcPropertyTable(nelems);
+            fc_table[order].reserve(nfcs);
+        }
+
+        // The entries are grouped by mother in the order of nequiv.
+        uint64_t imother = 0;
+        uint64_t nleft = nuniq > 0 ? nequiv_now[0] : 0;
+
+        for (uint64_t i = 0; i < nfcs; ++i) {
+            ifs.read(reinterpret_cast<char *>(elems), sizeof(int) * nelems);
+            if (!read_value(ifs, sign) || !read_value(ifs, ival)) return false;
+            if (ival >= nuniq) return false;
+            if (sign != 1.0 && sign != -1.0) return false;
+            if (nat > 0) {
+                for (auto j = 0; j < nelems; ++j) {
+                    if (elems[j] < 0 || elems[j] >= nelems_max) return false;
+                }
+            }
+            if (nleft == 0) {
+                ++imother;
+                nleft = nequiv_now[imother];
+            }
+            if (ival != imother) return false;
+            --nleft;
+            if (fc_table) fc_table[order].push_back(elems, sign, ival);
+        }
+        nuniq_out[order] = nuniq;
+    }
+    return static_cast<bool>(ifs);
+}
+
+bool SetupCache::load_fcs(const int maxorder,
+                          const size_t nat,
+                          FcPropertyTable *fc_table,
+                          std::vector<size_t> *nequiv) const
+{
+    if (!is_enabled()) return false;
+
+    std::ifstream ifs(filename.c_str(), std::ios::in | std::ios::binary);
+    if (!ifs) return false;
+    if (!read_header(ifs, maxorder)) return false;
+
+    std::vector<FcPropertyTable> fc_table_tmp(maxorder);
+    std::vector<std::vector<size_t>> nequiv_tmp(maxorder);
+    std::vector<size_t> nuniq;
+
+    if (!read_fcs_section(ifs, maxorder, nat,
+                          &fc_table_tmp[0], &nequiv_tmp[0], nuniq)) {
+        return false;
+    }
+
+    for (auto order = 0; order < maxorder; ++order) {
+        fc_table[order] = std::move(fc_table_tmp[order]);
+        nequiv[order] = std::move(nequiv_tmp[order]);
+    }
+    return true;
+}
+
+void SetupCache::save_fcs(const int maxorder,
+                          const FcPropertyTable *fc_table,
+                          const std::vector<size_t> *nequiv) const
+{
+    if (!is_enabled()) return;
+
+    // Write to a temporary file first so that an interrupted run
+    // does not leave a truncated cache behind.
+    const auto filename_tmp = filename + ".tmp";
+    std::ofstream ofs(filename_tmp.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!ofs) {
+        warn("SetupCache::save_fcs", "Could not open the setup cache file for writing.");
+        return;
+    }
+
+    write_header(ofs, maxorder);
+
+    for (auto order = 0; order < maxorder; ++order) {
+        const auto nelems = order + 2;
+
+        write_value(ofs, static_cast<uint64_t>(nequiv[order].size()));
+        for (const auto &it : nequiv[order]) {
+            write_value(ofs, static_cast<uint64_t>(it));
+        }
+
+        write_value(ofs, static_cast<uint64_t>(fc_table[order].size()));
+        for (size_t i = 0; i < fc_table[order].size(); ++i) {
+            ofs.write(reinterpret_cast<const char *>(fc_table[order].get_elems(i)), sizeof(int) * nelems);
+            write_value(ofs, fc_table[order].get_sign(i));
+            write_value(ofs, static_cast<uint64_t>(fc_table[order].get_mother(i)));
+        }
+    }
+
+    ofs.close();
+    if (!ofs || !replace_file(filename_tmp, filename)) {
+        std::remove(filename_tmp.c_str());
+        warn("SetupCache::save_fcs", "Could not write the setup cache file.");
+    }
+}
+
+bool SetupCache::load_constraint(const uint64_t key_constraint,
+                                 const int maxorder,
+                                 const size_t nparams,
+                                 std::vector<ConstraintTypeFix> *const_fix,
+                                 std::vector<ConstraintTypeRelate> *const_relate,
+                                 ConstraintIndexMap *index_map,
+                                 bool &extra_constraint_from_symmetry,
+                                 size_t &number_of_constraints,
+                                 std::vector<double> &const_mat,
+                                 std::vector<double> &const_rhs) const
+{
+    if (!is_enabled()) return false;
+
+    std::ifstream ifs(filename.c_str(), std::ios::in | std::ios::binary);
+    if (!ifs) return false;
+    if (!read_header(ifs, maxorder)) return false;
+    std::vector<size_t> nuniq;
+    if (!read_fcs_section(ifs, maxorder, 0, nullptr, nullptr, nuniq)) return false;
+
+    uint64_t key_in, nparams_in, nsize, ival, ival2;
+    double dval;
+    int flag;
+
+    if (!read_value(ifs, key_in) || key_in != key_constraint) return false;
+    if (!read_value(ifs, nparams_in) || nparams_in != nparams) return false;
+    if (!read_value(ifs, flag)) return false;
+
+    size_t nparams_sum = 0;
+    for (const auto &it : nuniq) nparams_sum += it;
+    if (nparams_sum != nparams) return false;
+
+    std::vector<std::vector<ConstraintTypeFix>> fix_tmp(maxorder);
+    std::vector<std::vector<ConstraintTypeRelate>> relate_tmp(maxorder);
+    std::vector<ConstraintIndexMap> index_map_tmp(maxorder);
+    std::vector<double> alpha;
+    std::vector<size_t> p_index_orig;
+
+    for (auto order = 0; order < maxorder; ++order) {
+
+        // The parameter indices of each order must be < nuniq[order].
+        const auto nparams_now = nuniq[order];
+
+        if (!read_value(ifs, nsize)) return false;
+        if (!fits_in_file(ifs, nsize, sizeof(uint64_t) + sizeof(double))) return false;
+        fix_tmp[order].reserve(nsize);
+        for (uint64_t i = 0; i < nsize; ++i) {
+            if (!read_value(ifs, ival) || !read_value(ifs, dval)) return false;
+            if (ival >= nparams_now) return false;
+            fix_tmp[order].emplace_back(ival, dval);
+        }
+
+        if (!read_value(ifs, nsize)) return false;
+        if (!fits_in_file(ifs, nsize, 2 * sizeof(uint64_t))) return false;
+        relate_tmp[order].reserve(nsize);
+        for (uint64_t i = 0; i < nsize; ++i) {
+            uint64_t ntarget, nalpha;
+            if (!read_value(ifs, ntarget) || !read_value(ifs, nalpha)) return false;
+            if (ntarget >= nparams_now) return false;
+            if (!fits_in_file(ifs, nalpha, sizeof(double) + sizeof(uint64_t))) return false;
+            alpha.resize(nalpha);
+            p_index_orig.resize(nalpha);
+            for (uint64_t j = 0; j < nalpha; ++j) {
+                if (!read_value(ifs, alpha[j]) || !read_value(ifs, ival)) return false;
+                if (ival >= nparams_now) return false;
+                p_index_orig[j] = ival;
+            }
+            relate_tmp[order].emplace_back(ntarget, alpha, p_index_orig);
+        }
+
+        if (!read_value(ifs, ival) || ival != nparams_now) return false;
+        if (!read_value(ifs, nsize) || nsize > ival) return false;
+        index_map_tmp[order].init(ival);
+        for (uint64_t i = 0; i < nsize; ++i) {
+            if (!read_value(ifs, ival2) || ival2 >= ival) return false;
+            if (index_map_tmp[order].get_free(ival2) != ConstraintIndexMap::none) return false;
+            index_map_tmp[order].push_back(ival2);
+        }
+    }
+
+    if (!read_value(ifs, nsize)) return false;
+    if (!fits_in_file(ifs, nsize, sizeof(double) * (nparams + 1))) return false;
+    const_mat.resize(nsize * nparams);
+    const_rhs.resize(nsize);
+    if (nsize > 0) {
+        ifs.read(reinterpret_cast<char *>(&const_mat[0]), sizeof(double) * const_mat.size());
+        ifs.read(reinterpret_cast<char *>(&const_rhs[0]), sizeof(double) * const_rhs.size());
+        if (!ifs) return false;
+    }
+
+    // Everything has been read successfully. Now update the output.
+    for (auto order = 0; order < maxorder; ++order) {
+        const_fix[order] = std::move(fix_tmp[order]);
+        const_relate[order] = std::move(relate_tmp[order]);
+        index_map[order] = std::move(index_map_tmp[order]);
+    }
+    extra_constraint_from_symmetry = flag != 0;
+    number_of_constraints = nsize;
+
+    return true;
+}
+
+void SetupCache::save_constraint(const uint64_t key_constraint,
+                                 const int maxorder,
+                                 const size_t nparams,
+                                 const std::vector<ConstraintTypeFix> *const_fix,
+                                 const std::vector<ConstraintTypeRelate> *const_relate,
+                                 const ConstraintIndexMap *index_map,
+                                 const bool extra_constraint_from_symmetry,
+                                 const size_t number_of_constraints,
+                                 const double * const *const_mat,
+                                 const double *const_rhs) const
+{
+    if (!is_enabled()) return;
+
+    // The constraint section follows the FC table section that must be
+    // written beforehand by save_fcs. The FC table section is kept
+    // as is and the old constraint section (if any) is replaced.
+
+    std::string fcs_section;
+    {
+        std::ifstream ifs(filename.c_str(), std::ios::in | std::ios::binary);
+        if (!ifs) return;
+        if (!read_header(ifs, maxorder)) return;
+        std::vector<size_t> nuniq;
+        if (!read_fcs_section(ifs, maxorder, 0, nullptr, nullptr, nuniq)) return;
+        const auto nbytes = static_cast<size_t>(ifs.tellg());
+        fcs_section.resize(nbytes);
+        ifs.seekg(0, std::ios::beg);
+        ifs.read(&fcs_section[0], nbytes);
+        if (!ifs) return;
+    }
+
+    const auto filename_tmp = filename + ".tmp";
+    std::ofstream ofs(filename_tmp.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!ofs) {
+        warn("SetupCache::save_constraint", "Could not open the setup cache file for writing.");
+        return;
+    }
+
+    ofs.write(&fcs_section[0], fcs_section.size());
+
+    const int flag = extra_constraint_from_symmetry ? 1 : 0;
+    write_value(ofs, key_constraint);
+    write_value(ofs, static_cast<uint64_t>(nparams));
+    write_value(ofs, flag);
+
+    for (auto order = 0; order < maxorder; ++order) {
+
+        write_value(ofs, static_cast<uint64_t>(const_fix[order].size()));
+        for (const auto &it : const_fix[order]) {
+            write_value(ofs, static_cast<uint64_t>(it.p_index_target));
+            write_value(ofs, it.val_to_fix);
+        }
+
+        write_value(ofs, static_cast<uint64_t>(const_relate[order].size()));
+        for (const auto &it : const_relate[order]) {
+            write_value(ofs, static_cast<uint64_t>(it.p_index_target));
+            write_value(ofs, static_cast<uint64_t>(it.alpha.size()));
+            for (size_t j = 0; j < it.alpha.size(); ++j) {
+                write_value(ofs, it.alpha[j]);
+                write_value(ofs, static_cast<uint64_t>(it.p_index_orig[j]));
+            }
+        }
+
+        write_value(ofs, static_cast<uint64_t>(index_map[order].get_nparams()));
+        write_value(ofs, static_cast<uint64_t>(index_map[order].size()));
+        for (size_t i = 0; i < index_map[order].size(); ++i) {
+            write_value(ofs, static_cast<uint64_t>(index_map[order].get_orig(i)));
+        }
+    }
+
+    const uint64_t nconst = (const_mat && const_rhs) ? number_of_constraints : 0;
+    write_value(ofs, nconst);
+    for (uint64_t i = 0; i < nconst; ++i) {
+        ofs.write(reinterpret_cast<const char *>(const_mat[i]), sizeof(double) * nparams);
+    }
+    if (nconst > 0) {
+        ofs.write(reinterpret_cast<const char *>(const_rhs), sizeof(double) * nconst);
+    }
+
+    ofs.close();
+    if (!ofs || !replace_file(filename_tmp, filename)) {
+        std::remove(filename_tmp.c_str());
+        warn("SetupCache::save_constraint", "Could not write the setup cache file.");
+    }
+}
+
+bool SetupCache::load_symmetry(const uint64_t key_symmetry,
+                               const size_t nat,
+                               std::vector<SymmetryOperation> &symm_data,
+                               std::vector<int> &symnum_tran,
+                               std::vector<std::vector<int>> &map_sym,
+                               std::vector<std::vector<int>> &map_p2s,
+                               std::vector<Maps> &map_s2p,
+                               int &spacegroup_number,
+                               std::string &spacegroup_symbol) const
+{
+    if (!is_enabled_symmetry()) return false;
+
+    std::ifstream ifs(filename_symmetry.c_str(), std::ios::in | std::ios::binary);
+    if (!ifs) return false;
+
+    uint64_t magic_in, key_in, nat_in, nsym, ntran, nchar;
+    int version_in, spgnum;
+    size_t i, j;
+
+    if (!read_value(ifs, magic_in) || magic_in != magic_number_symmetry) return false;
+    if (!read_value(ifs, version_in) || version_in != version_symmetry) return false;
+    if (!read_value(ifs, key_in) || key_in != key_symmetry) return false;
+    if (!read_value(ifs, nat_in) || nat_in != nat) return false;
+    if (!read_value(ifs, nsym) || !read_value(ifs, ntran)) return false;
+    if (ntran == 0 || ntran > nat || nat % ntran) return false;
+    if (nsym < ntran || nsym > 48 * ntran) return false;
+    if (!read_value(ifs, spgnum) || !read_value(ifs, nchar) || nchar > 64) return false;
+
+    std::string symbol_tmp(nchar, ' ');
+    if (nchar > 0) ifs.read(&symbol_tmp[0], nchar);
+
+    // Each operation accounts for its record and one entry of map_sym per atom,
+    // so this bounds the allocations below by the size of the file.
+    const auto nbytes_sym = 9 * sizeof(int) + 12 * sizeof(double) + 3 + nat * sizeof(int);
+    if (!ifs || !fits_in_file(ifs, nsym, nbytes_sym)) return false;
+
+    std::vector<SymmetryOperation> symm_tmp;
+    symm_tmp.reserve(nsym);
+    int rot[3][3];
+    double tran[3], rot_cart[3][3];
+    char flags[3];
+
+    for (uint64_t isym = 0; isym < nsym; ++isym) {
+        ifs.read(reinterpret_cast<char *>(&rot[0][0]), sizeof(int) * 9);
+        ifs.read(reinterpret_cast<char *>(tran), sizeof(double) * 3);
+        ifs.read(reinterpret_cast<char *>(&rot_cart[0][0]), sizeof(double) * 9);
+        ifs.read(flags, 3);
+        if (!ifs) return false;
+        symm_tmp.emplace_back(rot, tran, rot_cart,
+                              flags[0] != 0, flags[1] != 0, flags[2] != 0);
+    }
+
+    const auto nat_prim = nat / ntran;
+    std::vector<int> symnum_tmp(ntran);
+    std::vector<std::vector<int>> map_sym_tmp(nat, std::vector<int>(nsym));
+    std::vector<std::vector<int>> map_p2s_tmp(nat_prim, std::vector<int>(ntran));
+    std::vector<Maps> map_s2p_tmp(nat);
+
+    ifs.read(reinterpret_cast<char *>(&symnum_tmp[0]), sizeof(int) * ntran);
+    for (i = 0; i < nat; ++i) {
+        ifs.read(reinterpret_cast<char *>(&map_sym_tmp[i][0]), sizeof(int) * nsym);
+    }
+    for (i = 0; i < nat_prim; ++i) {
+        ifs.read(reinterpret_cast<char *>(&map_p2s_tmp[i][0]), sizeof(int) * ntran);
+    }
+    for (i = 0; i < nat; ++i) {
+        if (!read_value(ifs, map_s2p_tmp[i].atom_num)
+            || !read_value(ifs, map_s2p_tmp[i].tran_num)) return false;
+    }
+    if (!ifs) return false;
+
+    // Validate the mapping tables before using them.
+    // SymmData is stored in the canonical order without duplicates.
+    for (i = 2; i < nsym; ++i) {
+        if (!(symm_tmp[i - 1] < symm_tmp[i])) return false;
+    }
+    const auto nat_int = static_cast<int>(nat);
+    const auto nsym_int = static_cast<int>(nsym);
+    const auto ntran_int = static_cast<int>(ntran);
+    const auto nat_prim_int = static_cast<int>(nat_prim);
+
+    for (const auto &it : symnum_tmp) {
+        if (it < 0 || it >= nsym_int || !symm_tmp[it].is_translation) return false;
+    }
+    for (i = 0; i < nat; ++i) {
+        for (j = 0; j < nsym; ++j) {
+            if (map_sym_tmp[i][j] < 0 || map_sym_tmp[i][j] >= nat_int) return false;
+        }
+    }
+    for (i = 0; i < nat; ++i) {
+        const auto iat = map_s2p_tmp[i].atom_num;
+        const auto itran = map_s2p_tmp[i].tran_num;
+        if (iat < 0 || iat >= nat_prim_int || itran < 0 || itran >= ntran_int) return false;
+        if (map_p2s_tmp[iat][itran] != static_cast<int>(i)) return false;
+    }
+
+    // Everything has been read successfully. Now update the output.
+    symm_data = std::move(symm_tmp);
+    symnum_tran = std::move(symnum_tmp);
+    map_sym = std::move(map_sym_tmp);
+    map_p2s = std::move(map_p2s_tmp);
+    map_s2p = std::move(map_s2p_tmp);
+    spacegroup_number = spgnum;
+    spacegroup_symbol = symbol_tmp;
+
+    return true;
+}
+
+void SetupCache::save_symmetry(const uint64_t key_symmetry,
+                               const std::vector<SymmetryOperation> &symm_data,
+                               const std::vector<int> &symnum_tran,
+                               const std::vector<std::vector<int>> &map_sym,
+                               const std::vector<std::vector<int>> &map_p2s,
+                               const std::vector<Maps> &map_s2p,
+                               const int spacegroup_number,
+                               const std::string &spacegroup_symbol) const
+{
+    if (!is_enabled_symmetry()) return;
+
+    const auto filename_tmp = filename_symmetry + ".tmp";
+    std::ofstream ofs(filename_tmp.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!ofs) {
+        warn("SetupCache::save_symmetry", "Could not open the symmetry cache file for writing.");
+        return;
+    }
+
+    const uint64_t magic_out = magic_number_symmetry;
+    const int version_out = version_symmetry;
+    const auto nsym = symm_data.size();
+    const auto ntran = symnum_tran.size();
+    char flags[3];
+
+    write_value(ofs, magic_out);
+    write_value(ofs, version_out);
+    write_value(ofs, key_symmetry);
+    write_value(ofs, static_cast<uint64_t>(map_sym.size()));
+    write_value(ofs, static_cast<uint64_t>(nsym));
+    write_value(ofs, static_cast<uint64_t>(ntran));
+    write_value(ofs, spacegroup_number);
+    write_value(ofs, static_cast<uint64_t>(spacegroup_symbol.size()));
+    ofs.write(spacegroup_symbol.c_str(), spacegroup_symbol.size());
+
+    for (const auto &it : symm_data) {
+        ofs.write(reinterpret_cast<const char *>(&it.rotation[0][0]), sizeof(int) * 9);
+        ofs.write(reinterpret_cast<const char *>(it.tran), sizeof(double) * 3);
+        ofs.write(reinterpret_cast<const char *>(&it.rotation_cart[0][0]), sizeof(double) * 9);
+        flags[0] = it.compatible_with_lattice ? 1 : 0;
+        flags[1] = it.compatible_with_cartesian ? 1 : 0;
+        flags[2] = it.is_translation ? 1 : 0;
+        ofs.write(flags, 3);
+    }
+
+    ofs.write(reinterpret_cast<const char *>(&symnum_tran[0]), sizeof(int) * ntran);
+    for (const auto &it : map_sym) {
+        ofs.write(reinterpret_cast<const char *>(&it[0]), sizeof(int) * nsym);
+    }
+    for (const auto &it : map_p2s) {
+        ofs.write(reinterpret_cast<const char *>(&it[0]), sizeof(int) * ntran);
+    }
+    for (const auto &it : map_s2p) {
+        write_value(ofs, it.atom_num);
+        write_value(ofs, it.tran_num);
+    }
+
+    ofs.close();
+    if (!ofs || !replace_file(filename_tmp, filename_symmetry)) {
+        std::remove(filename_tmp.c_str());
+        warn("SetupCache::save_symmetry", "Could not write the symmetry cache file.");
+    }
+}
@@ -0,0 +1,192 @@
+/*
+ setup_cache.h
+
+ Copyright (c) 2014--2017 Terumasa Tadano
+
+ This file is distributed under the terms of the MIT license.
+ Please see the file 'LICENCE.txt' in the root directory
+ or http://opensource.org/licenses/mit-license.php for information.
+*/
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <fstream>
+#include "cluster.h"
+#include "constraint.h"
+#include "fcs.h"
+#include "symmetry.h"
+#include "system.h"
+
+namespace ALM_NS
+{
+    class SetupCache
+    {
+        // Persistent cache of the force constant table (fc_table, nequiv)
+        // and the reduced constraints (const_fix, const_relate, index_map).
+        // The data are stored in a binary file together with a hash of the
+        // input variables that determine them. When the hash matches,
+        // the expensive generation steps in Fcs::init and Constraint::setup
+        // are skipped. The zero force constants (Fcs::fc_zeros) and the
+        // symmetry constraints (Constraint::const_symmetry) are intermediate
+        // data that are not read after the setup, so they are not stored
+        // and are left empty on a cache hit. Cluster::init is not skipped
+        // because the interaction clusters are needed for the output files.
+        // The symmetry operations and atom mappings are stored in a separate
+        // file because they depend on the structure only and can be shared
+        // by runs with different cutoff radii.
+    public:
+        SetupCache();
+        ~SetupCache();
+
+        void set_filename(const std::string);
+        std::string get_filename() const;
+        bool is_enabled() const;
+
+        void set_filename_symmetry(const std::string);
+        std::string get_filename_symmetry() const;
+        bool is_enabled_symmetry() const;
+
+        // Hash of the lattice, atomic positions, spin, periodicity,
+        // symmetry tolerance and finder, cutoff radii, nbody_include
+        // and FC basis.
+        void set_key_structure(const System *system,
+                               const Symmetry *symmetry,
+                               const Cluster *cluster,
+                               const std::string &basis);
+
+        // Hash of key_structure and the variables of the constraint mode.
+        uint64_t get_key_constraint(const int constraint_mode,
+                                    const int constraint_algebraic,
+                                    const std::string &rotation_axis,
+                                    const double tolerance_constraint,
+                                    const std::string &fc2_file,
+                                    const std::string &fc3_file) const;
+
+        // Every count and index is validated on load. When the file is
+        // missing, outdated or corrupted, false is returned and the
+        // output is left untouched.
+        bool load_fcs(const int maxorder,
+                      const size_t nat,
+                      FcPropertyTable *fc_table,
+                      std::vector<size_t> *nequiv) const;
+
+        void save_fcs(const int maxorder,
+                      const FcPropertyTable *fc_table,
+                      const std::vector<size_t> *nequiv) const;
+
+        // const_mat and const_rhs are stored only when they are allocated,
+        // i.e., the constraints are not handled algebraically.
+        bool load_constraint(const uint64_t key_constraint,
+                             const int maxorder,
+                             const size_t nparams,
+                             std::vector<ConstraintTypeFix> *const_fix,
+                             std::vector<ConstraintTypeRelate> *const_relate,
+                             ConstraintIndexMap *index_map,
+                             bool &extra_constraint_from_symmetry,
+                             size_t &number_of_constraints,
+                             std::vector<double> &const_mat,
+                             std::vector<double> &const_rhs) const;
+
+        void save_constraint(const uint64_t key_constraint,
+                             const int maxorder,
+                             const size_t nparams,
+                             const std::vector<ConstraintTypeFix> *const_fix,
+                             const std::vector<ConstraintTypeRelate> *const_relate,
+                             const ConstraintIndexMap *index_map,
+                             const bool extra_constraint_from_symmetry,
+                             const size_t number_of_constraints,
+                             const double * const *const_mat,
+                             const double *const_rhs) const;
+
+        // Hash of the lattice, atomic positions, kinds, spin, periodicity,
+        // symmetry tolerance and the symmetry finder.
+        uint64_t get_key_symmetry(const System *system,
+                                  const double tolerance,
+                                  const bool use_internal_symm_finder) const;
+
+        bool load_symmetry(const uint64_t key_symmetry,
+                           const size_t nat,
+                           std::vector<SymmetryOperation> &symm_data,
+                           std::vector<int> &symnum_tran,
+                           std::vector<std::vector<int>> &map_sym,
+                           std::vector<std::vector<int>> &map_p2s,
+                           std::vector<Maps> &map_s2p,
+                           int &spacegroup_number,
+                           std::string &spacegroup_symbol) const;
+
+        void save_symmetry(const uint64_t key_symmetry,
+                           const std::vector<SymmetryOperation> &symm_data,
+                           const std::vector<int> &symnum_tran,
+                           const std::vector<std::vector<int>> &map_sym,
+                           const std::vector<std::vector<int>> &map_p2s,
+                           const std::vector<Maps> &map_s2p,
+                           const int spacegroup_number,
+                           const std::string &spacegroup_symbol) const;
+
+        // Helpers shared with the other binary files of ALM.
+        static bool fits_in_file(std::ifstream &ifs,
+                                 const uint64_t nitems,
+                                 const size_t nbytes_per_item);
+
+        static bool replace_file(const std::string &file_tmp,
+                                 const std::string &file_out);
+
+        static bool get_file_stamp(const std::string &file_in,
+                                   uint64_t stamp[3]);
+
+    private:
+        static const uint64_t magic_number = 0x45484341434d4c41ULL; // "ALMCACHE"
+        static const uint64_t magic_number_symmetry = 0x434d4d59534d4c41ULL; // "ALMSYMMC"
+        static const int version = 2;
+        static const int version_symmetry = 1;
+
+        std::string filename;
+        std::string filename_symmetry;
+        uint64_t key_structure;
+
+        bool read_header(std::ifstream &ifs,
+                         const int maxorder) const;
+
+        void write_header(std::ofstream &ofs,
+                          const int maxorder) const;
+
+        bool read_fcs_section(std::ifstream &ifs,
+                              const int maxorder,
+                              const size_t nat,
+                              FcPropertyTable *fc_table,
+                              std::vector<size_t> *nequiv,
+                              std::vector<size_t> &nuniq_out) const;
+
+        static void hash_bytes(uint64_t &key,
+                               const void *data,
+                               const size_t nbytes);
+
+        static void hash_file(uint64_t &key,
+                              const std::string &file_in);
+
+        template <typename T>
+        static void hash_value(uint64_t &key,
+                               const T &val)
+        {
+            hash_bytes(key, &val, sizeof(T));
+        }
+
+        template <typename T>
+        static void write_value(std::ofstream &ofs,
+                                const T &val)
+        {
+            ofs.write(reinterpret_cast<const char *>(&val), sizeof(T));
+        }
+
+        template <typename T>
+        static bool read_value(std::ifstream &ifs,
+                               T &val)
+        {
+            ifs.read(reinterpret_cast<char *>(&val), sizeof(T));
+            return static_cast<bool>(ifs);
+        }
+    };
+}
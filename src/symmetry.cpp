@@ -13,6 +13,7 @@
 #include "cluster.h"
 #include "memory.h"
 #include "mathfunctions.h"
+#include "setup_cache.h"
 #include "system.h"
 #include "timer.h"
 #include <cmath>
@@ -43,6 +44,11 @@ double Symmetry::get_tolerance() const
     return tolerance;
 }
 
+bool Symmetry::get_use_internal_symm_finder() const
+{
+    return use_internal_symm_finder;
+}
+
 void Symmetry::set_tolerance(const double tolerance_in)
 {
     tolerance = tolerance_in;
@@ -99,9 +105,62 @@ size_t Symmetry::get_nat_prim() const
     return nat_prim;
 }
 
+const SymmetryOperationSubset& Symmetry::get_symmetry_operations(const std::string &basis,
+                                                                 const bool compatible) const
+{
+    // Return mapping information of atoms and the rotation matrices of symmetry operations
+    // that are (compatible, incompatible) with the given lattice basis (Cartesian or Lattice).
+
+    // compatible == true returns the compatible space group (for creating fc_table)
+    // compatible == false returns the incompatible space group (for creating constraint)
+
+    auto ibasis = 0;
+
+    if (basis == "Cartesian") {
+        ibasis = 0;
+    } else if (basis == "Lattice") {
+        ibasis = 1;
+    } else {
+        exit("get_symmetry_operations", "Invalid basis input");
+    }
+
+    auto &subset = symmop_subset[ibasis][compatible];
+    if (subset.is_set) return subset;
+
+    const auto nat = map_sym.size();
+
+    subset.nsym = 0;
+    subset.nat = nat;
+
+    for (size_t isym = 0; isym < SymmData.size(); ++isym) {
+        const auto &symop = SymmData[isym];
+        const auto compatible_now = ibasis == 0 ? symop.compatible_with_cartesian
+                                                : symop.compatible_with_lattice;
+        if (compatible_now != compatible) continue;
+
+        for (auto i = 0; i < 3; ++i) {
+            for (auto j = 0; j < 3; ++j) {
+                if (ibasis == 0) {
+                    subset.rotation.push_back(symop.rotation_cart[i][j]);
+                } else {
+                    subset.rotation.push_back(static_cast<double>(symop.rotation[i][j]));
+                }
+            }
+        }
+        for (size_t iat = 0; iat < nat; ++iat) {
+            subset.map_sym.push_back(map_sym[iat][isym]);
+        }
+        ++subset.nsym;
+    }
+    subset.is_set = true;
+
+    return subset;
+}
+
 void Symmetry::init(const System *system,
                     const int verbosity,
-                    Timer *timer)
+                    Timer *timer,
+                    const SetupCache *setup_cache)
 {
     timer->start_clock("symmetry");
 
@@ -110,31 +169,82 @@ void Symmetry::init(const System *system,
         std::cout << " ========" << std::endl << std::endl;
     }
 
-    // nat_prim, ntran, nsym, SymmData, symnum_tran are set here.
-    // Symmdata[nsym], symnum_tran[ntran]
-    setup_symmetry_operation(system->get_supercell(),
-                             system->get_periodicity(),
-                             system->get_atomtype_group(),
-                             system->get_spin(),
-                             verbosity);
+    const auto nat = system->get_supercell().number_of_atoms;
+    uint64_t key_cache = 0;
+    auto loaded_from_cache = false;
+
+    if (setup_cache && setup_cache->is_enabled_symmetry()) {
+        key_cache = setup_cache->get_key_symmetry(system, tolerance, use_internal_symm_finder);
+        loaded_from_cache = setup_cache->load_symmetry(key_cache,
+                                                       nat,
+                                                       SymmData,
+                                                       symnum_tran,
+                                                       map_sym,
+                                                       map_p2s,
+                                                       map_s2p,
+                                                       spacegroup_number,
+                                                       spacegroup_symbol);
+    }
 
+    if (loaded_from_cache) {
+        nsym = SymmData.size();
+        ntran = symnum_tran.size();
+        nat_prim = nat / ntran;
 
-    // set_primitive_lattice(system->lavec, system->supercell.number_of_atoms,
-    //                       system->kd, system->xcoord,
-    //                       lavec_prim, nat_prim,
-    //                       kd_prim, xcoord_prim,
-    //                       tolerance);
+        if (verbosity > 0) {
+            if (spacegroup_number > 0) {
+                std::cout << "  Space group: " << spacegroup_symbol << " ("
+                    << std::setw(3) << spacegroup_number << ")" << std::endl;
+            }
+            std::cout << "  Symmetry information is loaded from the symmetry cache ("
+                << setup_cache->get_filename_symmetry() << ")." << std::endl;
+        }
+        write_symmetry_file(verbosity);
 
-    map_sym.clear();
-    map_sym.shrink_to_fit();
-    map_sym.resize(system->get_supercell().number_of_atoms, std::vector<int>(nsym));
+    } else {
 
-    map_p2s.clear();
-    map_p2s.shrink_to_fit();
-    map_p2s.resize(nat_prim, std::vector<int>(ntran));
+        // nat_prim, ntran, nsym, SymmData, symnum_tran are set here.
+        // Symmdata[nsym], symnum_tran[ntran]
+        setup_symmetry_operation(system->get_supercell(),
+                                 system->get_periodicity(),
+                                 system->get_atomtype_group(),
+                                 system->get_spin(),
+                                 verbosity);
+
+
+        // set_primitive_lattice(system->lavec, system->supercell.number_of_atoms,
+        //                       system->kd, system->xcoord,
+        //                       lavec_prim, nat_prim,
+        //                       kd_prim, xcoord_prim,
+        //                       tolerance);
+
+        map_sym.clear();
+        map_sym.shrink_to_fit();
+        map_sym.resize(nat, std::vector<int>(nsym));
+
+        map_p2s.clear();
+        map_p2s.shrink_to_fit();
+        map_p2s.resize(nat_prim, std::vector<int>(ntran));
+
+        gen_mapping_information(system->get_supercell(),
+                                system->get_atomtype_group());
+
+        if (setup_cache) {
+            setup_cache->save_symmetry(key_cache,
+                                       SymmData,
+                                       symnum_tran,
+                                       map_sym,
+                                       map_p2s,
+                                       map_s2p,
+                                       spacegroup_number,
+                                       spacegroup_symbol);
+        }
+    }
 
-    gen_mapping_information(system->get_supercell(),
-                            system->get_atomtype_group());
+    for (auto &it : symmop_subset) {
+        it[0].clear();
+        it[1].clear();
+    }
 
     if (verbosity > 0) {
         print_symminfo_stdout();
@@ -158,6 +268,8 @@ void Symmetry::set_default_variables()
     nat_prim = 0;
     tolerance = 1e-3;
     use_internal_symm_finder = false;
+    spacegroup_number = 0;
+    spacegroup_symbol = "";
 }
 
 void Symmetry::deallocate_variables() {}
@@ -168,54 +280,34 @@ void Symmetry::setup_symmetry_operation(const Cell &cell,
                                         const Spin &spin,
                                         const int verbosity)
 {
-    size_t i, j;
+    size_t i;
 
     SymmData.clear();
+    spacegroup_number = 0;
+    spacegroup_symbol = "";
 
     if (use_internal_symm_finder) {
         // SymmData is written.
         findsym_alm(cell, is_periodic, atomtype_group, spin);
     } else {
-        std::string spgsymbol;
         // SymmData is written.
-        const auto spgnum = findsym_spglib(cell, atomtype_group, spin, spgsymbol);
+        spacegroup_number = findsym_spglib(cell, atomtype_group, spin, spacegroup_symbol);
 
         if (verbosity > 0) {
-            std::cout << "  Space group: " << spgsymbol << " (" << std::setw(3) << spgnum << ")" << std::endl;
+            std::cout << "  Space group: " << spacegroup_symbol << " ("
+                << std::setw(3) << spacegroup_number << ")" << std::endl;
         }
 
     }
 
     // The order in SymmData changes for each run because it was generated
     // with OpenMP. Therefore, we sort the list here to have the same result.
+    // Operations with the same canonical key are removed as duplicates.
     std::sort(SymmData.begin() + 1, SymmData.end());
+    SymmData.erase(std::unique(SymmData.begin() + 1, SymmData.end()), SymmData.end());
     nsym = SymmData.size();
 
-    if (printsymmetry) {
-        std::ofstream ofs_sym;
-        if (verbosity > 0) {
-            std::cout << "  PRINTSYM = 1: Symmetry information will be stored in SYMM_INFO file."
-                << std::endl << std::endl;
-        }
-
-        ofs_sym.open(file_sym.c_str(), std::ios::out);
-        ofs_sym << nsym << std::endl;
-
-        for (auto &p : SymmData) {
-            for (i = 0; i < 3; ++i) {
-                for (j = 0; j < 3; ++j) {
-                    ofs_sym << std::setw(4) << p.rotation[i][j];
-                }
-            }
-            ofs_sym << "  ";
-            for (i = 0; i < 3; ++i) {
-                ofs_sym << std::setprecision(15) << std::setw(21) << p.tran[i];
-            }
-            ofs_sym << std::endl;
-        }
-
-        ofs_sym.close();
-    }
+    write_symmetry_file(verbosity);
 
     ntran = 0;
     for (i = 0; i < nsym; ++i) {
@@ -235,6 +327,36 @@ void Symmetry::setup_symmetry_operation(const Cell &cell,
     }
 }
 
+void Symmetry::write_symmetry_file(const int verbosity) const
+{
+    if (!printsymmetry) return;
+
+    size_t i, j;
+    std::ofstream ofs_sym;
+    if (verbosity > 0) {
+        std::cout << "  PRINTSYM = 1: Symmetry information will be stored in SYMM_INFO file."
+            << std::endl << std::endl;
+    }
+
+    ofs_sym.open(file_sym.c_str(), std::ios::out);
+    ofs_sym << nsym << std::endl;
+
+    for (auto &p : SymmData) {
+        for (i = 0; i < 3; ++i) {
+            for (j = 0; j < 3; ++j) {
+                ofs_sym << std::setw(4) << p.rotation[i][j];
+            }
+        }
+        ofs_sym << "  ";
+        for (i = 0; i < 3; ++i) {
+            ofs_sym << std::setprecision(15) << std::setw(21) << p.tran[i];
+        }
+        ofs_sym << std::endl;
+    }
+
+    ofs_sym.close();
+}
+
 void Symmetry::findsym_alm(const Cell &cell,
                            const int is_periodic[3],
                            const std::vector<std::vector<unsigned int>> &atomtype_group,
@@ -388,27 +510,27 @@ void Symmetry::find_crystal_symmetry(const Cell &cell,
                                      const std::vector<RotationMatrix> &LatticeSymmList)
 {
     unsigned int i, j;
-    unsigned int iat, jat, kat, lat;
+    unsigned int iat, jat;
     double x_rot[3], x_tmp[3];
     double rot[3][3], rot_tmp[3][3], rot_cart[3][3];
     double mag[3], mag_rot[3];
     double tran[3];
-    double x_rot_tmp[3];
-    double tmp[3];
-    double diff;
     const auto nclass = atomtype_group.size();
 
     int rot_int[3][3];
 
     int ii;
-    size_t jj, kk;
+    size_t jj;
     unsigned int itype;
 
-    bool is_found;
     bool isok;
     bool mag_sym1, mag_sym2;
     bool is_identity_matrix;
 
+    std::vector<AtomPositionIndex> atom_index(nclass);
+    for (itype = 0; itype < nclass; ++itype) {
+        atom_index[itype].init(cell.x_fractional, atomtype_group[itype], tolerance);
+    }
 
     // Add identity matrix first.
     for (i = 0; i < 3; ++i) {
@@ -431,9 +553,35 @@ void Symmetry::find_crystal_symmetry(const Cell &cell,
                           is_compatible(rot_cart),
                           is_translation(rot_int));
 
-    for (auto &it_latsym : LatticeSymmList) {
+    // The operations with a given rotation form a coset of the pure
+    // translations. Hence, once a translation compatible with the rotation
+    // is found, the other ones follow from the pure translations without
+    // checking all atoms again.
+    iat = atomtype_group[0][0];
+    const auto ncand = atomtype_group[0].size();
+    std::vector<int> is_allowed(ncand);
+    std::vector<int> index_in_group(cell.number_of_atoms, -1);
+    for (jj = 0; jj < ncand; ++jj) index_in_group[atomtype_group[0][jj]] = jj;
+    std::vector<std::vector<double>> tran_pure;
+
+    for (i = 0; i < 3; ++i) {
+        for (j = 0; j < 3; ++j) {
+            rot[i][j] = (i == j) ? 1.0 : 0.0;
+        }
+    }
+
+    for (jj = 0; jj < ncand; ++jj) {
+        jat = atomtype_group[0][jj];
+        for (i = 0; i < 3; ++i) {
+            tran[i] = cell.x_fractional[jat][i] - cell.x_fractional[iat][i];
+            tran[i] = tran[i] - nint(tran[i]);
+        }
+        if (is_invariant_structure(cell, atomtype_group, atom_index, rot, tran)) {
+            tran_pure.emplace_back(tran, tran + 3);
+        }
+    }
 
-        iat = atomtype_group[0][0];
+    for (auto &it_latsym : LatticeSymmList) {
 
         for (i = 0; i < 3; ++i) {
             for (j = 0; j < 3; ++j) {
@@ -444,9 +592,36 @@ void Symmetry::find_crystal_symmetry(const Cell &cell,
         for (i = 0; i < 3; ++i) x_tmp[i] = cell.x_fractional[iat][i];
         rotvec(x_rot, x_tmp, rot);
 
+        std::fill(is_allowed.begin(), is_allowed.end(), 0);
+
+        int jfound = -1;
+        for (jj = 0; jj < ncand; ++jj) {
+            jat = atomtype_group[0][jj];
+            for (i = 0; i < 3; ++i) {
+                tran[i] = cell.x_fractional[jat][i] - x_rot[i];
+                tran[i] = tran[i] - nint(tran[i]);
+            }
+            if (is_invariant_structure(cell, atomtype_group, atom_index, rot, tran)) {
+                jfound = static_cast<int>(jj);
+                break;
+            }
+        }
+
+        if (jfound == -1) continue;
+
+        const auto jat_found = atomtype_group[0][jfound];
+        is_allowed[jfound] = 1;
+        for (const auto &it_tran : tran_pure) {
+            for (i = 0; i < 3; ++i) {
+                x_tmp[i] = cell.x_fractional[jat_found][i] + it_tran[i];
+            }
+            const auto katom = atom_index[0].find(x_tmp);
+            if (katom != -1) is_allowed[index_in_group[katom]] = 1;
+        }
+
 #ifdef _OPENMP
-#pragma omp parallel for private(jat, tran, isok, kat, x_tmp, x_rot_tmp, is_found, lat, tmp, diff, \
-    i, j, itype, jj, kk, is_identity_matrix, mag, mag_rot, rot_tmp, rot_cart, mag_sym1, mag_sym2)
+#pragma omp parallel for private(jat, tran, isok, \
+    i, j, is_identity_matrix, mag, mag_rot, rot_tmp, rot_cart, mag_sym1, mag_sym2)
 #endif
         for (ii = 0; ii < atomtype_group[0].size(); ++ii) {
             jat = atomtype_group[0][ii];
@@ -468,41 +643,7 @@ void Symmetry::find_crystal_symmetry(const Cell &cell,
                 + std::pow(tran[0], 2) + std::pow(tran[1], 2) + std::pow(tran[2], 2)) < eps12;
             if (is_identity_matrix) continue;
 
-            isok = true;
-
-            for (itype = 0; itype < nclass; ++itype) {
-
-                for (jj = 0; jj < atomtype_group[itype].size(); ++jj) {
-
-                    kat = atomtype_group[itype][jj];
-
-                    for (i = 0; i < 3; ++i) x_tmp[i] = cell.x_fractional[kat][i];
-                    rotvec(x_rot_tmp, x_tmp, rot);
-
-                    for (i = 0; i < 3; ++i) {
-                        x_rot_tmp[i] += tran[i];
-                    }
-
-                    is_found = false;
-
-                    for (kk = 0; kk < atomtype_group[itype].size(); ++kk) {
-
-                        lat = atomtype_group[itype][kk];
-
-                        for (i = 0; i < 3; ++i) {
-                            tmp[i] = std::fmod(std::abs(cell.x_fractional[lat][i] - x_rot_tmp[i]), 1.0);
-                            tmp[i] = std::min<double>(tmp[i], 1.0 - tmp[i]);
-                        }
-                        diff = tmp[0] * tmp[0] + tmp[1] * tmp[1] + tmp[2] * tmp[2];
-                        if (diff < tolerance * tolerance) {
-                            is_found = true;
-                            break;
-                        }
-                    }
-
-                    if (!is_found) isok = false;
-                }
-            }
+            isok = is_allowed[ii];
 
             if (isok) {
                 matmul3(rot_tmp, rot, cell.reciprocal_lattice_vector);
@@ -564,6 +705,29 @@ void Symmetry::find_crystal_symmetry(const Cell &cell,
     }
 }
 
+bool Symmetry::is_invariant_structure(const Cell &cell,
+                                      const std::vector<std::vector<unsigned int>> &atomtype_group,
+                                      const std::vector<AtomPositionIndex> &atom_index,
+                                      const double rot[3][3],
+                                      const double tran[3]) const
+{
+    // Returns true if every atom is mapped onto an atom of the same kind
+    // by the operation {rot|tran} given in fractional coordinates.
+    size_t i;
+    double x_tmp[3], x_rot[3];
+
+    for (size_t itype = 0; itype < atomtype_group.size(); ++itype) {
+        for (const auto &kat : atomtype_group[itype]) {
+            for (i = 0; i < 3; ++i) x_tmp[i] = cell.x_fractional[kat][i];
+            rotvec(x_rot, x_tmp, rot);
+            for (i = 0; i < 3; ++i) x_rot[i] += tran[i];
+
+            if (atom_index[itype].find(x_rot) == -1) return false;
+        }
+    }
+    return true;
+}
+
 int Symmetry::findsym_spglib(const Cell &cell,
                              const std::vector<std::vector<unsigned int>> &atomtype_group,
                              const Spin &spin,
@@ -715,12 +879,10 @@ void Symmetry::gen_mapping_information(const Cell &cell,
 {
     int isym;
     size_t iat, jat;
-    size_t i, j;
+    size_t i;
     size_t itype;
-    size_t ii, jj;
-    double xnew[3], x_tmp[3];
-    double tmp[3], diff;
-    double rot_double[3][3];
+    int ii;
+    double xnew[3];
 
     for (iat = 0; iat < cell.number_of_atoms; ++iat) {
         for (isym = 0; isym < SymmData.size(); ++isym) {
@@ -731,49 +893,111 @@ void Symmetry::gen_mapping_information(const Cell &cell,
     // This part may be incompatible with the tolerance used in spglib
     const auto natomtypes = atomtype_group.size();
 
-#ifdef _OPENMP
-#pragma omp parallel for private(i, j, rot_double, itype, ii, iat, x_tmp, xnew, jj, jat, tmp, diff, isym)
-#endif
-    for (isym = 0; isym < nsym; ++isym) {
+    std::vector<AtomPositionIndex> atom_index(natomtypes);
+    for (itype = 0; itype < natomtypes; ++itype) {
+        atom_index[itype].init(cell.x_fractional, atomtype_group[itype], tolerance);
+    }
 
-        for (i = 0; i < 3; ++i) {
-            for (j = 0; j < 3; ++j) {
-                rot_double[i][j] = static_cast<double>(SymmData[isym].rotation[i][j]);
+    // An operation {R|t} of the supercell is the product of a pure translation
+    // and a representative operation {R|t0} with the same rotation R.
+    // Therefore, map_sym is computed explicitly only for the pure translations
+    // and for one representative of each rotation. The mapping of the other
+    // operations is obtained by composing these two.
+    std::vector<int> rep_of_op(nsym, -1);
+    std::vector<int> tran_of_op(nsym, -1);
+    std::vector<int> ops_direct, ops_composed, ops_rep;
+
+    for (isym = 0; isym < nsym; ++isym) {
+        if (SymmData[isym].is_translation) {
+            ops_direct.push_back(isym);
+            continue;
+        }
+        for (const auto &jsym : ops_rep) {
+            // key[0] is the packed rotation matrix.
+            if (SymmData[isym].key[0] == SymmData[jsym].key[0]) {
+                rep_of_op[isym] = jsym;
+                break;
             }
         }
+        if (rep_of_op[isym] == -1) {
+            ops_rep.push_back(isym);
+            ops_direct.push_back(isym);
+        } else {
+            ops_composed.push_back(isym);
+        }
+    }
 
-        for (itype = 0; itype < natomtypes; ++itype) {
-
-            for (ii = 0; ii < atomtype_group[itype].size(); ++ii) {
-
-                iat = atomtype_group[itype][ii];
+    const auto map_operation = [&](const int isym_in)
+    {
+        double rot_op[3][3], x_orig[3], x_new[3];
 
-                for (i = 0; i < 3; ++i) x_tmp[i] = cell.x_fractional[iat][i];
-                rotvec(xnew, x_tmp, rot_double);
+        for (auto i_ = 0; i_ < 3; ++i_) {
+            for (auto j_ = 0; j_ < 3; ++j_) {
+                rot_op[i_][j_] = static_cast<double>(SymmData[isym_in].rotation[i_][j_]);
+            }
+        }
 
-                for (i = 0; i < 3; ++i) xnew[i] += SymmData[isym].tran[i];
+        for (size_t itype_ = 0; itype_ < natomtypes; ++itype_) {
+            for (const auto &iat_ : atomtype_group[itype_]) {
 
-                for (jj = 0; jj < atomtype_group[itype].size(); ++jj) {
+                for (auto i_ = 0; i_ < 3; ++i_) x_orig[i_] = cell.x_fractional[iat_][i_];
+                rotvec(x_new, x_orig, rot_op);
+                for (auto i_ = 0; i_ < 3; ++i_) x_new[i_] += SymmData[isym_in].tran[i_];
 
-                    jat = atomtype_group[itype][jj];
+                map_sym[iat_][isym_in] = atom_index[itype_].find(x_new);
 
-                    for (i = 0; i < 3; ++i) {
-                        tmp[i] = std::fmod(std::abs(cell.x_fractional[jat][i] - xnew[i]), 1.0);
-                        tmp[i] = std::min<double>(tmp[i], 1.0 - tmp[i]);
-                    }
-                    diff = tmp[0] * tmp[0] + tmp[1] * tmp[1] + tmp[2] * tmp[2];
-                    if (diff < tolerance * tolerance) {
-                        map_sym[iat][isym] = jat;
-                        break;
-                    }
-                }
-                if (map_sym[iat][isym] == -1) {
+                if (map_sym[iat_][isym_in] == -1) {
                     exit("gen_mapping_information",
                          "cannot find symmetry for operation # ",
-                         isym + 1);
+                         isym_in + 1);
                 }
             }
         }
+    };
+
+    const auto ndirect = static_cast<int>(ops_direct.size());
+    const auto ncomposed = static_cast<int>(ops_composed.size());
+
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+    for (isym = 0; isym < ndirect; ++isym) {
+        map_operation(ops_direct[isym]);
+    }
+
+    // Identify the pure translation relating each operation to its
+    // representative through the image of a reference atom.
+    const auto iat_ref = atomtype_group[0][0];
+    std::vector<int> tran_of_atom(cell.number_of_atoms, -1);
+    for (i = 0; i < ntran; ++i) {
+        tran_of_atom[map_sym[iat_ref][symnum_tran[i]]] = symnum_tran[i];
+    }
+
+    for (ii = 0; ii < ncomposed; ++ii) {
+        isym = ops_composed[ii];
+        for (i = 0; i < 3; ++i) {
+            xnew[i] = cell.x_fractional[iat_ref][i]
+                + SymmData[isym].tran[i] - SymmData[rep_of_op[isym]].tran[i];
+        }
+        const auto jat_ref = atom_index[0].find(xnew);
+        if (jat_ref != -1) tran_of_op[isym] = tran_of_atom[jat_ref];
+    }
+
+#ifdef _OPENMP
+#pragma omp parallel for private(iat)
+#endif
+    for (isym = 0; isym < ncomposed; ++isym) {
+        const auto isym_now = ops_composed[isym];
+        const auto isym_rep = rep_of_op[isym_now];
+        const auto isym_tran = tran_of_op[isym_now];
+
+        if (isym_tran == -1) {
+            map_operation(isym_now);
+            continue;
+        }
+        for (iat = 0; iat < cell.number_of_atoms; ++iat) {
+            map_sym[iat][isym_now] = map_sym[map_sym[iat][isym_rep]][isym_tran];
+        }
     }
 
     // Generate map_p2s (primitive --> super)
@@ -903,3 +1127,111 @@ void Symmetry::set_primitive_lattice(const double aa[3][3],
     deallocate(position);
     deallocate(types_tmp);
 }
+
+AtomPositionIndex::AtomPositionIndex()
+{
+    tolerance = 0.0;
+    for (auto i = 0; i < 3; ++i) nbins[i] = 1;
+}
+
+void AtomPositionIndex::init(const std::vector<std::vector<double>> &x_fractional,
+                             const std::vector<unsigned int> &atoms_in,
+                             const double tolerance_in)
+{
+    size_t i;
+    int icrd;
+
+    tolerance = tolerance_in;
+    atoms = atoms_in;
+
+    const auto natoms = atoms.size();
+
+    xf.resize(3 * natoms);
+    for (i = 0; i < natoms; ++i) {
+        for (icrd = 0; icrd < 3; ++icrd) xf[3 * i + icrd] = x_fractional[atoms[i]][icrd];
+    }
+
+    // About one atom per bin, and the bins are not smaller than the tolerance.
+    auto nbin_atoms = static_cast<int>(std::cbrt(static_cast<double>(natoms)));
+    auto nbin_tol = tolerance > 0.0 ? static_cast<int>(1.0 / tolerance) : 1;
+    for (icrd = 0; icrd < 3; ++icrd) {
+        nbins[icrd] = std::max(1, std::min(nbin_atoms, nbin_tol));
+    }
+
+    const auto nbins_all = static_cast<size_t>(nbins[0]) * nbins[1] * nbins[2];
+    std::vector<size_t> ibin(natoms);
+
+    bin_offset.assign(nbins_all + 1, 0);
+    for (i = 0; i < natoms; ++i) {
+        ibin[i] = (static_cast<size_t>(get_bin(xf[3 * i], 0)) * nbins[1]
+            + get_bin(xf[3 * i + 1], 1)) * nbins[2] + get_bin(xf[3 * i + 2], 2);
+        ++bin_offset[ibin[i] + 1];
+    }
+    for (i = 0; i < nbins_all; ++i) bin_offset[i + 1] += bin_offset[i];
+
+    // The entries in each bin are in ascending order of the position in atoms.
+    bin_entries.resize(natoms);
+    std::vector<size_t> bin_fill(bin_offset.begin(), bin_offset.end() - 1);
+    for (i = 0; i < natoms; ++i) bin_entries[bin_fill[ibin[i]]++] = i;
+}
+
+int AtomPositionIndex::get_bin(const double x,
+                               const int icrd) const
+{
+    const auto x_wrap = x - std::floor(x);
+    const auto ibin = static_cast<int>(x_wrap * static_cast<double>(nbins[icrd]));
+    return std::max(0, std::min(ibin, nbins[icrd] - 1));
+}
+
+int AtomPositionIndex::find(const double x[3]) const
+{
+    int icrd, k;
+    int nprobe[3];
+    int ibin_probe[3][3];
+    double tmp[3];
+
+    // Bins to probe along each axis (at most 3, without duplicates)
+    for (icrd = 0; icrd < 3; ++icrd) {
+        const auto ibin = get_bin(x[icrd], icrd);
+        if (nbins[icrd] < 3) {
+            nprobe[icrd] = nbins[icrd];
+            for (k = 0; k < nbins[icrd]; ++k) ibin_probe[icrd][k] = k;
+        } else {
+            nprobe[icrd] = 3;
+            for (k = 0; k < 3; ++k) {
+                ibin_probe[icrd][k] = (ibin + k - 1 + nbins[icrd]) % nbins[icrd];
+            }
+        }
+    }
+
+    // The same criterion as the exhaustive search. If several atoms match,
+    // the first one in the order of atoms is returned.
+    auto ifound = bin_entries.size();
+
+    for (auto ix = 0; ix < nprobe[0]; ++ix) {
+        for (auto iy = 0; iy < nprobe[1]; ++iy) {
+            for (auto iz = 0; iz < nprobe[2]; ++iz) {
+                const auto ib = (static_cast<size_t>(ibin_probe[0][ix]) * nbins[1]
+                    + ibin_probe[1][iy]) * nbins[2] + ibin_probe[2][iz];
+
+                for (auto ip = bin_offset[ib]; ip < bin_offset[ib + 1]; ++ip) {
+                    const auto i = bin_entries[ip];
+                    if (i >= ifound) break;
+
+                    for (icrd = 0; icrd < 3; ++icrd) {
+                        tmp[icrd] = std::fmod(std::abs(xf[3 * i + icrd] - x[icrd]), 1.0);
+                        tmp[icrd] = std::min<double>(tmp[icrd], 1.0 - tmp[icrd]);
+                    }
+                    const auto diff = tmp[0] * tmp[0] + tmp[1] * tmp[1] + tmp[2] * tmp[2];
+                    if (diff < tolerance * tolerance) {
+                        ifound = i;
+                        break;
+                    }
+                }
+            }
+        }
+    }
+
+    if (ifound == bin_entries.size()) return -1;
+    return static_cast<int>(atoms[ifound]);
+}
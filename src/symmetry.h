@@ -12,11 +12,16 @@
 
 #include <string>
 #include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
 #include "system.h"
 #include "timer.h"
 
 namespace ALM_NS
 {
+    class SetupCache;
+
     class SymmetryOperation
     {
     public:
@@ -48,32 +53,43 @@ namespace ALM_NS
             compatible_with_lattice = compatibility_lat;
             compatible_with_cartesian = compatibility_cart;
             is_translation = is_trans_in;
+            set_key();
         }
 
         // Operator definition to sort
         bool operator<(const SymmetryOperation &a) const
         {
-            std::vector<double> v1, v2;
+            return std::lexicographical_compare(key, key + 4, a.key, a.key + 4);
+        }
+
+        bool operator==(const SymmetryOperation &a) const
+        {
+            return std::equal(key, key + 4, a.key);
+        }
+
+        // Canonical key of the operation computed at construction.
+        // key[0] packs the rotation matrix with 7 bits per element, which is
+        // enough for elements in [-64, 63]. key[1:3] are the translations
+        // wrapped into [0, 1) and quantized in units of 2^-40.
+        int64_t key[4];
+
+    private:
+        void set_key()
+        {
+            key[0] = 0;
             for (auto i = 0; i < 3; ++i) {
                 for (auto j = 0; j < 3; ++j) {
-                    v1.push_back(static_cast<double>(rotation[i][j]));
-                    v2.push_back(static_cast<double>(a.rotation[i][j]));
+                    key[0] = (key[0] << 7) | static_cast<int64_t>((rotation[i][j] + 64) & 0x7f);
                 }
             }
+            // The quantization removes the numerical noise of the translations
+            // so that the order does not depend on it.
+            const auto nbins = static_cast<int64_t>(1) << 40;
             for (auto i = 0; i < 3; ++i) {
-                if (tran[i] < 0.0) {
-                    v1.push_back(1.0 + tran[i]);
-                } else {
-                    v1.push_back(tran[i]);
-                }
-                if (a.tran[i] < 0.0) {
-                    v2.push_back(1.0 + a.tran[i]);
-                } else {
-                    v2.push_back(a.tran[i]);
-                }
+                auto itran = std::llround(tran[i] * static_cast<double>(nbins)) % nbins;
+                if (itran < 0) itran += nbins;
+                key[i + 1] = itran;
             }
-            return std::lexicographical_compare(v1.begin(), v1.end(),
-                                                v2.begin(), v2.end());
         }
     };
 
@@ -94,6 +110,43 @@ namespace ALM_NS
         }
     };
 
+    class SymmetryOperationSubset
+    {
+        // Symmetry operations that are compatible (or incompatible) with
+        // a force constant basis. The rotation matrices are given in that
+        // basis, and the atom mapping is stored as [sym][atom] so that
+        // the atoms of one operation are contiguous.
+    public:
+        bool is_set;
+        size_t nsym, nat;
+        std::vector<double> rotation; // [nsym][3][3]
+        std::vector<int> map_sym;     // [nsym][nat]
+
+        SymmetryOperationSubset()
+        {
+            clear();
+        }
+
+        void clear()
+        {
+            nsym = 0;
+            nat = 0;
+            rotation.clear();
+            map_sym.clear();
+            is_set = false;
+        }
+
+        const double* get_rotation(const size_t isym) const
+        {
+            return &rotation[9 * isym];
+        }
+
+        const int* get_map_sym(const size_t isym) const
+        {
+            return &map_sym[nat * isym];
+        }
+    };
+
     class Maps
     {
     public:
@@ -101,6 +154,36 @@ namespace ALM_NS
         int tran_num;
     };
 
+    class AtomPositionIndex
+    {
+        // Spatial hash of the fractional coordinates of a group of atoms
+        // for finding the atom at a given position under the periodic
+        // boundary condition. The unit cell is divided into bins not
+        // smaller than the tolerance, so that only the bins adjacent to
+        // the given position need to be probed.
+    public:
+        AtomPositionIndex();
+
+        void init(const std::vector<std::vector<double>> &x_fractional,
+                  const std::vector<unsigned int> &atoms_in,
+                  const double tolerance_in);
+
+        // Returns the first atom (in the order of atoms_in) whose distance
+        // from x is smaller than the tolerance, or -1 if there is none.
+        int find(const double x[3]) const;
+
+    private:
+        double tolerance;
+        int nbins[3];
+        std::vector<unsigned int> atoms;
+        std::vector<double> xf; // [natoms * 3]
+        std::vector<size_t> bin_offset;
+        std::vector<size_t> bin_entries;
+
+        int get_bin(const double x,
+                    const int icrd) const;
+    };
+
     class Symmetry
     {
     public:
@@ -109,10 +192,12 @@ namespace ALM_NS
 
         void init(const System *system,
                   const int verbosity,
-                  Timer *timer);
+                  Timer *timer,
+                  const SetupCache *setup_cache = nullptr);
 
         double get_tolerance() const;
         void set_tolerance(const double);
+        bool get_use_internal_symm_finder() const;
         int get_print_symmetry() const;
         void set_print_symmetry(const int);
         const std::vector<Maps>& get_map_s2p() const;
@@ -124,6 +209,10 @@ namespace ALM_NS
         size_t get_ntran() const;
         size_t get_nat_prim() const;
 
+        // basis: "Cartesian" or "Lattice". Built on the first request.
+        const SymmetryOperationSubset& get_symmetry_operations(const std::string &basis,
+                                                               const bool compatible) const;
+
     private:
         size_t nsym, ntran, nat_prim;
         std::vector<std::vector<int>> map_sym;   // [nat, nsym]
@@ -131,10 +220,13 @@ namespace ALM_NS
         std::vector<Maps> map_s2p;               // [nat]
         std::vector<SymmetryOperation> SymmData; // [nsym]
         std::vector<int> symnum_tran;            // [ntran]
+        mutable SymmetryOperationSubset symmop_subset[2][2]; // [Cartesian, Lattice][incompatible, compatible]
 
         double tolerance;
         bool use_internal_symm_finder;
         int printsymmetry;
+        int spacegroup_number;         // 0 when the internal finder is used
+        std::string spacegroup_symbol;
 
         void set_default_variables();
         void deallocate_variables();
@@ -144,6 +236,8 @@ namespace ALM_NS
                                       const Spin &,
                                       const int);
 
+        void write_symmetry_file(const int) const;
+
         void gen_mapping_information(const Cell &,
                                      const std::vector<std::vector<unsigned int>> &);
 
@@ -180,6 +274,12 @@ namespace ALM_NS
                                    const Spin &,
                                    const std::vector<RotationMatrix> &);
 
+        bool is_invariant_structure(const Cell &,
+                                    const std::vector<std::vector<unsigned int>> &,
+                                    const std::vector<AtomPositionIndex> &,
+                                    const double [3][3],
+                                    const double [3]) const;
+
         void set_primitive_lattice(const double aa[3][3],
                                    const size_t nat,
                                    const int *kd,
@@ -17,6 +17,9 @@
 #include <iostream>
 #include <iomanip>
 #include <set>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
 
 using namespace ALM_NS;
 
@@ -40,7 +43,9 @@ void System::init(const int verbosity,
     // Set atomic types (kind + magmom)
     set_atomtype_group();
 
-    const auto nneib = 27;
+    set_image_shift();
+
+    const auto nneib = image_shift.size();
     if (x_image) {
         deallocate(x_image);
     }
@@ -52,9 +57,13 @@ void System::init(const int verbosity,
     allocate(exist_image, nneib);
 
     generate_coordinate_of_periodic_images();
+    x_image_soa.set(nneib, nat, x_image);
 
     if (verbosity > 0) {
         print_structure_stdout(supercell);
+        if (nneib > 27) {
+            std::cout << "  Number of periodic images : " << nneib << std::endl << std::endl;
+        }
         if (spin.lspin) print_magmom_stdout();
         timer->print_elapsed();
         std::cout << " -------------------------------------------------------------------" << std::endl;
@@ -178,6 +187,26 @@ double*** System::get_x_image() const
     return x_image;
 }
 
+void System::set_cutoff_radius_of_images(const double rc_in)
+{
+    cutoff_radius_of_images = rc_in;
+}
+
+size_t System::get_number_of_images() const
+{
+    return image_shift.size();
+}
+
+const std::vector<std::vector<int>>& System::get_image_shift() const
+{
+    return image_shift;
+}
+
+const ImageCoordinates& System::get_x_image_soa() const
+{
+    return x_image_soa;
+}
+
 int* System::get_exist_image() const
 {
     return exist_image;
@@ -321,6 +350,7 @@ void System::set_default_variables()
     is_periodic[1] = 1;
     is_periodic[2] = 1;
 
+    cutoff_radius_of_images = -1.0;
     x_image = nullptr;
     exist_image = nullptr;
     str_magmom = "";
@@ -436,70 +466,150 @@ void System::set_atomtype_group()
 }
 
 
-void System::generate_coordinate_of_periodic_images()
+double System::get_covering_radius_bound() const
 {
     //
-    // Generate Cartesian coordinates of atoms in the neighboring 27 supercells
+    // Upper bound of the covering radius of the lattice spanned by the
+    // periodic lattice vectors, i.e., of the largest minimum-image distance.
+    // The basis is first reduced by the pairwise Lagrange-Gauss reduction,
+    // and the bound 1/2 * sqrt(sum_i |b_i^*|^2) of the Gram-Schmidt
+    // vectors of the reduced basis is returned.
     //
 
-    unsigned int i;
-    int ia, ja, ka;
+    int i, j, k;
+    std::vector<std::vector<double>> basis;
 
-    const auto nat = supercell.number_of_atoms;
-    const auto xf_in = supercell.x_fractional;
+    for (i = 0; i < 3; ++i) {
+        if (!is_periodic[i]) continue;
+        std::vector<double> vec(3);
+        for (k = 0; k < 3; ++k) vec[k] = supercell.lattice_vector[k][i];
+        basis.push_back(vec);
+    }
+    const int nbasis = basis.size();
+
+    const auto dot = [](const std::vector<double> &a,
+                        const std::vector<double> &b) {
+        return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+    };
+
+    auto reduced = false;
+    for (auto iter = 0; iter < 100 && !reduced; ++iter) {
+        reduced = true;
+        for (i = 0; i < nbasis; ++i) {
+            for (j = 0; j < nbasis; ++j) {
+                if (i == j) continue;
+                const auto m = std::round(dot(basis[i], basis[j]) / dot(basis[j], basis[j]));
+                if (m == 0.0) continue;
+                for (k = 0; k < 3; ++k) basis[i][k] -= m * basis[j][k];
+                reduced = false;
+            }
+        }
+    }
+    std::sort(basis.begin(), basis.end(),
+              [&](const std::vector<double> &a, const std::vector<double> &b) {
+                  return dot(a, a) < dot(b, b);
+              });
 
-    auto icell = 0;
-    for (i = 0; i < nat; ++i) {
-        for (unsigned int j = 0; j < 3; ++j) {
-            x_image[0][i][j] = xf_in[i][j];
+    double sum = 0.0;
+    for (i = 0; i < nbasis; ++i) {
+        for (j = 0; j < i; ++j) {
+            const auto proj = dot(basis[i], basis[j]) / dot(basis[j], basis[j]);
+            for (k = 0; k < 3; ++k) basis[i][k] -= proj * basis[j][k];
         }
+        sum += dot(basis[i], basis[i]);
     }
-    // Convert to Cartesian coordinate
-    frac2cart(x_image[0]);
 
-    for (ia = -1; ia <= 1; ++ia) {
-        for (ja = -1; ja <= 1; ++ja) {
-            for (ka = -1; ka <= 1; ++ka) {
+    return 0.5 * std::sqrt(sum);
+}
 
-                if (ia == 0 && ja == 0 && ka == 0) continue;
+void System::set_image_shift()
+{
+    //
+    // The neighboring 27 supercells are always included. For a strongly
+    // sheared or elongated supercell, the images beyond them that can hold
+    // the minimum-distance image of an atom, or an atom within the cutoff
+    // radii, are appended after them.
+    //
 
-                ++icell;
-                for (i = 0; i < nat; ++i) {
-                    x_image[icell][i][0] = xf_in[i][0] + static_cast<double>(ia);
-                    x_image[icell][i][1] = xf_in[i][1] + static_cast<double>(ja);
-                    x_image[icell][i][2] = xf_in[i][2] + static_cast<double>(ka);
-                }
-                // Convert to Cartesian coordinate
-                frac2cart(x_image[icell]);
-            }
-        }
-    }
+    int i, ia, ja, ka;
+    int nmax[3];
+    double height[3];
 
-    icell = 0;
-    exist_image[0] = 1;
+    image_shift.clear();
+    image_shift.push_back({0, 0, 0});
 
     for (ia = -1; ia <= 1; ++ia) {
         for (ja = -1; ja <= 1; ++ja) {
             for (ka = -1; ka <= 1; ++ka) {
-
                 if (ia == 0 && ja == 0 && ka == 0) continue;
+                image_shift.push_back({ia, ja, ka});
+            }
+        }
+    }
 
-                ++icell;
+    // The tolerance is that of Cluster::get_images_of_minimum_distance.
+    // The minimum distance between an atom and the images of another atom
+    // never exceeds the covering radius of the superlattice.
+    const auto rneed = std::max(get_covering_radius_bound(), cutoff_radius_of_images) + 1.0e-3;
 
-                // When periodic flag is zero along an axis,
-                // periodic images along that axis cannot be considered.
-                if (((std::abs(ia) == 1) && (is_periodic[0] == 0)) ||
-                    ((std::abs(ja) == 1) && (is_periodic[1] == 0)) ||
-                    ((std::abs(ka) == 1) && (is_periodic[2] == 0))) {
+    // A translation n_i a_i + n_j a_j + n_k a_k moves the points of the
+    // supercell by at least (|n_i| - 1) * height_i from the original supercell,
+    // where height_i is the distance between the planes spanned by a_j and a_k.
+    for (i = 0; i < 3; ++i) {
+        const auto j = (i + 1) % 3;
+        const auto k = (i + 2) % 3;
+        double cross[3];
+        cross[0] = supercell.lattice_vector[1][j] * supercell.lattice_vector[2][k]
+            - supercell.lattice_vector[2][j] * supercell.lattice_vector[1][k];
+        cross[1] = supercell.lattice_vector[2][j] * supercell.lattice_vector[0][k]
+            - supercell.lattice_vector[0][j] * supercell.lattice_vector[2][k];
+        cross[2] = supercell.lattice_vector[0][j] * supercell.lattice_vector[1][k]
+            - supercell.lattice_vector[1][j] * supercell.lattice_vector[0][k];
+        height[i] = std::abs(supercell.volume)
+            / std::sqrt(cross[0] * cross[0] + cross[1] * cross[1] + cross[2] * cross[2]);
+        nmax[i] = is_periodic[i] ? static_cast<int>(rneed / height[i]) + 1 : 0;
+    }
+
+    for (ia = -nmax[0]; ia <= nmax[0]; ++ia) {
+        for (ja = -nmax[1]; ja <= nmax[1]; ++ja) {
+            for (ka = -nmax[2]; ka <= nmax[2]; ++ka) {
+                if (std::abs(ia) <= 1 && std::abs(ja) <= 1 && std::abs(ka) <= 1) continue;
+                if (static_cast<double>(std::abs(ia) - 1) * height[0] > rneed
+                    || static_cast<double>(std::abs(ja) - 1) * height[1] > rneed
+                    || static_cast<double>(std::abs(ka) - 1) * height[2] > rneed) continue;
+                image_shift.push_back({ia, ja, ka});
+            }
+        }
+    }
+}
 
-                    exist_image[icell] = 0;
+void System::generate_coordinate_of_periodic_images()
+{
+    //
+    // Generate Cartesian coordinates of atoms in the periodic images
+    //
 
-                } else {
+    size_t i;
+    int j;
 
-                    exist_image[icell] = 1;
-                }
+    const auto nat = supercell.number_of_atoms;
+    const auto xf_in = supercell.x_fractional;
+
+    for (size_t icell = 0; icell < image_shift.size(); ++icell) {
+        for (i = 0; i < nat; ++i) {
+            for (j = 0; j < 3; ++j) {
+                x_image[icell][i][j] = xf_in[i][j] + static_cast<double>(image_shift[icell][j]);
             }
         }
+        // Convert to Cartesian coordinate
+        frac2cart(x_image[icell]);
+
+        // When periodic flag is zero along an axis,
+        // periodic images along that axis cannot be considered.
+        exist_image[icell] = 1;
+        for (j = 0; j < 3; ++j) {
+            if (image_shift[icell][j] != 0 && is_periodic[j] == 0) exist_image[icell] = 0;
+        }
     }
 }
 
@@ -597,3 +707,64 @@ void System::print_magmom_stdout() const
     }
     cout << endl << endl;
 }
+
+ImageCoordinates::ImageCoordinates()
+{
+    nimage = 0;
+    nat = 0;
+    stride = 0;
+    base = nullptr;
+}
+
+void ImageCoordinates::set(const size_t nimage_in,
+                           const size_t nat_in,
+                           const double * const * const *x_image_in)
+{
+    const size_t nalign = 8; // 64 bytes
+
+    nimage = nimage_in;
+    nat = nat_in;
+    stride = (nat + nalign - 1) / nalign * nalign;
+
+    data.assign(3 * nimage * stride + nalign, 0.0);
+    const auto offset = reinterpret_cast<std::uintptr_t>(&data[0]) % (nalign * sizeof(double));
+    base = &data[0] + (offset == 0 ? 0 : (nalign * sizeof(double) - offset) / sizeof(double));
+
+    for (size_t icell = 0; icell < nimage; ++icell) {
+        for (auto icrd = 0; icrd < 3; ++icrd) {
+            const auto x = base + (3 * icell + icrd) * stride;
+            for (size_t i = 0; i < nat; ++i) x[i] = x_image_in[icell][i][icrd];
+        }
+    }
+}
+
+void ImageCoordinates::get_distances(const double *x0,
+                                     const size_t icell,
+                                     double *dist_out) const
+{
+    get_distances(x0, get(icell, 0), get(icell, 1), get(icell, 2), nat, dist_out);
+}
+
+void ImageCoordinates::get_distances(const double *x0,
+                                     const double *x,
+                                     const double *y,
+                                     const double *z,
+                                     const size_t n,
+                                     double *dist_out)
+{
+    // The arithmetic is the same as Cluster::distance,
+    // so that the results are identical to the scalar version.
+    const auto x0_ = x0[0];
+    const auto y0_ = x0[1];
+    const auto z0_ = x0[2];
+
+#if defined(_OPENMP) && _OPENMP >= 201307
+#pragma omp simd
+#endif
+    for (size_t j = 0; j < n; ++j) {
+        const auto dx = x0_ - x[j];
+        const auto dy = y0_ - y[j];
+        const auto dz = z0_ - z[j];
+        dist_out[j] = std::sqrt(dx * dx + dy * dy + dz * dz);
+    }
+}
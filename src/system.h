@@ -56,6 +56,56 @@ namespace ALM_NS
         std::vector<std::vector<double>> magmom;
     };
 
+    class ImageCoordinates
+    {
+        // Cartesian coordinates of the atoms in the periodic images
+        // in the structure-of-arrays layout. The x, y, and z components
+        // of each image are contiguous arrays aligned to 64 bytes.
+        // Copying is disabled because base points into data.
+    public:
+        ImageCoordinates();
+        ImageCoordinates(const ImageCoordinates &) = delete;
+        ImageCoordinates& operator=(const ImageCoordinates &) = delete;
+
+        void set(const size_t nimage_in,
+                 const size_t nat_in,
+                 const double * const * const *x_image_in);
+
+        size_t get_number_of_images() const
+        {
+            return nimage;
+        }
+
+        size_t get_number_of_atoms() const
+        {
+            return nat;
+        }
+
+        const double* get(const size_t icell,
+                          const int icrd) const
+        {
+            return base + (3 * icell + icrd) * stride;
+        }
+
+        // dist_out[j] = |x_image[icell][j] - x0| for all atoms j
+        void get_distances(const double *x0,
+                           const size_t icell,
+                           double *dist_out) const;
+
+        // dist_out[j] = |(x[j], y[j], z[j]) - x0| for j < n
+        static void get_distances(const double *x0,
+                                  const double *x,
+                                  const double *y,
+                                  const double *z,
+                                  const size_t n,
+                                  double *dist_out);
+
+    private:
+        size_t nimage, nat, stride;
+        std::vector<double> data;
+        double *base;
+    };
+
     class System
     {
     public:
@@ -78,8 +128,15 @@ namespace ALM_NS
                                 const double (*)[3]);
         void set_str_magmom(std::string);
 
+        // Periodic images within this radius are generated in init().
+        // A negative value means that only the minimum distances are needed.
+        void set_cutoff_radius_of_images(const double);
+
         const Cell& get_supercell() const;
+        size_t get_number_of_images() const;
+        const std::vector<std::vector<int>>& get_image_shift() const;
         double*** get_x_image() const;
+        const ImageCoordinates& get_x_image_soa() const;
         int* get_exist_image() const;
         std::string* get_kdname() const;
         int* get_periodicity() const;
@@ -92,7 +149,13 @@ namespace ALM_NS
         Cell supercell;
         std::string *kdname;
         int *is_periodic; // is_periodic[3];
+        double cutoff_radius_of_images;
+        // Lattice translations of the periodic images. The first 27 images are
+        // the neighboring supercells in a fixed order, which is referred to by
+        // the cell indices of Cluster and Writer. Additional images follow.
+        std::vector<std::vector<int>> image_shift;
         double ***x_image;
+        ImageCoordinates x_image_soa;
         int *exist_image;
 
         // Variables for spins
@@ -113,6 +176,8 @@ namespace ALM_NS
                       LatticeType) const;
         void set_atomtype_group();
 
+        double get_covering_radius_bound() const;
+        void set_image_shift();
         void generate_coordinate_of_periodic_images();
         void print_structure_stdout(const Cell &);
         void print_magmom_stdout() const;
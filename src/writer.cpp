@@ -62,6 +62,12 @@ void Writer::write_input_vars(const ALM *alm, const std::string run_mode) const
     for (i = 0; i < 3; ++i) std::cout << std::setw(3) << alm->get_periodicity()[i];
     std::cout << '\n';
     std::cout << "  MAGMOM = " << alm->get_str_magmom() << '\n';
+    if (alm->setup_cache->is_enabled()) {
+        std::cout << "  SETUPCACHE = " << alm->setup_cache->get_filename() << '\n';
+    }
+    if (alm->setup_cache->is_enabled_symmetry()) {
+        std::cout << "  SYMMCACHE = " << alm->setup_cache->get_filename_symmetry() << '\n';
+    }
     //std::cout << "  HESSIAN = " << alm->files->print_hessian << '\n';
     std::cout << '\n';
 
@@ -97,7 +103,11 @@ void Writer::write_input_vars(const ALM *alm, const std::string run_mode) const
         std::cout << "  ICONST = " << alm->constraint->get_constraint_mode() << '\n';
         std::cout << "  ROTAXIS = " << alm->constraint->get_rotation_axis() << '\n';
         std::cout << "  FC2XML = " << alm->constraint->get_fc_file(2) << '\n';
-        std::cout << "  FC3XML = " << alm->constraint->get_fc_file(3) << "\n\n";
+        std::cout << "  FC3XML = " << alm->constraint->get_fc_file(3) << '\n';
+        if (alm->constraint->get_fc_file_binary()) {
+            std::cout << "  FCXML_BIN = 1" << '\n';
+        }
+        std::cout << '\n';
         std::cout << "  SPARSE = " << optctrl.use_sparse_solver << '\n';
         std::cout << "  SPARSESOLVER = " << optctrl.sparsesolver << '\n';
         std::cout << "  CONV_TOL = " << optctrl.tolerance_iteration << '\n';
@@ -153,7 +163,6 @@ void Writer::write_force_constants(ALM *alm) const
     std::string *str_fcs;
     std::ofstream ofs_fcs;
     std::vector<int> atom_tmp;
-    std::vector<std::vector<int>> cell_dummy;
 
     const auto maxorder = alm->cluster->get_maxorder();
 
@@ -198,16 +207,15 @@ void Writer::write_force_constants(ALM *alm) const
 
                 atom_tmp.clear();
                 for (l = 1; l < order + 2; ++l) {
-                    atom_tmp.push_back(alm->fcs->get_fc_table()[order][m].elems[l] / 3);
+                    atom_tmp.push_back(alm->fcs->get_fc_property_table()[order].get_elems(m)[l] / 3);
                 }
-                j = alm->symmetry->get_map_s2p()[alm->fcs->get_fc_table()[order][m].elems[0] / 3].atom_num;
+                j = alm->symmetry->get_map_s2p()[alm->fcs->get_fc_property_table()[order].get_elems(m)[0] / 3].atom_num;
                 std::sort(atom_tmp.begin(), atom_tmp.end());
 
-                const auto iter_cluster
-                    = alm->cluster->get_interaction_cluster(order, j).
-                           find(InteractionCluster(atom_tmp, cell_dummy));
+                const auto &clusters_now = alm->cluster->get_interaction_cluster(order, j);
+                const auto icluster = clusters_now.find(atom_tmp);
 
-                if (iter_cluster == alm->cluster->get_interaction_cluster(order, j).end()) {
+                if (icluster == InteractionClusterTable::npos) {
                     std::cout << std::setw(5) << j;
                     for (l = 0; l < order + 1; ++l) {
                         std::cout << std::setw(5) << atom_tmp[l];
@@ -217,13 +225,13 @@ void Writer::write_force_constants(ALM *alm) const
                          "This cannot happen.");
                 }
 
-                const auto multiplicity = (*iter_cluster).cell.size();
-                const auto distmax = (*iter_cluster).distmax;
+                const auto multiplicity = clusters_now.get_number_of_images(icluster);
+                const auto distmax = clusters_now.get_distmax(icluster);
                 ofs_fcs << std::setw(4) << multiplicity;
 
                 for (l = 0; l < order + 2; ++l) {
                     ofs_fcs << std::setw(7)
-                        << easyvizint(alm->fcs->get_fc_table()[order][m].elems[l]);
+                        << easyvizint(alm->fcs->get_fc_property_table()[order].get_elems(m)[l]);
                 }
                 ofs_fcs << std::setw(12) << std::setprecision(3)
                     << std::fixed << distmax << std::endl;
@@ -265,10 +273,10 @@ void Writer::write_force_constants(ALM *alm) const
 
                 for (j = 0; j < alm->fcs->get_nequiv()[order][iuniq]; ++j) {
                     ofs_fcs << std::setw(5) << j + 1 << std::setw(12)
-                        << std::setprecision(5) << std::fixed << alm->fcs->get_fc_table()[order][id].sign;
+                        << std::setprecision(5) << std::fixed << alm->fcs->get_fc_property_table()[order].get_sign(id);
                     for (k = 0; k < order + 2; ++k) {
                         ofs_fcs << std::setw(6)
-                            << easyvizint(alm->fcs->get_fc_table()[order][id].elems[k]);
+                            << easyvizint(alm->fcs->get_fc_property_table()[order].get_elems(id)[k]);
                     }
                     ofs_fcs << std::endl;
                     ++id;
@@ -453,8 +461,7 @@ void Writer::write_misc_xml(ALM *alm) const
     const auto nelem = alm->cluster->get_maxorder() + 1;
     int *pair_tmp;
     std::vector<int> atom_tmp;
-    std::vector<std::vector<int>> cell_dummy;
-    std::set<InteractionCluster>::iterator iter_cluster;
+    size_t icluster;
     size_t multiplicity;
 
 
@@ -463,27 +470,27 @@ void Writer::write_misc_xml(ALM *alm) const
     for (unsigned int ui = 0; ui < alm->fcs->get_nequiv()[0].size(); ++ui) {
 
         for (i = 0; i < 2; ++i) {
-            pair_tmp[i] = alm->fcs->get_fc_table()[0][ihead].elems[i] / 3;
+            pair_tmp[i] = alm->fcs->get_fc_property_table()[0].get_elems(ihead)[i] / 3;
         }
         j = alm->symmetry->get_map_s2p()[pair_tmp[0]].atom_num;
 
         atom_tmp.clear();
         atom_tmp.push_back(pair_tmp[1]);
 
-        iter_cluster = alm->cluster->get_interaction_cluster(0, j).find(
-            InteractionCluster(atom_tmp, cell_dummy));
-        if (iter_cluster == alm->cluster->get_interaction_cluster(0, j).end()) {
+        const auto &clusters_now = alm->cluster->get_interaction_cluster(0, j);
+        icluster = clusters_now.find(atom_tmp);
+        if (icluster == InteractionClusterTable::npos) {
             exit("load_reference_system_xml",
                  "Cubic force constant is not found.");
         }
 
-        multiplicity = (*iter_cluster).cell.size();
+        multiplicity = clusters_now.get_number_of_images(icluster);
 
         auto &child = pt.add("Data.ForceConstants.HarmonicUnique.FC2",
                              double2string(alm->optimize->get_params()[k]));
         child.put("<xmlattr>.pairs",
-                  std::to_string(alm->fcs->get_fc_table()[0][ihead].elems[0])
-                  + " " + std::to_string(alm->fcs->get_fc_table()[0][ihead].elems[1]));
+                  std::to_string(alm->fcs->get_fc_property_table()[0].get_elems(ihead)[0])
+                  + " " + std::to_string(alm->fcs->get_fc_property_table()[0].get_elems(ihead)[1]));
         child.put("<xmlattr>.multiplicity", multiplicity);
         ihead += alm->fcs->get_nequiv()[0][ui];
         ++k;
@@ -498,7 +505,7 @@ void Writer::write_misc_xml(ALM *alm) const
 
         for (unsigned int ui = 0; ui < alm->fcs->get_nequiv()[1].size(); ++ui) {
             for (i = 0; i < 3; ++i) {
-                pair_tmp[i] = alm->fcs->get_fc_table()[1][ihead].elems[i] / 3;
+                pair_tmp[i] = alm->fcs->get_fc_property_table()[1].get_elems(ihead)[i] / 3;
             }
             j = alm->symmetry->get_map_s2p()[pair_tmp[0]].atom_num;
 
@@ -508,21 +515,21 @@ void Writer::write_misc_xml(ALM *alm) const
             }
             std::sort(atom_tmp.begin(), atom_tmp.end());
 
-            iter_cluster = alm->cluster->get_interaction_cluster(1, j).find(
-                InteractionCluster(atom_tmp, cell_dummy));
-            if (iter_cluster == alm->cluster->get_interaction_cluster(1, j).end()) {
+            const auto &clusters_now = alm->cluster->get_interaction_cluster(1, j);
+            icluster = clusters_now.find(atom_tmp);
+            if (icluster == InteractionClusterTable::npos) {
                 exit("load_reference_system_xml",
                      "Cubic force constant is not found.");
             }
-            multiplicity = (*iter_cluster).cell.size();
+            multiplicity = clusters_now.get_number_of_images(icluster);
 
 
             auto &child = pt.add("Data.ForceConstants.CubicUnique.FC3",
                                  double2string(alm->optimize->get_params()[k]));
             child.put("<xmlattr>.pairs",
-                      std::to_string(alm->fcs->get_fc_table()[1][ihead].elems[0])
-                      + " " + std::to_string(alm->fcs->get_fc_table()[1][ihead].elems[1])
-                      + " " + std::to_string(alm->fcs->get_fc_table()[1][ihead].elems[2]));
+                      std::to_string(alm->fcs->get_fc_property_table()[1].get_elems(ihead)[0])
+                      + " " + std::to_string(alm->fcs->get_fc_property_table()[1].get_elems(ihead)[1])
+                      + " " + std::to_string(alm->fcs->get_fc_property_table()[1].get_elems(ihead)[2]));
             child.put("<xmlattr>.multiplicity", multiplicity);
             ihead += alm->fcs->get_nequiv()[1][ui];
             ++k;
@@ -532,15 +539,19 @@ void Writer::write_misc_xml(ALM *alm) const
     int imult;
     std::string elementname = "Data.ForceConstants.HARMONIC.FC2";
 
-    auto fc_cart_harmonic = alm->fcs->get_fc_cart()[0];
+    std::vector<size_t> index_sorted;
+    const auto &fc_cart_harmonic = *alm->fcs->get_fc_cart_table(0);
+
+    fc_cart_harmonic.sort_index(index_sorted);
 
-    std::sort(fc_cart_harmonic.begin(),
-              fc_cart_harmonic.end());
+    // The cell indices refer to the periodic images of System. The first 27
+    // of them are the neighboring supercells in the order ANPHON assumes.
+    auto has_extra_image = false;
 
-    for (const auto &it : fc_cart_harmonic) {
+    for (const auto ifc : index_sorted) {
 
         for (k = 0; k < 2; ++k) {
-            pair_tmp[k] = it.atoms[k];
+            pair_tmp[k] = fc_cart_harmonic.get_atom(ifc, k);
         }
 
         j = alm->symmetry->get_map_s2p()[pair_tmp[0]].atom_num;
@@ -548,26 +559,28 @@ void Writer::write_misc_xml(ALM *alm) const
         atom_tmp.clear();
         atom_tmp.push_back(pair_tmp[1]);
 
-        iter_cluster = alm->cluster->get_interaction_cluster(0, j).find(
-            InteractionCluster(atom_tmp, cell_dummy));
+        const auto &clusters_now = alm->cluster->get_interaction_cluster(0, j);
+        icluster = clusters_now.find(atom_tmp);
 
-        if (iter_cluster != alm->cluster->get_interaction_cluster(0, j).end()) {
-            multiplicity = (*iter_cluster).cell.size();
+        if (icluster != InteractionClusterTable::npos) {
+            multiplicity = clusters_now.get_number_of_images(icluster);
 
             for (imult = 0; imult < multiplicity; ++imult) {
-                auto cell_now = (*iter_cluster).cell[imult];
+                const auto cell_now = clusters_now.get_cells(icluster, imult);
 
                 auto &child = pt.add(elementname,
-                                     double2string(it.fc_value / static_cast<double>(multiplicity)));
+                                     double2string(fc_cart_harmonic.get_fc_value(ifc)
+                                                   / static_cast<double>(multiplicity)));
 
                 child.put("<xmlattr>.pair1", std::to_string(j + 1)
-                          + " " + std::to_string(it.coords[0] + 1));
+                          + " " + std::to_string(fc_cart_harmonic.get_coord(ifc, 0) + 1));
 
                 for (k = 1; k < 2; ++k) {
                     child.put("<xmlattr>.pair" + std::to_string(k + 1),
                               std::to_string(pair_tmp[k] + 1)
-                              + " " + std::to_string(it.coords[k] + 1)
+                              + " " + std::to_string(fc_cart_harmonic.get_coord(ifc, k) + 1)
                               + " " + std::to_string(cell_now[k - 1] + 1));
+                    if (cell_now[k - 1] >= 27) has_extra_image = true;
                 }
             }
         } else {
@@ -583,20 +596,19 @@ void Writer::write_misc_xml(ALM *alm) const
 
         if (order >= maxorder_to_write) break;
 
-        auto fc_cart_anharm = alm->fcs->get_fc_cart()[order];
+        const auto &fc_cart_anharm = *alm->fcs->get_fc_cart_table(order);
 
-        std::sort(fc_cart_anharm.begin(),
-                  fc_cart_anharm.end());
+        fc_cart_anharm.sort_index(index_sorted);
 
-        for (const auto &it : fc_cart_anharm) {
+        for (const auto ifc : index_sorted) {
 
             // Print force constants only when the coefficient is nonzero
             // and the last (order + 1) elements are sorted in ascending order.
 
-            if (!it.is_ascending_order) continue;
+            if (!fc_cart_anharm.is_ascending_order(ifc)) continue;
 
             for (k = 0; k < order + 2; ++k) {
-                pair_tmp[k] = it.atoms[k];
+                pair_tmp[k] = fc_cart_anharm.get_atom(ifc, k);
             }
             j = alm->symmetry->get_map_s2p()[pair_tmp[0]].atom_num;
 
@@ -611,26 +623,28 @@ void Writer::write_misc_xml(ALM *alm) const
                 + std::to_string(order + 2)
                 + ".FC" + std::to_string(order + 2);
 
-            iter_cluster = alm->cluster->get_interaction_cluster(order, j).find(
-                InteractionCluster(atom_tmp, cell_dummy));
+            const auto &clusters_now = alm->cluster->get_interaction_cluster(order, j);
+            icluster = clusters_now.find(atom_tmp);
 
-            if (iter_cluster != alm->cluster->get_interaction_cluster(order, j).end()) {
-                multiplicity = (*iter_cluster).cell.size();
+            if (icluster != InteractionClusterTable::npos) {
+                multiplicity = clusters_now.get_number_of_images(icluster);
 
                 for (imult = 0; imult < multiplicity; ++imult) {
-                    auto cell_now = (*iter_cluster).cell[imult];
+                    const auto cell_now = clusters_now.get_cells(icluster, imult);
 
                     auto &child = pt.add(elementname,
-                                         double2string(it.fc_value / static_cast<double>(multiplicity)));
+                                         double2string(fc_cart_anharm.get_fc_value(ifc)
+                                                       / static_cast<double>(multiplicity)));
 
                     child.put("<xmlattr>.pair1", std::to_string(j + 1)
-                              + " " + std::to_string(it.coords[0] + 1));
+                              + " " + std::to_string(fc_cart_anharm.get_coord(ifc, 0) + 1));
 
                     for (k = 1; k < order + 2; ++k) {
                         child.put("<xmlattr>.pair" + std::to_string(k + 1),
                                   std::to_string(pair_tmp[k] + 1)
-                                  + " " + std::to_string(it.coords[k] + 1)
+                                  + " " + std::to_string(fc_cart_anharm.get_coord(ifc, k) + 1)
                                   + " " + std::to_string(cell_now[k - 1] + 1));
+                        if (cell_now[k - 1] >= 27) has_extra_image = true;
                     }
                 }
             } else {
@@ -640,6 +654,22 @@ void Writer::write_misc_xml(ALM *alm) const
         ishift += alm->fcs->get_nequiv()[order].size();
     }
 
+    if (has_extra_image) {
+        // The lattice translations of all images are written so that
+        // the cell indices larger than 27 can be resolved by the reader.
+        const auto &image_shift = alm->get_image_shift();
+        pt.put("Data.Structure.PeriodicImages.NumberOfImages", image_shift.size());
+        for (i = 0; i < image_shift.size(); ++i) {
+            str_tmp.clear();
+            for (j = 0; j < 3; ++j) str_tmp += " " + std::to_string(image_shift[i][j]);
+            auto &child = pt.add("Data.Structure.PeriodicImages.image", str_tmp);
+            child.put("<xmlattr>.index", i + 1);
+        }
+        warn("write_misc_xml",
+             "Some force constants involve periodic images beyond the neighboring supercells.\n"
+             " Their lattice translations are given in Data.Structure.PeriodicImages of the XML file.");
+    }
+
     using namespace boost::property_tree::xml_parser;
     const auto indent = 2;
 
@@ -679,15 +709,18 @@ void Writer::write_hessian(ALM *alm) const
         }
     }
 
-    for (const auto &it : alm->fcs->get_fc_cart()[0]) {
+    const auto &fc_cart_harmonic = *alm->fcs->get_fc_cart_table(0);
+
+    for (size_t ifc = 0; ifc < fc_cart_harmonic.size(); ++ifc) {
 
-        for (i = 0; i < 2; ++i) pair_tmp[i] = it.atoms[i];
+        for (i = 0; i < 2; ++i) pair_tmp[i] = fc_cart_harmonic.get_atom(ifc, i);
 
         for (size_t itran = 0; itran < alm->symmetry->get_ntran(); ++itran) {
             for (i = 0; i < 2; ++i) {
                 pair_tran[i] = alm->symmetry->get_map_sym()[pair_tmp[i]][alm->symmetry->get_symnum_tran()[itran]];
             }
-            hessian[3 * pair_tran[0] + it.coords[0]][3 * pair_tran[1] + it.coords[1]] = it.fc_value;
+            hessian[3 * pair_tran[0] + fc_cart_harmonic.get_coord(ifc, 0)]
+                [3 * pair_tran[1] + fc_cart_harmonic.get_coord(ifc, 1)] = fc_cart_harmonic.get_fc_value(ifc);
         }
     }
 
@@ -741,14 +774,17 @@ void Writer::write_in_QEformat(ALM *alm) const
             hessian[i][j] = 0.0;
         }
     }
-    for (const auto &it : alm->fcs->get_fc_cart()[0]) {
+    const auto &fc_cart_harmonic = *alm->fcs->get_fc_cart_table(0);
 
-        for (i = 0; i < 2; ++i) pair_tmp[i] = it.atoms[i];
+    for (size_t ifc = 0; ifc < fc_cart_harmonic.size(); ++ifc) {
+
+        for (i = 0; i < 2; ++i) pair_tmp[i] = fc_cart_harmonic.get_atom(ifc, i);
         for (size_t itran = 0; itran < alm->symmetry->get_ntran(); ++itran) {
             for (i = 0; i < 2; ++i) {
                 pair_tran[i] = alm->symmetry->get_map_sym()[pair_tmp[i]][alm->symmetry->get_symnum_tran()[itran]];
             }
-            hessian[3 * pair_tran[0] + it.coords[0]][3 * pair_tran[1] + it.coords[1]] = it.fc_value;
+            hessian[3 * pair_tran[0] + fc_cart_harmonic.get_coord(ifc, 0)]
+                [3 * pair_tran[1] + fc_cart_harmonic.get_coord(ifc, 1)] = fc_cart_harmonic.get_fc_value(ifc);
         }
     }
 
@@ -792,10 +828,8 @@ void Writer::write_fc3_thirdorderpy_format(ALM *alm) const
     const auto ntran = alm->symmetry->get_ntran();
 
     std::vector<int> atom_tmp;
-    std::vector<std::vector<int>> cell_dummy;
-    std::set<InteractionCluster>::iterator iter_cluster;
+    size_t icluster;
     atom_tmp.resize(2);
-    cell_dummy.resize(2);
 
     double ***x_image = alm->get_x_image();
 
@@ -819,13 +853,18 @@ void Writer::write_fc3_thirdorderpy_format(ALM *alm) const
 
     const auto ishift = alm->fcs->get_nequiv()[0].size();
 
-    for (const auto &it : alm->fcs->get_fc_cart()[1]) {
+    const auto &fc_cart_cubic = *alm->fcs->get_fc_cart_table(1);
+
+    for (size_t ifc = 0; ifc < fc_cart_cubic.size(); ++ifc) {
+
+        if (!fc_cart_cubic.is_ascending_order(ifc)) continue;
 
-        if (!it.is_ascending_order) continue;
+        const auto flattenarray = fc_cart_cubic.get_flattenarray(ifc);
+        const auto fc_value = fc_cart_cubic.get_fc_value(ifc);
 
         for (i = 0; i < 3; ++i) {
-            pair_tmp[i] = it.atoms[i];
-            coord_tmp[i] = it.coords[i];
+            pair_tmp[i] = fc_cart_cubic.get_atom(ifc, i);
+            coord_tmp[i] = fc_cart_cubic.get_coord(ifc, i);
         }
 
         j = alm->symmetry->get_map_s2p()[pair_tmp[0]].atom_num;
@@ -837,20 +876,21 @@ void Writer::write_fc3_thirdorderpy_format(ALM *alm) const
             atom_tmp[0] = pair_tmp[1];
             atom_tmp[1] = pair_tmp[2];
         }
-        iter_cluster = alm->cluster->get_interaction_cluster(1, j).find(InteractionCluster(atom_tmp, cell_dummy));
+        const auto &clusters_now = alm->cluster->get_interaction_cluster(1, j);
+        icluster = clusters_now.find(atom_tmp);
 
         if (!has_element[j][pair_tmp[1]][pair_tmp[2]]) {
-            nelems += (*iter_cluster).cell.size();
+            nelems += clusters_now.get_number_of_images(icluster);
             has_element[j][pair_tmp[1]][pair_tmp[2]] = 1;
         }
-        fc3[3 * j + coord_tmp[0]][it.flattenarray[1]][it.flattenarray[2]] = it.fc_value;
+        fc3[3 * j + coord_tmp[0]][flattenarray[1]][flattenarray[2]] = fc_value;
 
-        if (it.flattenarray[1] != it.flattenarray[2]) {
+        if (flattenarray[1] != flattenarray[2]) {
             if (!has_element[j][pair_tmp[2]][pair_tmp[1]]) {
-                nelems += (*iter_cluster).cell.size();
+                nelems += clusters_now.get_number_of_images(icluster);
                 has_element[j][pair_tmp[2]][pair_tmp[1]] = 1;
             }
-            fc3[3 * j + coord_tmp[0]][it.flattenarray[2]][it.flattenarray[1]] = it.fc_value;
+            fc3[3 * j + coord_tmp[0]][flattenarray[2]][flattenarray[1]] = fc_value;
         }
     }
 
@@ -886,13 +926,13 @@ void Writer::write_fc3_thirdorderpy_format(ALM *alm) const
                             swapped = false;
                         }
 
-                        iter_cluster = alm->cluster->get_interaction_cluster(1, i).find(
-                            InteractionCluster(atom_tmp, cell_dummy));
-                        if (iter_cluster == alm->cluster->get_interaction_cluster(1, i).end()) {
+                        const auto &clusters_now = alm->cluster->get_interaction_cluster(1, i);
+                        icluster = clusters_now.find(atom_tmp);
+                        if (icluster == InteractionClusterTable::npos) {
                             exit("write_misc_xml", "This cannot happen.");
                         }
 
-                        const auto multiplicity = (*iter_cluster).cell.size();
+                        const auto multiplicity = clusters_now.get_number_of_images(icluster);
 
                         const auto jat0 = alm->symmetry->get_map_p2s()[alm->symmetry->get_map_s2p()[atom_tmp[0]].
                             atom_num][0];
@@ -900,7 +940,7 @@ void Writer::write_fc3_thirdorderpy_format(ALM *alm) const
                             atom_num][0];
 
                         for (size_t imult = 0; imult < multiplicity; ++imult) {
-                            auto cell_now = (*iter_cluster).cell[imult];
+                            const auto cell_now = clusters_now.get_cells(icluster, imult);
 
                             for (auto m = 0; m < 3; ++m) {
                                 vec1[m] = (x_image[0][atom_tmp[0]][m]
@@ -0,0 +1,438 @@
+/*
+ xml_parser.cpp
+
+ Copyright (c) 2014 Terumasa Tadano
+
+ This file is distributed under the terms of the MIT license.
+ Please see the file 'LICENCE.txt' in the root directory
+ or http://opensource.org/licenses/mit-license.php for information.
+*/
+
+#include "xml_parser.h"
+#include "setup_cache.h"
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+
+using namespace ALM_NS;
+
+bool XmlStreamParser::parse(std::istream &is,
+                            XmlStreamHandler &handler) const
+{
+    auto sb = is.rdbuf();
+    const auto eof = std::char_traits<char>::eof();
+
+    std::vector<std::string> stack;
+    std::vector<std::pair<std::string, std::string>> attributes;
+    std::string text, name, attr_name, attr_value;
+    int c;
+
+    const auto is_space = [](const int ch)
+    {
+        return ch == ' ' || ch == '\t' || ch == '\n' || ch == '\r';
+    };
+
+    while ((c = sb->sbumpc()) != eof) {
+
+        if (c != '<') {
+            text.push_back(static_cast<char>(c));
+            continue;
+        }
+
+        c = sb->sbumpc();
+        if (c == eof) return false;
+
+        if (c == '?') {
+            // Processing instruction
+            int prev = 0;
+            while ((c = sb->sbumpc()) != eof) {
+                if (prev == '?' && c == '>') break;
+                prev = c;
+            }
+            if (c == eof) return false;
+
+        } else if (c == '!') {
+            // Comment, CDATA, or DOCTYPE
+            std::string head;
+            while (head.size() < 7 && (c = sb->sgetc()) != eof) {
+                head.push_back(static_cast<char>(c));
+                sb->sbumpc();
+                if (head == "--" || head == "[CDATA[") break;
+            }
+            if (head == "--") {
+                int prev2 = 0, prev = 0;
+                while ((c = sb->sbumpc()) != eof) {
+                    if (prev2 == '-' && prev == '-' && c == '>') break;
+                    prev2 = prev;
+                    prev = c;
+                }
+            } else if (head == "[CDATA[") {
+                std::string cdata;
+                while ((c = sb->sbumpc()) != eof) {
+                    cdata.push_back(static_cast<char>(c));
+                    const auto n = cdata.size();
+                    if (n >= 3 && cdata.compare(n - 3, 3, "]]>") == 0) {
+                        cdata.resize(n - 3);
+                        break;
+                    }
+                }
+                // Protect '&' from decode_entities
+                for (const auto ch : cdata) {
+                    if (ch == '&') {
+                        text += "&amp;";
+                    } else {
+                        text.push_back(ch);
+                    }
+                }
+            } else {
+                auto depth = 1;
+                for (const auto ch : head) {
+                    if (ch == '<') ++depth;
+                    if (ch == '>') --depth;
+                }
+                while (depth > 0 && (c = sb->sbumpc()) != eof) {
+                    if (c == '<') ++depth;
+                    if (c == '>') --depth;
+                }
+            }
+            if (c == eof) return false;
+
+        } else if (c == '/') {
+            // End tag
+            name.clear();
+            while ((c = sb->sbumpc()) != eof && c != '>') {
+                if (!is_space(c)) name.push_back(static_cast<char>(c));
+            }
+            if (c == eof || stack.empty() || stack.back() != name) return false;
+            decode_entities(text);
+            handler.end_element(name, text);
+            stack.pop_back();
+            text.clear();
+
+        } else {
+            // Start tag
+            name.clear();
+            while (c != eof && !is_space(c) && c != '/' && c != '>') {
+                name.push_back(static_cast<char>(c));
+                c = sb->sbumpc();
+            }
+            attributes.clear();
+            auto self_closing = false;
+
+            while (c != eof && c != '>') {
+                if (c == '/') {
+                    self_closing = true;
+                } else if (!is_space(c)) {
+                    attr_name.clear();
+                    while (c != eof && c != '=' && !is_space(c)) {
+                        attr_name.push_back(static_cast<char>(c));
+                        c = sb->sbumpc();
+                    }
+                    while (c != eof && c != '\'' && c != '"') c = sb->sbumpc();
+                    if (c == eof) return false;
+                    const auto quote = c;
+                    attr_value.clear();
+                    while ((c = sb->sbumpc()) != eof && c != quote) {
+                        attr_value.push_back(static_cast<char>(c));
+                    }
+                    if (c == eof) return false;
+                    decode_entities(attr_value);
+                    attributes.emplace_back(attr_name, attr_value);
+                }
+                c = sb->sbumpc();
+            }
+            if (c == eof || name.empty()) return false;
+
+            handler.start_element(name, attributes);
+            text.clear();
+            if (self_closing) {
+                handler.end_element(name, text);
+            } else {
+                stack.push_back(name);
+            }
+        }
+    }
+
+    return stack.empty();
+}
+
+void XmlStreamParser::decode_entities(std::string &str)
+{
+    auto pos = str.find('&');
+    if (pos == std::string::npos) return;
+
+    std::string out;
+    out.reserve(str.size());
+    out.append(str, 0, pos);
+
+    while (pos < str.size()) {
+        if (str[pos] != '&') {
+            out.push_back(str[pos++]);
+            continue;
+        }
+        const auto end = str.find(';', pos);
+        if (end == std::string::npos) {
+            out.append(str, pos, std::string::npos);
+            break;
+        }
+        const auto entity = str.substr(pos + 1, end - pos - 1);
+        if (entity == "lt") {
+            out.push_back('<');
+        } else if (entity == "gt") {
+            out.push_back('>');
+        } else if (entity == "amp") {
+            out.push_back('&');
+        } else if (entity == "quot") {
+            out.push_back('"');
+        } else if (entity == "apos") {
+            out.push_back('\'');
+        } else if (!entity.empty() && entity[0] == '#') {
+            const auto code = (entity.size() > 1 && (entity[1] == 'x' || entity[1] == 'X'))
+                                  ? std::strtol(entity.c_str() + 2, nullptr, 16)
+                                  : std::strtol(entity.c_str() + 1, nullptr, 10);
+            out.push_back(static_cast<char>(code));
+        } else {
+            out.append(str, pos, end - pos + 1);
+        }
+        pos = end + 1;
+    }
+    str.swap(out);
+}
+
+namespace ALM_NS
+{
+    class UniqueFcHandler : public XmlStreamHandler
+    {
+        // Collects the entries needed by Constraint::fix_forceconstants_to_file.
+    public:
+        UniqueFcHandler(const int order,
+                        UniqueFcData &fc_in) : fc(fc_in)
+        {
+            if (order == 0) {
+                path_unique = "Data.ForceConstants.HarmonicUnique";
+                tag_nfc = "NFC2";
+                tag_fc = "FC2";
+            } else {
+                path_unique = "Data.ForceConstants.CubicUnique";
+                tag_nfc = "NFC3";
+                tag_fc = "FC3";
+            }
+            fc.nelems = order + 2;
+            found_nat = found_ntran = found_nfcs = false;
+        }
+
+        void start_element(const std::string &name,
+                           const std::vector<std::pair<std::string, std::string>> &attributes) override
+        {
+            path_len.push_back(path.size());
+            if (!path.empty()) path.push_back('.');
+            path += name;
+
+            if (name == tag_fc && path.size() == path_unique.size() + tag_fc.size() + 1
+                && path.compare(0, path_unique.size(), path_unique) == 0) {
+                const char *pairs = nullptr;
+                for (const auto &it : attributes) {
+                    if (it.first == "pairs") pairs = it.second.c_str();
+                }
+                if (!pairs) return;
+                auto ptr = pairs;
+                char *endptr;
+                for (auto i = 0; i < fc.nelems; ++i) {
+                    fc.elems.push_back(static_cast<int>(std::strtol(ptr, &endptr, 10)));
+                    ptr = endptr;
+                }
+                in_fc = true;
+            }
+        }
+
+        void end_element(const std::string &,
+                         const std::string &text) override
+        {
+            if (in_fc) {
+                fc.values.push_back(std::strtod(text.c_str(), nullptr));
+                in_fc = false;
+            } else if (path == "Data.Structure.NumberOfAtoms") {
+                fc.nat = std::strtoul(text.c_str(), nullptr, 10);
+                found_nat = true;
+            } else if (path == "Data.Symmetry.NumberOfTranslations") {
+                fc.ntran = std::strtoul(text.c_str(), nullptr, 10);
+                found_ntran = true;
+            } else if (path.size() > path_unique.size()
+                && path.compare(0, path_unique.size(), path_unique) == 0) {
+                const auto leaf = path.substr(path_unique.size() + 1);
+                if (leaf == tag_nfc) {
+                    fc.nfcs = std::strtoul(text.c_str(), nullptr, 10);
+                    found_nfcs = true;
+                } else if (leaf == "Basis") {
+                    fc.basis = trim(text);
+                }
+            }
+            path.resize(path_len.back());
+            path_len.pop_back();
+        }
+
+        void check_missing_entries() const
+        {
+            fc.missing_entries.clear();
+            if (!found_nat) fc.missing_entries.emplace_back("Data.Structure.NumberOfAtoms");
+            if (!found_ntran) fc.missing_entries.emplace_back("Data.Symmetry.NumberOfTranslations");
+            if (!found_nfcs) fc.missing_entries.push_back(path_unique + "." + tag_nfc);
+        }
+
+    private:
+        UniqueFcData &fc;
+        std::string path_unique, tag_nfc, tag_fc;
+        std::string path;
+        std::vector<size_t> path_len;
+        bool in_fc = false;
+        bool found_nat, found_ntran, found_nfcs;
+
+        static std::string trim(const std::string &str)
+        {
+            const auto first = str.find_first_not_of(" \t\n\r");
+            if (first == std::string::npos) return "";
+            const auto last = str.find_last_not_of(" \t\n\r");
+            return str.substr(first, last - first + 1);
+        }
+    };
+}
+
+bool ALM_NS::read_unique_fcs_xml(const std::string &file_xml,
+                                 const int order,
+                                 UniqueFcData &fc_out)
+{
+    std::ifstream ifs(file_xml.c_str(), std::ios::in | std::ios::binary);
+    if (!ifs) return false;
+
+    fc_out = UniqueFcData();
+    UniqueFcHandler handler(order, fc_out);
+    XmlStreamParser parser;
+
+    if (!parser.parse(ifs, handler)) return false;
+    handler.check_missing_entries();
+
+    return true;
+}
+
+namespace
+{
+    const uint64_t sidecar_magic = 0x4e49424c4d584346ULL; // "FCXMLBIN"
+    const int sidecar_version = 3;
+
+    std::string get_sidecar_name(const std::string &file_xml,
+                                 const int order)
+    {
+        return file_xml + ".fc" + std::to_string(order + 2) + ".bin";
+    }
+
+    template <typename T>
+    bool read_binary(std::ifstream &ifs,
+                     T *val,
+                     const size_t n = 1)
+    {
+        ifs.read(reinterpret_cast<char *>(val), sizeof(T) * n);
+        return static_cast<bool>(ifs);
+    }
+
+    template <typename T>
+    void write_binary(std::ofstream &ofs,
+                      const T *val,
+                      const size_t n = 1)
+    {
+        ofs.write(reinterpret_cast<const char *>(val), sizeof(T) * n);
+    }
+}
+
+bool ALM_NS::read_unique_fcs_binary(const std::string &file_xml,
+                                    const int order,
+                                    UniqueFcData &fc_out)
+{
+    uint64_t stamp_xml[3], stamp_ref[3], magic, nat, ntran, nfcs, nbasis;
+    int version, order_ref;
+
+    if (!SetupCache::get_file_stamp(file_xml, stamp_xml)) return false;
+
+    std::ifstream ifs(get_sidecar_name(file_xml, order).c_str(), std::ios::in | std::ios::binary);
+    if (!ifs) return false;
+
+    if (!read_binary(ifs, &magic) || magic != sidecar_magic) return false;
+    if (!read_binary(ifs, &version) || version != sidecar_version) return false;
+    if (!read_binary(ifs, stamp_ref, 3)) return false;
+    if (stamp_ref[0] != stamp_xml[0] || stamp_ref[1] != stamp_xml[1]
+        || stamp_ref[2] != stamp_xml[2]) return false;
+    if (!read_binary(ifs, &order_ref) || order_ref != order) return false;
+    if (!read_binary(ifs, &nat) || !read_binary(ifs, &ntran)
+        || !read_binary(ifs, &nfcs) || !read_binary(ifs, &nbasis)) {
+        return false;
+    }
+
+    // The counts must be consistent with the remaining size of the file.
+    if (!SetupCache::fits_in_file(ifs, nbasis, sizeof(char))) return false;
+    if (!SetupCache::fits_in_file(ifs, nfcs,
+                                  (order + 2) * sizeof(int) + sizeof(double))) {
+        return false;
+    }
+
+    UniqueFcData fc_tmp;
+    fc_tmp.nat = nat;
+    fc_tmp.ntran = ntran;
+    fc_tmp.nfcs = nfcs;
+    fc_tmp.nelems = order + 2;
+    fc_tmp.basis.resize(nbasis);
+    fc_tmp.elems.resize(nfcs * fc_tmp.nelems);
+    fc_tmp.values.resize(nfcs);
+
+    if (nbasis > 0 && !read_binary(ifs, &fc_tmp.basis[0], nbasis)) return false;
+    if (nfcs > 0) {
+        if (!read_binary(ifs, &fc_tmp.elems[0], fc_tmp.elems.size())) return false;
+        if (!read_binary(ifs, &fc_tmp.values[0], nfcs)) return false;
+    }
+
+    fc_out = std::move(fc_tmp);
+    return true;
+}
+
+void ALM_NS::write_unique_fcs_binary(const std::string &file_xml,
+                                     const int order,
+                                     const UniqueFcData &fc_in)
+{
+    uint64_t stamp_xml[3];
+
+    if (!SetupCache::get_file_stamp(file_xml, stamp_xml)) return;
+    if (!fc_in.missing_entries.empty() || fc_in.values.size() != fc_in.nfcs) return;
+
+    // Write to a temporary file first so that an interrupted or concurrent
+    // run never leaves a partially written sidecar.
+    const auto file_bin = get_sidecar_name(file_xml, order);
+    const auto file_tmp = file_bin + ".tmp";
+    std::ofstream ofs(file_tmp.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!ofs) return;
+
+    const uint64_t nat = fc_in.nat;
+    const uint64_t ntran = fc_in.ntran;
+    const uint64_t nfcs = fc_in.nfcs;
+    const uint64_t nbasis = fc_in.basis.size();
+
+    write_binary(ofs, &sidecar_magic);
+    write_binary(ofs, &sidecar_version);
+    write_binary(ofs, stamp_xml, 3);
+    write_binary(ofs, &order);
+    write_binary(ofs, &nat);
+    write_binary(ofs, &ntran);
+    write_binary(ofs, &nfcs);
+    write_binary(ofs, &nbasis);
+    if (nbasis > 0) write_binary(ofs, fc_in.basis.data(), nbasis);
+    if (nfcs > 0) {
+        write_binary(ofs, fc_in.elems.data(), fc_in.elems.size());
+        write_binary(ofs, fc_in.values.data(), nfcs);
+    }
+    ofs.close();
+
+    if (!ofs) {
+        std::remove(file_tmp.c_str());
+        return;
+    }
+    SetupCache::replace_file(file_tmp, file_bin);
+}
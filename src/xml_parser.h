@@ -12,6 +12,8 @@
 
 #include <string>
 #include <iostream>
+#include <utility>
+#include <vector>
 #include <boost/property_tree/ptree.hpp>
 #include <boost/optional.hpp>
 
@@ -30,3 +32,65 @@ inline std::string get_value_from_xml(const boost::property_tree::ptree &pt_in,
         }
     }
 }
+
+namespace ALM_NS
+{
+    class XmlStreamHandler
+    {
+        // Callbacks of XmlStreamParser.
+        // text is the character data directly enclosed by the element.
+    public:
+        virtual ~XmlStreamHandler() = default;
+        virtual void start_element(const std::string &name,
+                                   const std::vector<std::pair<std::string, std::string>> &attributes) = 0;
+        virtual void end_element(const std::string &name,
+                                 const std::string &text) = 0;
+    };
+
+    class XmlStreamParser
+    {
+        // Minimal SAX-style XML parser. The input is read sequentially and
+        // the handler is called for each element, so that the document
+        // tree is never held in memory.
+        // Processing instructions, comments, and DOCTYPE are skipped.
+    public:
+        // Returns false if the document is not well-formed.
+        bool parse(std::istream &is,
+                   XmlStreamHandler &handler) const;
+
+    private:
+        static void decode_entities(std::string &str);
+    };
+
+    class UniqueFcData
+    {
+        // Irreducible force constants of a given order read from
+        // the XML file written by ALM (HarmonicUnique or CubicUnique).
+    public:
+        size_t nat, ntran, nfcs;
+        std::string basis;             // empty if not given
+        int nelems;                    // order + 2
+        std::vector<int> elems;        // [nfcs * nelems], flattened indices
+        std::vector<double> values;    // [nfcs]
+        std::vector<std::string> missing_entries;
+
+        UniqueFcData() : nat(0), ntran(0), nfcs(0), nelems(0) {}
+    };
+
+    // Streaming reader of the unique force constants in FC2XML/FC3XML.
+    // Returns false if the file cannot be opened or parsed.
+    bool read_unique_fcs_xml(const std::string &file_xml,
+                             const int order,
+                             UniqueFcData &fc_out);
+
+    // Binary sidecar (file_xml + ".fc2.bin" or ".fc3.bin") of the above data.
+    // The sidecar is valid only when the size and the modification time
+    // (with sub-second resolution where available) of file_xml are unchanged.
+    bool read_unique_fcs_binary(const std::string &file_xml,
+                                const int order,
+                                UniqueFcData &fc_out);
+
+    void write_unique_fcs_binary(const std::string &file_xml,
+                                 const int order,
+                                 const UniqueFcData &fc_in);
+}
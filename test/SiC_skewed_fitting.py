@@ -0,0 +1,91 @@
+#!/usr/bin/env python
+# coding: utf-8
+
+# The 64-atom SiC supercell of SiC_fitting.py written with the sheared
+# basis a2 -> a2 + 2 a1. The minimum-distance images of some atoms lie
+# beyond the 27 neighboring supercells in this setting.
+#
+# Both settings are fitted with the alm executable (given by the ALM
+# environment variable, or found in PATH), and the distances and
+# multiplicities of the harmonic and cubic terms in the .fcs files are
+# compared. They are properties of the crystal and must not depend on the
+# basis. The harmonic cutoff of the cubic fit exceeds the covering radius
+# of the supercell, so that the periodic images are generated for the
+# cutoff radius.
+
+import os
+import shutil
+import subprocess
+import tempfile
+import numpy as np
+
+
+lavec = np.loadtxt('lavec.dat')
+xcoord = np.loadtxt('xcoord.dat')
+kd = np.loadtxt('kd.dat').astype(int)
+force = np.loadtxt("sic_force.dat").reshape((-1, 64, 3))
+disp = np.loadtxt("sic_disp.dat").reshape((-1, 64, 3))
+
+# Basis vectors are row vectors.
+lavec_skew = lavec.copy()
+lavec_skew[1] += 2.0 * lavec[0]
+xcoord_skew = np.dot(np.dot(xcoord, lavec), np.linalg.inv(lavec_skew))
+xcoord_skew -= np.floor(xcoord_skew)
+
+
+def write_input(prefix, lavec_in, xcoord_in, norder, cutoff):
+    with open(prefix + '.in', 'w') as f:
+        f.write("&general\n")
+        f.write(" PREFIX = %s\n MODE = optimize\n" % prefix)
+        f.write(" NAT = %d; NKD = 2\n KD = Si C\n/\n" % len(xcoord_in))
+        f.write("&interaction\n NORDER = %d\n/\n" % norder)
+        f.write("&cell\n 1.0\n")
+        for vec in lavec_in:
+            f.write(" %.15f %.15f %.15f\n" % tuple(vec))
+        f.write("/\n&cutoff\n *-* %s\n/\n" % cutoff)
+        f.write("&optimize\n DFSET = DFSET\n/\n&position\n")
+        for k, x in zip(kd, xcoord_in):
+            f.write(" %d %.15f %.15f %.15f\n" % (k, x[0], x[1], x[2]))
+        f.write("/\n")
+
+
+def get_shells(prefix, norder):
+    # Set of (order, distance, multiplicity) of the terms in the .fcs file
+    shells = set()
+    with open(prefix + '.fcs') as f:
+        lines = iter(f.read().splitlines())
+    for order in range(norder):
+        for line in lines:
+            if line.strip() == '*FC%d' % (order + 2):
+                break
+        for line in lines:
+            items = line.split()
+            if len(items) != order + 7:
+                break
+            shells.add((order, items[-1], int(items[3])))
+    return shells
+
+
+alm_exec = os.environ.get('ALM', 'alm')
+workdir = tempfile.mkdtemp()
+cwd = os.getcwd()
+
+try:
+    os.chdir(workdir)
+    np.savetxt('DFSET', np.hstack((disp.reshape(-1, 3), force.reshape(-1, 3))))
+
+    for norder, cutoff in ((1, 'None'), (2, '10.0 4.0')):
+        shells = []
+        for prefix, lavec_in, xcoord_in in (('cubic', lavec, xcoord),
+                                            ('skew', lavec_skew, xcoord_skew)):
+            write_input(prefix, lavec_in, xcoord_in, norder, cutoff)
+            with open(prefix + '.log', 'w') as f:
+                subprocess.check_call([alm_exec, prefix + '.in'], stdout=f)
+            shells.append(get_shells(prefix, norder))
+
+        print(sorted(shells[1]))
+        assert set(shell[0] for shell in shells[0]) == set(range(norder))
+        assert shells[1] == shells[0]
+finally:
+    os.chdir(cwd)
+    shutil.rmtree(workdir)
@@ -0,0 +1,123 @@
+#!/usr/bin/env python
+# coding: utf-8
+
+# Timing of the setup and fitting stages of the alm executable (given by
+# the ALM environment variable, or found in PATH) for the 64-atom Si and
+# SiC supercells of Si_fitting.py and SiC_fitting.py.
+#
+# Each case is run NREPEAT times (default 1) and the shortest time of
+# each stage in seconds is printed. Set OMP_NUM_THREADS to fix the number
+# of threads. The quartic SiC case takes about ten minutes on four threads,
+# most of which is spent in the solver.
+#
+#   OMP_NUM_THREADS=1 ALM=/path/to/alm python benchmark_stages.py
+
+import os
+import shutil
+import subprocess
+import tempfile
+import numpy as np
+
+
+# Si: the diamond structure in the 2x2x2 conventional cell, in the atomic
+# order of Si_fitting.py.
+lavec_si = np.eye(3) * 20.406
+xcoord_si = []
+for b in ((0, 0, 0), (0, 0.5, 0.5), (0.5, 0, 0.5), (0.5, 0.5, 0)):
+    for s in (0, 0.25):
+        for i in range(2):
+            for j in range(2):
+                for k in range(2):
+                    xcoord_si.append([(b[0] + s + i) * 0.5,
+                                      (b[1] + s + j) * 0.5,
+                                      (b[2] + s + k) * 0.5])
+xcoord_si = np.array(sorted(xcoord_si))
+kd_si = np.ones(64, dtype=int)
+
+lavec_sic = np.loadtxt('lavec.dat')
+xcoord_sic = np.loadtxt('xcoord.dat')
+kd_sic = np.where(np.loadtxt('kd.dat').astype(int) == 14, 1, 2)
+
+dfset = {}
+for name in ('si', 'sic'):
+    disp = np.loadtxt(name + "_disp.dat").reshape((-1, 64, 3))
+    force = np.loadtxt(name + "_force.dat").reshape((-1, 64, 3))
+    dfset[name] = np.hstack((disp.reshape(-1, 3), force.reshape(-1, 3)))
+
+structures = {'si': (lavec_si, xcoord_si, kd_si, 'Si'),
+              'sic': (lavec_sic, xcoord_sic, kd_sic, 'Si C')}
+
+# (structure, NORDER, cutoff radii)
+cases = (('si', 1, 'None'),
+         ('si', 2, 'None 7.3'),
+         ('si', 3, 'None 7.3 5.0'),
+         ('sic', 1, 'None'),
+         ('sic', 2, 'None 7.3'),
+         ('sic', 3, 'None 7.3 5.0'))
+
+stages = ('SYSTEM', 'SYMMETRY', 'INTERACTION', 'FORCE CONSTANT',
+          'CONSTRAINT', 'OPTIMIZATION')
+labels = ('system', 'symmetry', 'cluster', 'fcs', 'constraint', 'optimize')
+
+
+def write_input(prefix, name, norder, cutoff):
+    lavec, xcoord, kd, kdname = structures[name]
+    with open(prefix + '.in', 'w') as f:
+        f.write("&general\n")
+        f.write(" PREFIX = %s\n MODE = optimize\n" % prefix)
+        f.write(" NAT = %d; NKD = %d\n KD = %s\n/\n"
+                % (len(xcoord), len(kdname.split()), kdname))
+        f.write("&interaction\n NORDER = %d\n/\n" % norder)
+        f.write("&cell\n 1.0\n")
+        for vec in lavec:
+            f.write(" %.15f %.15f %.15f\n" % tuple(vec))
+        f.write("/\n&cutoff\n *-* %s\n/\n" % cutoff)
+        f.write("&optimize\n DFSET = DFSET_%s\n/\n&position\n" % name)
+        for k, x in zip(kd, xcoord):
+            f.write(" %d %.15f %.15f %.15f\n" % (k, x[0], x[1], x[2]))
+        f.write("/\n")
+
+
+def get_stage_times(logfile):
+    # The elapsed time printed at the end of each stage is cumulative.
+    times = {}
+    stage = None
+    elapsed = 0.0
+    with open(logfile) as f:
+        for line in f:
+            if line.strip() in stages:
+                stage = line.strip()
+            elif 'Time Elapsed' in line and stage:
+                now = float(line.split()[2])
+                times[stage] = now - elapsed
+                elapsed = now
+                stage = None
+    return times
+
+
+alm_exec = os.environ.get('ALM', 'alm')
+nrepeat = int(os.environ.get('NREPEAT', 1))
+workdir = tempfile.mkdtemp()
+cwd = os.getcwd()
+
+try:
+    os.chdir(workdir)
+    for name in dfset:
+        np.savetxt('DFSET_' + name, dfset[name])
+
+    print("%-4s %6s %-14s" % ('', 'NORDER', 'cutoff')
+          + ''.join(" %11s" % s for s in labels))
+    for name, norder, cutoff in cases:
+        prefix = "%s%d" % (name, norder)
+        write_input(prefix, name, norder, cutoff)
+        best = {}
+        for i in range(nrepeat):
+            with open(prefix + '.log', 'w') as f:
+                subprocess.check_call([alm_exec, prefix + '.in'], stdout=f)
+            for stage, t in get_stage_times(prefix + '.log').items():
+                best[stage] = min(t, best.get(stage, t))
+        print("%-4s %6d %-14s" % (name, norder, cutoff)
+              + ''.join(" %11.4f" % best.get(s, 0.0) for s in stages))
+finally:
+    os.chdir(cwd)
+    shutil.rmtree(workdir)